@@ -375,6 +375,13 @@ struct IMAGE_SYMBOL {
 #pragma pack()
 #endif
 
+// Section values (SectionNumber of a symbol that is not in a section).
+enum : SHORT {
+  IMAGE_SYM_UNDEFINED                   = 0,   // Symbol is undefined or is common.
+  IMAGE_SYM_ABSOLUTE                    = -1,  // Symbol is an absolute value.
+  IMAGE_SYM_DEBUG                       = -2,  // Symbol is a special debug item.
+};
+
 // Type (fundamental) values.
 enum {
   IMAGE_SYM_TYPE_NULL                   = 0x0000,  // no type.
@@ -523,6 +530,21 @@ struct IMAGE_BASE_RELOCATION {
 //  WORD    TypeOffset[1];
 };
 
+// Based relocation types (the high 4 bits of each TypeOffset entry; the low 12 bits are the offset in the page).
+enum {
+  IMAGE_REL_BASED_ABSOLUTE        = 0,   // Padding, no fixup
+  IMAGE_REL_BASED_HIGH            = 1,   // High 16 bits of the delta
+  IMAGE_REL_BASED_LOW             = 2,   // Low 16 bits of the delta
+  IMAGE_REL_BASED_HIGHLOW         = 3,   // All 32 bits of the delta
+  IMAGE_REL_BASED_HIGHADJ         = 4,   // High 16 bits, adjusted by the low 16 bits in the next entry
+  IMAGE_REL_BASED_MACHINE_SPECIFIC_5 = 5,
+  IMAGE_REL_BASED_RESERVED        = 6,
+  IMAGE_REL_BASED_MACHINE_SPECIFIC_7 = 7,
+  IMAGE_REL_BASED_MACHINE_SPECIFIC_8 = 8,
+  IMAGE_REL_BASED_MACHINE_SPECIFIC_9 = 9,
+  IMAGE_REL_BASED_DIR64           = 10   // All 64 bits of the delta
+};
+
 // Export Format
 struct IMAGE_EXPORT_DIRECTORY {
   DWORD   Characteristics;
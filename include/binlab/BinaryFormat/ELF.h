@@ -471,6 +471,7 @@ struct Elf64_Chdr {
 // Legal values for ch_type (compression algorithm).
 enum {
   ELFCOMPRESS_ZLIB = 1,             // ZLIB/DEFLATE algorithm.
+  ELFCOMPRESS_ZSTD = 2,             // Zstandard algorithm.
   ELFCOMPRESS_LOOS = 0x60000000,    // Start of OS-specific.
   ELFCOMPRESS_HIOS = 0x6fffffff,    // End of OS-specific.
   ELFCOMPRESS_LOPROC = 0x70000000,  // Start of processor-specific.
@@ -618,6 +619,53 @@ struct Elf64_Rela {
 #define ELF64_R_TYPE(i)             ((i) & 0xffffffff)
 #define ELF64_R_INFO(sym,type)      ((((Elf64_Xword) (sym)) << 32) + (type))
 
+// AMD x86-64 relocations.
+enum {
+  R_X86_64_NONE = 0,         // No reloc
+  R_X86_64_64 = 1,           // Direct 64 bit
+  R_X86_64_PC32 = 2,         // PC relative 32 bit signed
+  R_X86_64_GOT32 = 3,        // 32 bit GOT entry
+  R_X86_64_PLT32 = 4,        // 32 bit PLT address
+  R_X86_64_COPY = 5,         // Copy symbol at runtime
+  R_X86_64_GLOB_DAT = 6,     // Create GOT entry
+  R_X86_64_JUMP_SLOT = 7,    // Create PLT entry
+  R_X86_64_RELATIVE = 8,     // Adjust by program base
+  R_X86_64_GOTPCREL = 9,     // 32 bit signed PC relative offset to GOT
+  R_X86_64_32 = 10,          // Direct 32 bit zero extended
+  R_X86_64_32S = 11,         // Direct 32 bit sign extended
+  R_X86_64_16 = 12,          // Direct 16 bit zero extended
+  R_X86_64_PC16 = 13,        // 16 bit sign extended pc relative
+  R_X86_64_8 = 14,           // Direct 8 bit sign extended
+  R_X86_64_PC8 = 15,         // 8 bit sign extended pc relative
+  R_X86_64_DTPMOD64 = 16,    // ID of module containing symbol
+  R_X86_64_DTPOFF64 = 17,    // Offset in module's TLS block
+  R_X86_64_TPOFF64 = 18,     // Offset in initial TLS block
+  R_X86_64_PC64 = 24,        // PC relative 64 bit
+  R_X86_64_TLSDESC = 36,     // TLS descriptor
+  R_X86_64_IRELATIVE = 37,   // Adjust indirectly by program base
+  R_X86_64_RELATIVE64 = 38   // 64-bit adjust by program base
+};
+
+// ARM AARCH64 relocations.
+enum {
+  R_AARCH64_NONE = 0,            // No relocation
+  R_AARCH64_ABS64 = 257,         // Direct 64 bit
+  R_AARCH64_ABS32 = 258,         // Direct 32 bit
+  R_AARCH64_ABS16 = 259,         // Direct 16-bit
+  R_AARCH64_PREL64 = 260,        // PC-relative 64-bit
+  R_AARCH64_PREL32 = 261,        // PC-relative 32-bit
+  R_AARCH64_PREL16 = 262,        // PC-relative 16-bit
+  R_AARCH64_COPY = 1024,         // Copy symbol at runtime
+  R_AARCH64_GLOB_DAT = 1025,     // Create GOT entry
+  R_AARCH64_JUMP_SLOT = 1026,    // Create PLT entry
+  R_AARCH64_RELATIVE = 1027,     // Adjust by program base
+  R_AARCH64_TLS_DTPMOD = 1028,   // Module number, 64 bit
+  R_AARCH64_TLS_DTPREL = 1029,   // Module-relative offset, 64 bit
+  R_AARCH64_TLS_TPREL = 1030,    // TP-relative offset, 64 bit
+  R_AARCH64_TLSDESC = 1031,      // TLS Descriptor
+  R_AARCH64_IRELATIVE = 1032     // STT_GNU_IFUNC relocation
+};
+
 // Program segment header.
 struct Elf32_Phdr {
   Elf32_Word  p_type;     // Segment type
@@ -807,7 +855,10 @@ enum {
   DT_PREINIT_ARRAY = 32,    // Array with addresses of preinit fct
   DT_PREINIT_ARRAYSZ = 33,  // size in bytes of DT_PREINIT_ARRAY
   DT_SYMTAB_SHNDX = 34,     // Address of SYMTAB_SHNDX section
-  DT_NUM = 35,              // Number used
+  DT_RELRSZ = 35,           // Total size of RELR relative relocations
+  DT_RELR = 36,             // Address of RELR relative relocations
+  DT_RELRENT = 37,          // Size of one RELR relative relocation
+  DT_NUM = 38,              // Number used
   DT_LOOS = 0x6000000d,     // Start of OS-specific
   DT_HIOS = 0x6ffff000,     // End of OS-specific
   DT_LOPROC = 0x70000000,   // Start of processor-specific
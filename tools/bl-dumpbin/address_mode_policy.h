@@ -3,9 +3,17 @@
 #ifndef BINLAB_ADDRESS_MODE_POLICY_H_
 #define BINLAB_ADDRESS_MODE_POLICY_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
 #include "binlab/Config.h"
 #include "binlab/BinaryFormat/COFF.h"
 #include "binlab/BinaryFormat/ELF.h"
+#include "elf_file.h"
 
 template <typename Section>
 struct section_traits;
@@ -29,21 +37,57 @@ struct section_traits<binlab::COFF::IMAGE_SECTION_HEADER> {
   }
 };
 
+// ELF program headers as elf_file hands them out, widened and in host byte order: p_offset/p_filesz in the file,
+// p_vaddr/p_memsz in memory, the same pairing as a PE section's raw data and virtual extent
+template <>
+struct section_traits<elf_segment> {
+  using address_type = std::uint64_t;
+
+  static inline constexpr auto address(const elf_segment& segment) {
+    return segment.offset;
+  }
+  static inline constexpr auto size(const elf_segment& segment) {
+    return segment.filesz;
+  }
+
+  static inline constexpr auto vaddress(const elf_segment& segment) {
+    return segment.vaddr;
+  }
+  static inline constexpr auto vsize(const elf_segment& segment) {
+    return segment.memsz;
+  }
+};
+
 template <typename Section, typename Traits = section_traits<Section>>
 class file_offset_policy {
  public:
-  static constexpr bool in_section(const Section::address_type address, const Section& section) {
+  static constexpr auto begin(const Section& section) {
+    return Traits::address(section);
+  }
+
+  static constexpr bool in_section(const Traits::address_type address, const Section& section) {
     return (Traits::address(section) <= address) && (address < Traits::address(section) + Traits::size(section));
   }
 
   static constexpr auto cast(const Traits::address_type address, const Section& section) {
     return (address - Traits::address(section) + Traits::vaddress(section));
   }
+
+  // bytes from `address` to the end of the raw data that is also inside the virtual extent
+  static constexpr std::size_t mapped(const Traits::address_type address, const Section& section) {
+    const std::size_t delta = address - Traits::address(section);
+    const std::size_t extent = std::min<std::size_t>(Traits::size(section), Traits::vsize(section));
+    return delta < extent ? extent - delta : 0;
+  }
 };
 
 template <typename Section, typename Traits = section_traits<Section>>
 class relative_virtual_address_policy {
  public:
+  static constexpr auto begin(const Section& section) {
+    return Traits::vaddress(section);
+  }
+
   static constexpr bool in_section(const Traits::address_type address, const Section& section) {
     return (Traits::vaddress(section) <= address) && (address < Traits::vaddress(section) + Traits::vsize(section));
   }
@@ -51,6 +95,108 @@ class relative_virtual_address_policy {
   static constexpr auto cast(const Traits::address_type address, const Section& section) {
     return (address - Traits::vaddress(section) + Traits::address(section));
   }
+
+  // bytes from `address` to the end of the raw data behind it; 0 in the uninitialized tail, which has none
+  static constexpr std::size_t mapped(const Traits::address_type address, const Section& section) {
+    const std::size_t delta = address - Traits::vaddress(section);
+    const std::size_t extent = std::min<std::size_t>(Traits::size(section), Traits::vsize(section));
+    return delta < extent ? extent - delta : 0;
+  }
+};
+
+// sections sorted by the policy's start address; lookups are a branch-free lower bound and keep no state, so one
+// index can serve every thread of a parallel walk
+template <typename Section, template <typename, typename> class Policy, typename Traits = section_traits<Section>>
+class section_index {
+ public:
+  using policy = Policy<Section, Traits>;
+  using address_type = Traits::address_type;
+
+  section_index() = default;
+  section_index(const Section* first, const Section* last, std::size_t limit = ~std::size_t{0}) {
+    assign(first, last, limit);
+  }
+
+  // `limit` bounds what a cast may translate to, the file size for an index from RVAs into a file
+  void assign(const Section* first, const Section* last, std::size_t limit = ~std::size_t{0}) {
+    limit_ = limit;
+    entries_.clear();
+    for (auto iter = first; iter != last; ++iter) {
+      entries_.push_back({static_cast<address_type>(policy::begin(*iter)), iter});
+    }
+    std::stable_sort(entries_.begin(), entries_.end(), [](const entry& lhs, const entry& rhs) { return lhs.begin < rhs.begin; });
+  }
+
+  const Section* find(const address_type address) const {
+    if (entries_.empty()) {
+      return nullptr;
+    }
+
+    auto base = entries_.data();
+    for (auto n = entries_.size(); n > 1;) {
+      auto half = n / 2;
+      base = (base[half].begin <= address) ? base + half : base;
+      n -= half;
+    }
+    if (!policy::in_section(address, *base->section)) {
+      return nullptr;
+    }
+    return base->section;
+  }
+
+  // translate an address into the other address space and return how many bytes from there on the section maps
+  // below the limit; 0 if no section covers it or nothing lies behind it
+  std::size_t mapped(const address_type address, std::size_t& result) const {
+    auto section = find(address);
+    if (!section) {
+      return 0;
+    }
+    const auto n = policy::mapped(address, *section);
+    const std::size_t target = policy::cast(address, *section);
+    if (!n || target >= limit_) {
+      return 0;
+    }
+    result = target;
+    return std::min<std::size_t>(n, limit_ - target);
+  }
+
+  // translate an address into the other address space, false if it maps to nothing
+  bool cast(const address_type address, std::size_t& result) const {
+    return mapped(address, result) != 0;
+  }
+
+  std::size_t size() const { return entries_.size(); }
+
+ private:
+  struct entry {
+    address_type begin;
+    const Section* section;
+  };
+
+  std::vector<entry> entries_;
+  std::size_t limit_ = ~std::size_t{0};
 };
 
+using rva_index = section_index<binlab::COFF::IMAGE_SECTION_HEADER, relative_virtual_address_policy>;
+
+// the file bytes from `rva` on and their offset, 0 when the rva is not backed by the file
+inline std::size_t rva_mapped(const rva_index& index, const std::size_t rva, std::size_t& offset) {
+  return rva <= ~rva_index::address_type{0} ? index.mapped(static_cast<rva_index::address_type>(rva), offset) : 0;
+}
+
+// the T at `rva`, or null unless all of it lies in the file
+template <typename T>
+inline const T* rva_cast(const char* base, const rva_index& index, const std::size_t rva) {
+  std::size_t offset = 0;
+  return rva_mapped(index, rva, offset) >= sizeof(T) ? reinterpret_cast<const T*>(&base[offset]) : nullptr;
+}
+
+// the NUL-terminated string at `rva`, cut where the section's raw data or the file ends, or an empty view (with a
+// null data()) when it is not mapped
+inline std::string_view rva_string(const char* base, const rva_index& index, const std::size_t rva) {
+  std::size_t offset = 0;
+  const auto n = rva_mapped(index, rva, offset);
+  return n ? std::string_view{&base[offset], ::strnlen(&base[offset], n)} : std::string_view{};
+}
+
 #endif  // BINLAB_ADDRESS_MODE_POLICY_H_
@@ -0,0 +1,371 @@
+// binary_diff.h
+
+#ifndef BINLAB_BINARY_DIFF_H_
+#define BINLAB_BINARY_DIFF_H_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "cpu_dispatch.h"
+#include "result_cache.h"
+
+namespace bindiff {
+
+// one changed stretch: `old_size` bytes at `old_offset` became `new_size` bytes at `new_offset`, both relative to
+// the start of the two regions compared
+struct range {
+  std::uint64_t old_offset;
+  std::uint64_t old_size;
+  std::uint64_t new_offset;
+  std::uint64_t new_size;
+};
+
+// differences closer than this are reported as one range
+static constexpr std::size_t merge_gap = 32;
+
+// content-defined chunks: a cut where the gear hash of the last 64 bytes has its top `chunk_bits` bits clear, so
+// boundaries follow the content and resynchronize right after an insertion or deletion
+static constexpr std::size_t min_chunk = 512;
+static constexpr std::size_t max_chunk = 16 << 10;
+static constexpr unsigned chunk_bits = 11;
+
+// the length of the equal prefix of a and b
+inline std::size_t mismatch_scalar(const std::uint8_t* a, const std::uint8_t* b, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    std::uint64_t x, y;
+    std::memcpy(&x, a + i, sizeof(x));
+    std::memcpy(&y, b + i, sizeof(y));
+    if (x != y) {
+      break;
+    }
+  }
+  for (; i < n && a[i] == b[i]; ++i) {
+  }
+  return i;
+}
+
+// the length of the equal suffix of a and b
+inline std::size_t common_suffix_scalar(const std::uint8_t* a, const std::uint8_t* b, std::size_t n) {
+  std::size_t i = n;
+  for (; i >= 8; i -= 8) {
+    std::uint64_t x, y;
+    std::memcpy(&x, a + i - 8, sizeof(x));
+    std::memcpy(&y, b + i - 8, sizeof(y));
+    if (x != y) {
+      break;
+    }
+  }
+  for (; i && a[i - 1] == b[i - 1]; --i) {
+  }
+  return n - i;
+}
+
+#if defined(BINLAB_HAVE_SSE2)
+inline unsigned equal_mask(const std::uint8_t* a, const std::uint8_t* b) {
+  return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b)))));
+}
+
+inline std::size_t mismatch_sse2(const std::uint8_t* a, const std::uint8_t* b, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    if (auto mask = equal_mask(a + i, b + i); mask != 0xffff) {
+      return i + std::countr_one(mask);
+    }
+  }
+  return i + mismatch_scalar(a + i, b + i, n - i);
+}
+
+inline std::size_t common_suffix_sse2(const std::uint8_t* a, const std::uint8_t* b, std::size_t n) {
+  std::size_t i = n;
+  for (; i >= 16; i -= 16) {
+    if (auto mask = equal_mask(a + i - 16, b + i - 16); mask != 0xffff) {
+      return n - i + std::countl_one(static_cast<std::uint16_t>(mask));
+    }
+  }
+  return n - i + common_suffix_scalar(a, b, i);
+}
+#endif  // !BINLAB_HAVE_SSE2
+
+#if defined(BINLAB_HAVE_AVX2)
+// 64 bytes per iteration; the block that differs is pinned down by the sse2 kernel
+BINLAB_TARGET_AVX2 inline bool equal64_avx2(const std::uint8_t* a, const std::uint8_t* b) {
+  auto e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b)));
+  auto e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + 32)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 32)));
+  return _mm256_movemask_epi8(_mm256_and_si256(e0, e1)) == -1;
+}
+
+BINLAB_TARGET_AVX2 inline std::size_t mismatch_avx2(const std::uint8_t* a, const std::uint8_t* b, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 64 <= n && equal64_avx2(a + i, b + i); i += 64) {
+  }
+  return i + mismatch_sse2(a + i, b + i, n - i);
+}
+
+BINLAB_TARGET_AVX2 inline std::size_t common_suffix_avx2(const std::uint8_t* a, const std::uint8_t* b, std::size_t n) {
+  std::size_t i = n;
+  for (; i >= 64 && equal64_avx2(a + i - 64, b + i - 64); i -= 64) {
+  }
+  return n - i + common_suffix_sse2(a, b, i);
+}
+#endif  // !BINLAB_HAVE_AVX2
+
+#if defined(BINLAB_HAVE_AVX512)
+// 128 bytes per iteration, then the avx2 kernel for the block that differs and the tail
+BINLAB_TARGET_AVX512 inline bool equal128_avx512(const std::uint8_t* a, const std::uint8_t* b) {
+  auto d0 = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(a), _mm512_loadu_si512(b));
+  auto d1 = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(a + 64), _mm512_loadu_si512(b + 64));
+  return !(d0 | d1);
+}
+
+BINLAB_TARGET_AVX512 inline std::size_t mismatch_avx512(const std::uint8_t* a, const std::uint8_t* b, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 128 <= n && equal128_avx512(a + i, b + i); i += 128) {
+  }
+  return i + mismatch_avx2(a + i, b + i, n - i);
+}
+
+BINLAB_TARGET_AVX512 inline std::size_t common_suffix_avx512(const std::uint8_t* a, const std::uint8_t* b, std::size_t n) {
+  std::size_t i = n;
+  for (; i >= 128 && equal128_avx512(a + i - 128, b + i - 128); i -= 128) {
+  }
+  return n - i + common_suffix_avx2(a, b, i);
+}
+#endif  // !BINLAB_HAVE_AVX512
+
+using compare_type = std::size_t (*)(const std::uint8_t*, const std::uint8_t*, std::size_t);
+
+inline compare_type select_mismatch() {
+#if defined(BINLAB_HAVE_AVX512)
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return mismatch_avx512;
+  }
+#endif  // !BINLAB_HAVE_AVX512
+#if defined(BINLAB_HAVE_AVX2)
+  if (__builtin_cpu_supports("avx2")) {
+    return mismatch_avx2;
+  }
+#endif  // !BINLAB_HAVE_AVX2
+#if defined(BINLAB_HAVE_SSE2)
+  return mismatch_sse2;
+#else
+  return mismatch_scalar;
+#endif  // !BINLAB_HAVE_SSE2
+}
+
+inline compare_type select_common_suffix() {
+#if defined(BINLAB_HAVE_AVX512)
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return common_suffix_avx512;
+  }
+#endif  // !BINLAB_HAVE_AVX512
+#if defined(BINLAB_HAVE_AVX2)
+  if (__builtin_cpu_supports("avx2")) {
+    return common_suffix_avx2;
+  }
+#endif  // !BINLAB_HAVE_AVX2
+#if defined(BINLAB_HAVE_SSE2)
+  return common_suffix_sse2;
+#else
+  return common_suffix_scalar;
+#endif  // !BINLAB_HAVE_SSE2
+}
+
+// the offset of the first byte where a and b differ, n when they are equal; memcmp at memory speed that also says where
+inline std::size_t mismatch(const char* a, const char* b, std::size_t n) {
+  static const auto kernel = select_mismatch();
+  return kernel(reinterpret_cast<const std::uint8_t*>(a), reinterpret_cast<const std::uint8_t*>(b), n);
+}
+
+// how many bytes at the end of a and b are equal
+inline std::size_t common_suffix(const char* a, const char* b, std::size_t n) {
+  static const auto kernel = select_common_suffix();
+  return kernel(reinterpret_cast<const std::uint8_t*>(a), reinterpret_cast<const std::uint8_t*>(b), n);
+}
+
+// 256 fixed random words (splitmix64), one per byte value
+inline constexpr std::array<std::uint64_t, 256> gear_table() {
+  std::array<std::uint64_t, 256> table{};
+  std::uint64_t x = 0x62696e6c61622d64;
+  for (auto& entry : table) {
+    auto z = (x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    entry = z ^ (z >> 31);
+  }
+  return table;
+}
+
+inline constexpr auto gear = gear_table();
+
+struct chunk {
+  std::uint64_t offset;
+  std::uint64_t size;
+  std::uint64_t hash;
+};
+
+// cuts [data, data + n) into content-defined chunks of min_chunk to max_chunk bytes and hashes each one
+inline void split(const char* data, std::size_t n, std::vector<chunk>& result) {
+  constexpr auto mask = ~(~std::uint64_t{0} >> chunk_bits);
+  auto bytes = reinterpret_cast<const std::uint8_t*>(data);
+  for (std::size_t start = 0; start < n;) {
+    const auto end = std::min(n, start + max_chunk);
+    auto cut = end;
+    std::uint64_t h = 0;
+    for (auto i = std::min(end, start + min_chunk); i < end; ++i) {
+      h = (h << 1) + gear[bytes[i]];
+      if (!(h & mask)) {
+        cut = i + 1;
+        break;
+      }
+    }
+    result.push_back({start, cut - start, hash_bytes(data + start, cut - start)});
+    start = cut;
+  }
+}
+
+// the changed ranges of `size` bytes at old_first and at new_first, compared in place; returns the bytes that differ
+inline std::uint64_t diff_in_place(const char* a, std::size_t old_first, const char* b, std::size_t new_first, std::size_t size, std::vector<range>& result) {
+  a += old_first;
+  b += new_first;
+  std::uint64_t changed = 0;
+  for (std::size_t p = 0; p < size;) {
+    p += mismatch(a + p, b + p, size - p);
+    if (p == size) {
+      break;
+    }
+    // the run goes on until merge_gap equal bytes in a row; each step jumps to the last difference in the window
+    auto end = p + 1;
+    for (;;) {
+      const auto window = std::min(merge_gap, size - end);
+      const auto same = common_suffix(a + end, b + end, window);
+      if (same == window) {
+        break;
+      }
+      end += window - same;
+    }
+    result.push_back({old_first + p, end - p, new_first + p, end - p});
+    changed += end - p;
+    p = end;
+  }
+  return changed;
+}
+
+// old [old_first, old_last) against new [new_first, new_last) as one range, narrowed by what the two share at both
+// ends and split further in place when what is left is equally long
+inline std::uint64_t diff_span(const char* a, std::size_t old_first, std::size_t old_last, const char* b, std::size_t new_first, std::size_t new_last, std::vector<range>& result) {
+  auto common = std::min(old_last - old_first, new_last - new_first);
+  const auto prefix = mismatch(a + old_first, b + new_first, common);
+  old_first += prefix;
+  new_first += prefix;
+  common -= prefix;
+  const auto suffix = common_suffix(a + old_last - common, b + new_last - common, common);
+  old_last -= suffix;
+  new_last -= suffix;
+  if (old_last - old_first == new_last - new_first) {
+    return diff_in_place(a, old_first, b, new_first, new_last - new_first, result);
+  }
+  result.push_back({old_first, old_last - old_first, new_first, new_last - new_first});
+  return std::max(old_last - old_first, new_last - new_first);
+}
+
+// old [old_first, old_last) against new [new_first, new_last) chunk by chunk: the new chunks are matched in order
+// against the old ones by content hash, and whatever lies between two matches is a changed range
+inline std::uint64_t diff_chunked(const char* a, std::size_t old_first, std::size_t old_last, const char* b, std::size_t new_first, std::size_t new_last, std::vector<range>& result) {
+  // a chain that is this long is all the same chunk (padding, say); a match further down is no better
+  static constexpr std::size_t max_probes = 64;
+  std::vector<chunk> x, y;
+  split(a + old_first, old_last - old_first, x);
+  split(b + new_first, new_last - new_first, y);
+
+  // open addressing by hash, each slot heading a chain of the old chunks with that hash in ascending order
+  std::vector<std::uint32_t> slots(std::bit_ceil(2 * x.size() + 2), 0), next(x.size(), 0);
+  const auto mask = slots.size() - 1;
+  for (auto k = x.size(); k--;) {
+    auto s = x[k].hash & mask;
+    while (slots[s] && x[slots[s] - 1].hash != x[k].hash) {
+      s = (s + 1) & mask;
+    }
+    next[k] = slots[s];
+    slots[s] = static_cast<std::uint32_t>(k + 1);
+  }
+  auto same = [&](std::size_t k, const chunk& c) {
+    return x[k].hash == c.hash && x[k].size == c.size && mismatch(a + old_first + x[k].offset, b + new_first + c.offset, c.size) == c.size;
+  };
+
+  std::uint64_t changed = 0;
+  std::size_t expected = 0, old_pos = 0, new_pos = 0;
+  for (const auto& c : y) {
+    auto k = expected;
+    if (k >= x.size() || !same(k, c)) {
+      auto s = c.hash & mask;
+      while (slots[s] && x[slots[s] - 1].hash != c.hash) {
+        s = (s + 1) & mask;
+      }
+      k = x.size();
+      std::size_t probes = 0;
+      for (auto link = slots[s]; link && probes < max_probes; link = next[link - 1], ++probes) {
+        if (link - 1 >= expected && same(link - 1, c)) {
+          k = link - 1;
+          break;
+        }
+      }
+      if (k == x.size()) {
+        continue;
+      }
+    }
+    if (x[k].offset > old_pos || c.offset > new_pos) {
+      changed += diff_span(a, old_first + old_pos, old_first + x[k].offset, b, new_first + new_pos, new_first + c.offset, result);
+    }
+    old_pos = x[k].offset + x[k].size;
+    new_pos = c.offset + c.size;
+    expected = k + 1;
+  }
+  if (old_pos < old_last - old_first || new_pos < new_last - new_first) {
+    changed += diff_span(a, old_first + old_pos, old_last, b, new_first + new_pos, new_last, result);
+  }
+  return changed;
+}
+
+// appends the changed ranges between old [a, a + old_size) and new [b, b + new_size) in ascending order; returns the
+// bytes they cover (the longer side of each). The common prefix and suffix are skipped at memory speed, so regions
+// that mostly match cost little more than reading them; what is left is compared in place when both sides are
+// equally long and the differences are sparse, and through content-defined chunks otherwise, so an insertion shows
+// up as one range instead of shifting everything after it
+inline std::uint64_t diff(const char* a, std::size_t old_size, const char* b, std::size_t new_size, std::vector<range>& result) {
+  const auto common = std::min(old_size, new_size);
+  const auto prefix = mismatch(a, b, common);
+  if (prefix == common && old_size == new_size) {
+    return 0;
+  }
+  const auto suffix = common_suffix(a + old_size - (common - prefix), b + new_size - (common - prefix), common - prefix);
+  const auto old_last = old_size - suffix, new_last = new_size - suffix;
+  if (old_size != new_size) {
+    return diff_chunked(a, prefix, old_last, b, prefix, new_last, result);
+  }
+
+  // in place first; dense differences may be a shift within a region that kept its size
+  const auto mark = result.size();
+  const auto changed = diff_in_place(a, prefix, b, prefix, new_last - prefix, result);
+  if (changed < (new_last - prefix) / 4 || new_last - prefix < 4 * min_chunk) {
+    return changed;
+  }
+  std::vector<range> chunked;
+  const auto moved = diff_chunked(a, prefix, old_last, b, prefix, new_last, chunked);
+  if (moved < changed) {
+    result.resize(mark);
+    result.insert(result.end(), chunked.begin(), chunked.end());
+    return moved;
+  }
+  return changed;
+}
+
+}  // namespace bindiff
+
+#endif  // BINLAB_BINARY_DIFF_H_
@@ -0,0 +1,175 @@
+// byte_stats.h
+
+#ifndef BINLAB_BYTE_STATS_H_
+#define BINLAB_BYTE_STATS_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "cpu_dispatch.h"
+
+namespace bytestats {
+
+using histogram = std::array<std::uint64_t, 256>;
+
+// a byte's count is spread over `ways` interleaved counters, one per position in an 8 byte word, so repeated bytes
+// do not serialize on one counter; counts[v * ways + k] is value v at position k
+static constexpr std::size_t ways = 8;
+static constexpr std::size_t block = 64;
+
+// bounds each kernel call, so no 32-bit counter can overflow
+static constexpr std::size_t max_pass = std::size_t{1} << 31;
+
+struct tables {
+  alignas(64) std::uint32_t counts[256 * ways];
+  std::uint64_t runs[256];  // whole blocks of one value, counted in one step
+};
+
+inline void count_words(const std::uint8_t* p, std::size_t words, std::uint32_t* counts) {
+  for (; words; --words, p += 8) {
+    std::uint64_t w;
+    std::memcpy(&w, p, sizeof(w));
+    for (std::size_t k = 0; k < 8; ++k) {
+      ++counts[((w >> (8 * k)) & 0xff) * ways + k];
+    }
+  }
+}
+
+inline void count_tail(const std::uint8_t* p, std::size_t n, std::uint32_t* counts) {
+  count_words(p, n / 8, counts);
+  for (auto i = n & ~std::size_t{7}; i < n; ++i) {
+    ++counts[p[i] * ways];
+  }
+}
+
+inline void count_scalar(const std::uint8_t* p, std::size_t n, tables& t) {
+  count_tail(p, n, t.counts);
+}
+
+#if defined(BINLAB_HAVE_AVX2)
+// a block that is all one value (padding, zero fill) is counted at once instead of byte by byte
+BINLAB_TARGET_AVX2 inline void count_avx2(const std::uint8_t* p, std::size_t n, tables& t) {
+  std::size_t i = 0;
+  for (; i + block <= n; i += block) {
+    const auto first = _mm256_set1_epi8(static_cast<char>(p[i]));
+    const auto e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)), first);
+    const auto e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 32)), first);
+    if (_mm256_movemask_epi8(_mm256_and_si256(e0, e1)) == -1) {
+      t.runs[p[i]] += block;
+    } else {
+      count_words(p + i, block / 8, t.counts);
+    }
+  }
+  count_tail(p + i, n - i, t.counts);
+}
+#endif  // !BINLAB_HAVE_AVX2
+
+#if defined(BINLAB_HAVE_AVX512)
+BINLAB_TARGET_AVX512 inline void count_avx512(const std::uint8_t* p, std::size_t n, tables& t) {
+  std::size_t i = 0;
+  for (; i + block <= n; i += block) {
+    if (!_mm512_cmpneq_epi8_mask(_mm512_loadu_si512(p + i), _mm512_set1_epi8(static_cast<char>(p[i])))) {
+      t.runs[p[i]] += block;
+    } else {
+      count_words(p + i, block / 8, t.counts);
+    }
+  }
+  count_tail(p + i, n - i, t.counts);
+}
+#endif  // !BINLAB_HAVE_AVX512
+
+using count_type = void (*)(const std::uint8_t*, std::size_t, tables&);
+
+inline count_type select_count() {
+#if defined(BINLAB_HAVE_AVX512)
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return count_avx512;
+  }
+#endif  // !BINLAB_HAVE_AVX512
+#if defined(BINLAB_HAVE_AVX2)
+  if (__builtin_cpu_supports("avx2")) {
+    return count_avx2;
+  }
+#endif  // !BINLAB_HAVE_AVX2
+  return count_scalar;
+}
+
+// adds the byte values of [data, data + n) to `result`, picking the widest kernel the cpu supports
+inline void count(const char* data, std::size_t n, histogram& result) {
+  static const auto kernel = select_count();
+  tables t;
+  for (std::size_t pass = 0; pass < n; pass += max_pass) {
+    std::memset(&t, 0, sizeof(t));
+    kernel(reinterpret_cast<const std::uint8_t*>(data) + pass, std::min(max_pass, n - pass), t);
+    for (std::size_t v = 0; v < 256; ++v) {
+      std::uint64_t sum = t.runs[v];
+      for (std::size_t k = 0; k < ways; ++k) {
+        sum += t.counts[v * ways + k];
+      }
+      result[v] += sum;
+    }
+  }
+}
+
+inline std::size_t distinct(const histogram& h) {
+  return static_cast<std::size_t>(std::count_if(h.begin(), h.end(), [](std::uint64_t c) { return c != 0; }));
+}
+
+// Shannon entropy of `total` bytes in thousandths of a bit per byte, 0 to 8000: log2(total) - sum(c log2 c) / total
+inline unsigned entropy(const histogram& h, std::uint64_t total) {
+  if (!total) {
+    return 0;
+  }
+  double sum = 0;
+  for (auto c : h) {
+    if (c) {
+      sum += static_cast<double>(c) * std::log2(static_cast<double>(c));
+    }
+  }
+  const auto bits = std::log2(static_cast<double>(total)) - sum / static_cast<double>(total);
+  return static_cast<unsigned>(std::lround(std::clamp(bits, 0.0, 8.0) * 1000));
+}
+
+// entropy of many windows of at most `size` bytes, with c log2 c looked up instead of computed per count (for
+// windows up to max_table bytes; larger ones are few enough to compute)
+class window_entropy {
+ public:
+  static constexpr std::size_t max_table = std::size_t{1} << 20;
+
+  explicit window_entropy(std::size_t size) : table_(size <= max_table ? size + 1 : 0) {
+    for (std::size_t c = 1; c < table_.size(); ++c) {
+      table_[c] = static_cast<double>(c) * std::log2(static_cast<double>(c));
+    }
+  }
+
+  // the entropy of [data, data + n), n at most the window size; its byte counts are added to `total`
+  unsigned operator()(const char* data, std::size_t n, histogram& total) const {
+    histogram h{};
+    count(data, n, h);
+    for (std::size_t v = 0; v < h.size(); ++v) {
+      total[v] += h[v];
+    }
+    if (table_.empty()) {
+      return entropy(h, n);
+    }
+    double sum = 0;
+    for (auto c : h) {
+      sum += table_[c];
+    }
+    const auto bits = n ? table_[n] / static_cast<double>(n) - sum / static_cast<double>(n) : 0.0;
+    return static_cast<unsigned>(std::lround(std::clamp(bits, 0.0, 8.0) * 1000));
+  }
+
+ private:
+  std::vector<double> table_;
+};
+
+}  // namespace bytestats
+
+#endif  // BINLAB_BYTE_STATS_H_
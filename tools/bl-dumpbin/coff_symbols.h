@@ -0,0 +1,204 @@
+// coff_symbols.h
+
+#ifndef BINLAB_COFF_SYMBOLS_H_
+#define BINLAB_COFF_SYMBOLS_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <string_view>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/COFF.h"
+#include "name_index.h"
+
+struct coff_symbol {
+  std::size_t index;      // position in the table, aux records included
+  std::string_view name;  // points into the record (short names) or the string table; nothing is copied
+  std::uint32_t value;
+  std::int16_t section;   // 1-based; 0 undefined, -1 absolute, -2 debug
+  std::uint16_t type;
+  std::uint8_t storage_class;
+  std::uint8_t aux;       // aux records that follow it
+};
+
+// the file header of a COFF object (not an image: no DOS stub, no optional header) for a machine we know, with its
+// section table inside the file; nullptr for anything else
+inline const binlab::COFF::IMAGE_FILE_HEADER* coff_object_header(const char* base, std::size_t size) {
+  using namespace binlab::COFF;
+  if (size < sizeof(IMAGE_FILE_HEADER)) {
+    return nullptr;
+  }
+  auto header = reinterpret_cast<const IMAGE_FILE_HEADER*>(base);
+  switch (header->Machine) {
+    case IMAGE_FILE_MACHINE_I386:
+    case IMAGE_FILE_MACHINE_AMD64:
+    case IMAGE_FILE_MACHINE_ARMNT:
+    case IMAGE_FILE_MACHINE_ARM64:
+      break;
+    default:
+      return nullptr;
+  }
+  if (header->SizeOfOptionalHeader || header->NumberOfSections > (size - sizeof(IMAGE_FILE_HEADER)) / sizeof(IMAGE_SECTION_HEADER)) {
+    return nullptr;
+  }
+  return header;
+}
+
+// index over a COFF object's symbol table, built in one pass: aux records are stepped over by
+// NumberOfAuxSymbols rather than read as symbols, each name is resolved once to a view into the file, and the
+// symbols are grouped by section number and sorted by value within each group, so a section's symbols in
+// address order is a slice; build_name_index() adds a hash index for lookups by name
+class coff_symbol_table {
+ public:
+  coff_symbol_table() = default;
+
+  // -1 when the symbol table or the string table length lies outside the file
+  int open(const char* base, std::size_t size) {
+    using namespace binlab::COFF;
+    *this = {};
+    auto header = coff_object_header(base, size);
+    if (!header || header->PointerToSymbolTable > size ||
+        header->NumberOfSymbols > (size - header->PointerToSymbolTable) / sizeof(IMAGE_SYMBOL)) {
+      return -1;
+    }
+    symbols_ = reinterpret_cast<const IMAGE_SYMBOL*>(base + header->PointerToSymbolTable);
+    count_ = header->NumberOfSymbols;
+    sections_ = header->NumberOfSections;
+
+    // the string table follows the symbols; its first four bytes are its length, themselves included
+    auto strings = reinterpret_cast<const char*>(symbols_ + count_);
+    const std::size_t available = size - (strings - base);
+    std::uint32_t length = 0;
+    if (available >= sizeof(length)) {
+      std::memcpy(&length, strings, sizeof(length));
+      strings_ = strings;
+      strings_size_ = std::min<std::size_t>(length, available);
+    }
+
+    // one pass in table order for records, names and section counts; then symbol numbers are radix sorted by
+    // value (two stable 16-bit passes) and scattered stably into their section's slice, all linear
+    std::vector<std::uint32_t> slots(sections_ + slot_bias + 3, 0);
+    std::vector<std::uint32_t> values, sections, low(std::size_t{1} << 16, 0), high(std::size_t{1} << 16, 0);
+    records_.reserve(count_);
+    names_.reserve(count_);
+    values.reserve(count_);
+    sections.reserve(count_);
+    for (std::size_t i = 0; i < count_; i += 1 + symbols_[i].NumberOfAuxSymbols) {
+      const auto value = symbols_[i].Value;
+      records_.push_back(static_cast<std::uint32_t>(i));
+      names_.push_back(resolve(symbols_[i]));
+      values.push_back(value);
+      sections.push_back(static_cast<std::uint32_t>(slot(symbols_[i].SectionNumber)));
+      ++slots[sections.back() + 1];
+      ++low[(value & 0xffff)];
+      ++high[value >> 16];
+    }
+    std::exclusive_scan(low.begin(), low.end(), low.begin(), std::uint32_t{0});
+    std::exclusive_scan(high.begin(), high.end(), high.begin(), std::uint32_t{0});
+    std::inclusive_scan(slots.begin(), slots.end(), slots.begin());
+    first_ = slots;
+
+    const auto count = static_cast<std::uint32_t>(records_.size());
+    std::vector<std::uint32_t> order(count), sorted(count);
+    for (std::uint32_t n = 0; n < count; ++n) {
+      order[low[values[n] & 0xffff]++] = n;
+    }
+    for (auto n : order) {
+      sorted[high[values[n] >> 16]++] = n;
+    }
+    by_section_.resize(count);
+    for (auto n : sorted) {
+      by_section_[slots[sections[n]]++] = n;
+    }
+    return 0;
+  }
+
+  // symbols only, not their aux records
+  std::size_t size() const { return records_.size(); }
+  bool empty() const { return records_.empty(); }
+  std::size_t section_count() const { return sections_; }
+
+  coff_symbol operator[](std::size_t n) const {
+    auto& symbol = symbols_[records_[n]];
+    return {records_[n], names_[n], symbol.Value, symbol.SectionNumber, symbol.Type, symbol.StorageClass, symbol.NumberOfAuxSymbols};
+  }
+
+  // in table order
+  template <typename Fn>
+  void for_each(Fn fn) const {
+    for (std::size_t n = 0; n < records_.size(); ++n) {
+      fn((*this)[n]);
+    }
+  }
+
+  // the symbols of section `section` (or the undefined, absolute or debug ones) in ascending value order
+  template <typename Fn>
+  void for_each_in_section(std::int16_t section, Fn fn) const {
+    if (section < -slot_bias || section > static_cast<std::int32_t>(sections_)) {
+      return;
+    }
+    const auto s = slot(section);
+    for (auto i = first_[s]; i < first_[s + 1]; ++i) {
+      fn((*this)[by_section_[i]]);
+    }
+  }
+
+  void build_name_index() {
+    name_index_.reset(records_.size());
+    for (std::size_t n = 0; n < records_.size(); ++n) {
+      name_index_.insert(names_[n], n);
+    }
+  }
+
+  // the first symbol of that name the object defines (undefined references do not count); needs build_name_index()
+  bool find(std::string_view name, coff_symbol& result) const {
+    auto n = name_index_.find(name, [this, name](std::size_t n) {
+      return names_[n] == name && symbols_[records_[n]].SectionNumber != binlab::COFF::IMAGE_SYM_UNDEFINED;
+    });
+    if (n == name_index::npos) {
+      return false;
+    }
+    result = (*this)[n];
+    return true;
+  }
+
+ private:
+  // debug (-2) and absolute (-1) come first, then undefined (0), sections 1..N and last any other number
+  static constexpr int slot_bias = -binlab::COFF::IMAGE_SYM_DEBUG;
+
+  std::size_t slot(std::int16_t section) const {
+    return (section < -slot_bias || section > static_cast<std::int32_t>(sections_)) ? sections_ + slot_bias + 1 : static_cast<std::size_t>(section + slot_bias);
+  }
+
+  // short names are up to 8 bytes, NUL-padded; long names are bounded by the string table
+  std::string_view resolve(const binlab::COFF::IMAGE_SYMBOL& symbol) const {
+    if (symbol.N.Name.Short) {
+      auto name = reinterpret_cast<const char*>(symbol.N.ShortName);
+      return {name, ::strnlen(name, sizeof(symbol.N.ShortName))};
+    }
+    const std::size_t offset = symbol.N.Name.Long;
+    if (offset < sizeof(std::uint32_t) || offset >= strings_size_) {
+      return {};
+    }
+    auto first = strings_ + offset;
+    auto last = static_cast<const char*>(std::memchr(first, 0, strings_size_ - offset));
+    return {first, last ? static_cast<std::size_t>(last - first) : strings_size_ - offset};
+  }
+
+  const binlab::COFF::IMAGE_SYMBOL* symbols_ = nullptr;
+  std::size_t count_ = 0;
+  std::size_t sections_ = 0;
+  const char* strings_ = nullptr;
+  std::size_t strings_size_ = 0;
+  std::vector<std::uint32_t> records_;           // table index of each symbol
+  std::vector<std::string_view> names_;          // parallel to records_
+  std::vector<std::uint32_t> by_section_;        // symbol numbers grouped by slot, by value within a slot
+  std::vector<std::uint32_t> first_;             // where each slot starts in by_section_, one past the last at the end
+  name_index name_index_;                        // symbol numbers by name
+};
+
+#endif  // BINLAB_COFF_SYMBOLS_H_
@@ -0,0 +1,24 @@
+// cpu_dispatch.h
+
+#ifndef BINLAB_CPU_DISPATCH_H_
+#define BINLAB_CPU_DISPATCH_H_
+
+#include "binlab/Config.h"
+
+// kernels are compiled for every x86 level the compiler can target and picked at run time with
+// __builtin_cpu_supports, so the baseline build still runs everywhere
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define BINLAB_HAVE_SSE2 1
+#include <immintrin.h>
+#endif  // !x86
+
+#if defined(BINLAB_HAVE_SSE2) && defined(__GNUC__)
+#define BINLAB_HAVE_AVX2 1
+#define BINLAB_HAVE_AVX512 1
+#define BINLAB_HAVE_AVX512VBMI2 1
+#define BINLAB_TARGET_AVX2 __attribute__((target("avx2")))
+#define BINLAB_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#define BINLAB_TARGET_AVX512VBMI2 __attribute__((target("avx512f,avx512bw,avx512vbmi2")))
+#endif  // !__GNUC__
+
+#endif  // BINLAB_CPU_DISPATCH_H_
@@ -0,0 +1,1049 @@
+// dump_writer.h
+
+#ifndef BINLAB_DUMP_WRITER_H_
+#define BINLAB_DUMP_WRITER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#include "binlab/Config.h"
+#include "elf_symbols.h"
+#include "output_sink.h"
+#include "pe_relocate.h"
+
+enum class dump_format {
+  text,    // human readable, the historical bl-dumpbin layout
+  ndjson,  // one JSON object per line, {"type": ..., fields...}
+  binary   // length-prefixed records, see record_kind
+};
+
+// binary stream: the 8 byte magic "BLREC1\0\0", then records of
+//   u32 length (of everything after it), u16 kind, fields in the order listed below;
+//   integers are u64 little-endian, strings are a u32 length followed by the bytes (no terminator), and
+//   arrays a u32 count followed by that many integers
+enum class record_kind : std::uint16_t {
+  file = 1,              // path
+  import_by_name = 2,    // module, hint, name
+  import_by_ordinal = 3, // module, ordinal
+  export_directory = 4,  // module, base
+  export_entry = 5,      // module, rva, ordinal, name, forwarder
+  section = 6,           // index, name
+  coff_symbol = 7,       // index, value, section, type, storage class, name
+  elf_symbol = 8,        // table, index, value, size, bind, type, visibility, section, name
+  symbol_lookup = 9,     // name, found, value, forwarder
+  unresolved_import = 10, // importer, status, module, symbol, providers
+  section_contents = 11, // name, compression ("" when stored as is), stored size, size
+  relocations = 12,      // base, relative, symbolic, unresolved, skipped, unsupported
+  base_relocations = 13, // base, pages, dir64, highlow, other, padding, unsupported
+  base_relocation_page = 14, // page, dir64, highlow, other, padding, unsupported
+  image_layout = 15,     // first, size, regions, mapped, copied
+  resources_extracted = 16, // directory, resources, bytes, failed
+  diff_file = 17,        // old path, new path, status, sections, bytes
+  diff_section = 18,     // name, status, old offset, old size, new offset, new size, bytes
+  diff_range = 19,       // section, old offset, old size, new offset, new size
+  diff_symbol = 20,      // section, name, status, old value, old size, new value, new size
+  section_stats = 21,    // name, offset, size, entropy (millibits per byte), distinct values, histogram (256 counts)
+  window_entropy = 22,   // section, offset, size, entropy (millibits per byte)
+  signature_match = 23,  // signature, section, address, file offset
+  string_run = 24,       // section, address, file offset, encoding, text
+  section_error = 25,    // name, reason
+  image_written = 26,    // path, bytes, failed
+  import_module = 27,    // module
+};
+
+// renders the records the walkers produce in the selected format, straight into the sink
+class dump_writer {
+ public:
+  static constexpr char binary_magic[8] = {'B', 'L', 'R', 'E', 'C', '1', 0, 0};
+
+  explicit dump_writer(output_sink& out, dump_format format = dump_format::text) : out_{out}, format_{format} {}
+
+  output_sink& sink() const { return out_; }
+  dump_format format() const { return format_; }
+  bool text() const { return format_ == dump_format::text; }
+
+  // once per output stream, before the first record
+  void begin_stream() {
+    if (format_ == dump_format::binary) {
+      out_.write(binary_magic, sizeof(binary_magic));
+    }
+  }
+
+  void file(std::string_view path) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("dump ", 5);
+        out_.write(path);
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("file");
+        json_field("path", path);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::file, path);
+        break;
+    }
+  }
+
+  void import_module(std::string_view module) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write(module);
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("import_module");
+        json_field("module", module);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::import_module, module);
+        break;
+    }
+  }
+
+  void import_by_name(std::string_view module, std::uint16_t hint, std::string_view name) {
+    switch (format_) {
+      case dump_format::text:
+        out_.put('\t');
+        out_.hex(hint, 4);
+        out_.write(": ", 2);
+        out_.write(name);
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("import");
+        json_field("module", module);
+        json_field("hint", hint);
+        json_field("name", name);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::import_by_name, module, hint, name);
+        break;
+    }
+  }
+
+  void import_by_ordinal(std::string_view module, std::uint64_t ordinal) {
+    switch (format_) {
+      case dump_format::text:
+        out_.print("\t%p\n", reinterpret_cast<const void*>(ordinal));
+        break;
+      case dump_format::ndjson:
+        json_begin("import");
+        json_field("module", module);
+        json_field("ordinal", ordinal);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::import_by_ordinal, module, ordinal);
+        break;
+    }
+  }
+
+  void export_directory(std::string_view module, std::uint32_t base) {
+    switch (format_) {
+      case dump_format::text:
+        if (module.data()) {
+          out_.write("Name: ", 6);
+          out_.write(module);
+          out_.put('\n');
+        }
+        out_.write("Base: ", 6);
+        out_.hex(base, 8);
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("export_directory");
+        json_field("module", module);
+        json_field("base", base);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::export_directory, module, base);
+        break;
+    }
+  }
+
+  // `forwarder` is empty unless the export is forwarded to another module
+  void export_entry(std::string_view module, std::uint32_t rva, std::uint32_t ordinal, std::string_view name, std::string_view forwarder = {}) {
+    switch (format_) {
+      case dump_format::text:
+        out_.put('\t');
+        out_.hex(rva, 8);
+        out_.put('\t');
+        out_.hex(ordinal, 4);
+        out_.put('\t');
+        out_.write(name);
+        if (!forwarder.empty()) {
+          out_.write(" -> ", 4);
+          out_.write(forwarder);
+        }
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("export");
+        json_field("module", module);
+        json_field("rva", rva);
+        json_field("ordinal", ordinal);
+        json_field("name", name);
+        if (!forwarder.empty()) {
+          json_field("forwarder", forwarder);
+        }
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::export_entry, module, rva, ordinal, name, forwarder);
+        break;
+    }
+  }
+
+  // `width` right-aligns the name in text output
+  void section(std::size_t index, std::string_view name, std::size_t width = 0) {
+    switch (format_) {
+      case dump_format::text:
+        if (name.size() < width) {
+          out_.pad(width - name.size());
+        }
+        out_.write(name);
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("section");
+        json_field("index", index);
+        json_field("name", name);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::section, index, name);
+        break;
+    }
+  }
+
+  void coff_symbol(std::size_t index, std::uint32_t value, std::int16_t section, std::uint16_t type, std::uint8_t storage_class, std::string_view name, std::size_t width = 0) {
+    switch (format_) {
+      case dump_format::text:
+        out_.pad(8 - out_.hex(value));
+        out_.put(' ');
+        out_.pad(4 - out_.hex(static_cast<std::uint16_t>(section)));
+        out_.put(' ');
+        out_.pad(4 - out_.hex(type));
+        out_.put(' ');
+        out_.pad(2 - out_.hex(storage_class));
+        if (name.size() < width) {
+          out_.pad(width - name.size());
+        }
+        out_.write(name);
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("symbol");
+        json_field("index", index);
+        json_field("value", value);
+        json_field("section", section);
+        json_field("type", type);
+        json_field("storage_class", storage_class);
+        json_field("name", name);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::coff_symbol, index, value, static_cast<std::uint16_t>(section), type, storage_class, name);
+        break;
+    }
+  }
+
+  // text-only heading before the entries of one ELF symbol table
+  void elf_symbol_table(std::string_view table, std::size_t count) {
+    if (text()) {
+      out_.write("Symbol table '", 14);
+      out_.write(table);
+      out_.write("' contains ", 11);
+      out_.dec(count);
+      out_.write(" entries:\n", 10);
+    }
+  }
+
+  void elf_symbol(std::string_view table, const ::elf_symbol& sym) {
+    switch (format_) {
+      case dump_format::text: {
+        out_.pad(6 - std::min<std::size_t>(6, decimal_digits(sym.index)));
+        out_.dec(sym.index);
+        out_.write(": ", 2);
+        out_.hex(sym.value, 16);
+        out_.put(' ');
+        out_.pad(5 - std::min<std::size_t>(5, decimal_digits(sym.size)));
+        out_.dec(sym.size);
+        out_.put(' ');
+        left(elf_type_name(sym.type), 7);
+        left(elf_bind_name(sym.bind), 6);
+        left(elf_visibility_name(sym.visibility), 7);
+        switch (sym.section) {
+          case binlab::ELF::SHN_UNDEF: out_.write(" UND", 4); break;
+          case binlab::ELF::SHN_ABS: out_.write(" ABS", 4); break;
+          case binlab::ELF::SHN_COMMON: out_.write(" COM", 4); break;
+          default:
+            out_.pad(4 - std::min<std::size_t>(4, decimal_digits(sym.section)));
+            out_.dec(sym.section);
+        }
+        out_.put(' ');
+        out_.write(sym.name);
+        out_.put('\n');
+        break;
+      }
+      case dump_format::ndjson:
+        json_begin("elf_symbol");
+        json_field("table", table);
+        json_field("index", sym.index);
+        json_field("value", sym.value);
+        json_field("size", sym.size);
+        json_field("bind", sym.bind);
+        json_field("type", sym.type);
+        json_field("visibility", sym.visibility);
+        json_field("section", sym.section);
+        json_field("name", sym.name);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::elf_symbol, table, sym.index, sym.value, sym.size, sym.bind, sym.type, sym.visibility, sym.section, sym.name);
+        break;
+    }
+  }
+
+  // `forwarder` is set when the name is a PE export forwarded to another module, which -q cannot follow
+  void symbol_lookup(std::string_view name, bool found, std::uint64_t value, std::string_view forwarder = {}) {
+    switch (format_) {
+      case dump_format::text:
+        if (found) {
+          out_.hex(value, 16);
+        } else {
+          out_.pad(16, '-');
+        }
+        out_.put(' ');
+        out_.write(name);
+        if (!forwarder.empty()) {
+          out_.write(" -> ", 4);
+          out_.write(forwarder);
+        }
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("lookup");
+        json_field("name", name);
+        json_field("found", static_cast<int>(found));
+        json_field("value", value);
+        if (!forwarder.empty()) {
+          json_field("forwarder", forwarder);
+        }
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::symbol_lookup, name, static_cast<int>(found), value, forwarder);
+        break;
+    }
+  }
+
+  // `module` is empty for ELF imports, which are searched across the needed closure, except for an interposed one,
+  // where it names the module the import binds to
+  void unresolved_import(std::string_view importer, std::string_view status, std::string_view module, std::string_view symbol, std::size_t providers) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write(status);
+        out_.put('\t');
+        out_.write(importer);
+        out_.put('\t');
+        out_.write(module);
+        if (!symbol.empty()) {
+          if (!module.empty()) {
+            out_.put('!');
+          }
+          out_.write(symbol);
+        }
+        if (providers > 1) {
+          out_.write(" (", 2);
+          out_.dec(providers);
+          out_.write(" providers)", 11);
+        }
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("unresolved_import");
+        json_field("importer", importer);
+        json_field("status", status);
+        json_field("module", module);
+        json_field("symbol", symbol);
+        json_field("providers", providers);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::unresolved_import, importer, status, module, symbol, providers);
+        break;
+    }
+  }
+
+  // heading for a section's contents; only text output is followed by the hex dump itself
+  void section_contents(std::string_view name, std::string_view compression, std::uint64_t stored_size, std::uint64_t size) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("Hex dump of section '", 21);
+        out_.write(name);
+        out_.write("' (", 3);
+        if (!compression.empty()) {
+          out_.write(compression);
+          out_.put(' ');
+          out_.dec(stored_size);
+          out_.write(" -> ", 4);
+        }
+        out_.dec(size);
+        out_.write(" bytes):\n", 9);
+        break;
+      case dump_format::ndjson:
+        json_begin("section_contents");
+        json_field("name", name);
+        json_field("compression", compression);
+        json_field("stored_size", stored_size);
+        json_field("size", size);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::section_contents, name, compression, stored_size, size);
+        break;
+    }
+  }
+
+  // why a section's contents could not be dumped in full
+  void section_error(std::string_view name, std::string_view reason) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("Section '", 9);
+        out_.write(name);
+        out_.write("': ", 3);
+        out_.write(reason);
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("section_error");
+        json_field("name", name);
+        json_field("reason", reason);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::section_error, name, reason);
+        break;
+    }
+  }
+
+  // counts from relocating one image to load address `base`
+  void relocations(std::uint64_t base, std::size_t relative, std::size_t symbolic, std::size_t unresolved, std::size_t skipped, std::size_t unsupported) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("Relocations at 0x", 17);
+        out_.hex(base);
+        out_.write(": ", 2);
+        out_.dec(relative);
+        out_.write(" relative, ", 11);
+        out_.dec(symbolic);
+        out_.write(" symbolic, ", 11);
+        out_.dec(unresolved);
+        out_.write(" unresolved, ", 13);
+        out_.dec(skipped);
+        out_.write(" skipped, ", 10);
+        out_.dec(unsupported);
+        out_.write(" unsupported\n", 13);
+        break;
+      case dump_format::ndjson:
+        json_begin("relocations");
+        json_field("base", base);
+        json_field("relative", relative);
+        json_field("symbolic", symbolic);
+        json_field("unresolved", unresolved);
+        json_field("skipped", skipped);
+        json_field("unsupported", unsupported);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::relocations, base, relative, symbolic, unresolved, skipped, unsupported);
+        break;
+    }
+  }
+
+  // fixups applied when rebasing a PE image to `base`
+  void base_relocations(std::uint64_t base, const pe_fixup_stats& stats) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("Base relocations at 0x", 22);
+        out_.hex(base);
+        out_.write(": ", 2);
+        out_.dec(stats.pages);
+        out_.write(" pages, ", 8);
+        fixup_counts(stats);
+        break;
+      case dump_format::ndjson:
+        json_begin("base_relocations");
+        json_field("base", base);
+        json_field("pages", stats.pages);
+        json_fixup_counts(stats);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::base_relocations, base, stats.pages, stats.dir64, stats.highlow, stats.other, stats.padding, stats.unsupported);
+        break;
+    }
+  }
+
+  // the loaded layout built for -L: its address range, and how many bytes were mapped from the file or copied
+  void image_layout(std::uint64_t first, std::size_t size, std::size_t regions, std::size_t mapped, std::size_t copied) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("Loaded layout at 0x", 19);
+        out_.hex(first);
+        out_.write(": ", 2);
+        out_.dec(size);
+        out_.write(" bytes, ", 8);
+        out_.dec(regions);
+        out_.write(" regions, ", 10);
+        out_.dec(mapped);
+        out_.write(" mapped, ", 9);
+        out_.dec(copied);
+        out_.write(" copied\n", 8);
+        break;
+      case dump_format::ndjson:
+        json_begin("image_layout");
+        json_field("first", first);
+        json_field("size", size);
+        json_field("regions", regions);
+        json_field("mapped", mapped);
+        json_field("copied", copied);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::image_layout, first, size, regions, mapped, copied);
+        break;
+    }
+  }
+
+  // the PE resources -X wrote under `directory`, and how many of them could not be written
+  void resources_extracted(std::string_view directory, std::size_t resources, std::uint64_t bytes, std::size_t failed) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("Extracted ", 10);
+        out_.dec(resources);
+        out_.write(" resources (", 12);
+        out_.dec(bytes);
+        out_.write(" bytes) to ", 11);
+        out_.write(directory);
+        out_.write(", ", 2);
+        out_.dec(failed);
+        out_.write(" failed\n", 8);
+        break;
+      case dump_format::ndjson:
+        json_begin("resources_extracted");
+        json_field("directory", directory);
+        json_field("resources", resources);
+        json_field("bytes", bytes);
+        json_field("failed", failed);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::resources_extracted, directory, resources, bytes, failed);
+        break;
+    }
+  }
+
+  // a rebased image written out with -o; `failed` when the file could not be written in full
+  void image_written(std::string_view path, std::uint64_t bytes, bool failed) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write(failed ? "Failed to write " : "Wrote ", failed ? 16 : 6);
+        out_.dec(bytes);
+        out_.write(" bytes to ", 10);
+        out_.write(path);
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("image_written");
+        json_field("path", path);
+        json_field("bytes", bytes);
+        json_field("failed", static_cast<int>(failed));
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::image_written, path, bytes, static_cast<int>(failed));
+        break;
+    }
+  }
+
+  // the outcome of comparing two builds of a file; `status` is identical, changed, added or removed, and `sections`
+  // and `bytes` count the sections that differ and the bytes their changed ranges cover
+  void diff_file(std::string_view old_path, std::string_view new_path, std::string_view status, std::size_t sections, std::uint64_t bytes) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("diff ", 5);
+        out_.write(old_path.empty() ? "-" : old_path);
+        out_.put(' ');
+        out_.write(new_path.empty() ? "-" : new_path);
+        out_.write(": ", 2);
+        out_.write(status);
+        if (sections) {
+          out_.write(", ", 2);
+          out_.dec(sections);
+          out_.write(" sections, ", 11);
+          out_.dec(bytes);
+          out_.write(" bytes", 6);
+        }
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("diff_file");
+        json_field("old", old_path);
+        json_field("new", new_path);
+        json_field("status", status);
+        json_field("sections", sections);
+        json_field("bytes", bytes);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::diff_file, old_path, new_path, status, sections, bytes);
+        break;
+    }
+  }
+
+  // a section (or the headers before them) that differs between the builds, with its file offset and size in each
+  void diff_section(std::string_view name, std::string_view status, std::uint64_t old_offset, std::uint64_t old_size, std::uint64_t new_offset, std::uint64_t new_size, std::uint64_t bytes) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("  ", 2);
+        out_.write(name);
+        out_.write(": ", 2);
+        out_.write(status);
+        out_.write(", ", 2);
+        out_.dec(old_size);
+        out_.write(" -> ", 4);
+        out_.dec(new_size);
+        out_.write(" bytes, ", 8);
+        out_.dec(bytes);
+        out_.write(" differ\n", 8);
+        break;
+      case dump_format::ndjson:
+        json_begin("diff_section");
+        json_field("name", name);
+        json_field("status", status);
+        json_field("old_offset", old_offset);
+        json_field("old_size", old_size);
+        json_field("new_offset", new_offset);
+        json_field("new_size", new_size);
+        json_field("bytes", bytes);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::diff_section, name, status, old_offset, old_size, new_offset, new_size, bytes);
+        break;
+    }
+  }
+
+  // one changed range of a section, offsets relative to the section in each build
+  void diff_range(std::string_view section, std::uint64_t old_offset, std::uint64_t old_size, std::uint64_t new_offset, std::uint64_t new_size) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("    ", 4);
+        out_.hex(old_offset, 8);
+        out_.write(" +", 2);
+        out_.dec(old_size);
+        out_.write(" -> ", 4);
+        out_.hex(new_offset, 8);
+        out_.write(" +", 2);
+        out_.dec(new_size);
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("diff_range");
+        json_field("section", section);
+        json_field("old_offset", old_offset);
+        json_field("old_size", old_size);
+        json_field("new_offset", new_offset);
+        json_field("new_size", new_size);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::diff_range, section, old_offset, old_size, new_offset, new_size);
+        break;
+    }
+  }
+
+  // a symbol of a changed section whose bytes differ, or that only one build has
+  void diff_symbol(std::string_view section, std::string_view name, std::string_view status, std::uint64_t old_value, std::uint64_t old_size, std::uint64_t new_value, std::uint64_t new_size) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("    symbol ", 11);
+        out_.write(name);
+        out_.write(": ", 2);
+        out_.write(status);
+        out_.write(", ", 2);
+        out_.hex(old_value, 16);
+        out_.write(" +", 2);
+        out_.dec(old_size);
+        out_.write(" -> ", 4);
+        out_.hex(new_value, 16);
+        out_.write(" +", 2);
+        out_.dec(new_size);
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("diff_symbol");
+        json_field("section", section);
+        json_field("name", name);
+        json_field("status", status);
+        json_field("old_value", old_value);
+        json_field("old_size", old_size);
+        json_field("new_value", new_value);
+        json_field("new_size", new_size);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::diff_symbol, section, name, status, old_value, old_size, new_value, new_size);
+        break;
+    }
+  }
+
+  // byte statistics of one section: its histogram, how many of the 256 values occur, and the Shannon entropy in
+  // thousandths of a bit per byte (near 8000 for compressed or encrypted data)
+  void section_stats(std::string_view name, std::uint64_t offset, std::uint64_t size, unsigned entropy, std::size_t distinct, std::span<const std::uint64_t> histogram) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("Byte statistics of section '", 28);
+        out_.write(name);
+        out_.write("' at 0x", 7);
+        out_.hex(offset);
+        out_.write(" (", 2);
+        out_.dec(size);
+        out_.write(" bytes): entropy ", 17);
+        millibits(entropy);
+        out_.write(", ", 2);
+        out_.dec(distinct);
+        out_.write(" distinct values\n", 17);
+        for (std::size_t row = 0; row < histogram.size(); row += 16) {
+          out_.write("  ", 2);
+          out_.hex(row, 2);
+          out_.put(':');
+          for (auto count : histogram.subspan(row, std::min<std::size_t>(16, histogram.size() - row))) {
+            out_.put(' ');
+            out_.dec(count);
+          }
+          out_.put('\n');
+        }
+        break;
+      case dump_format::ndjson:
+        json_begin("section_stats");
+        json_field("name", name);
+        json_field("offset", offset);
+        json_field("size", size);
+        json_field("entropy", entropy);
+        json_field("distinct", distinct);
+        json_field("histogram", histogram);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::section_stats, name, offset, size, entropy, distinct, histogram);
+        break;
+    }
+  }
+
+  // the entropy of one window of a section, `offset` relative to the section
+  void window_entropy(std::string_view section, std::uint64_t offset, std::uint64_t size, unsigned entropy) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("  ", 2);
+        out_.hex(offset, 8);
+        out_.write(" +", 2);
+        out_.dec(size);
+        out_.put(' ');
+        millibits(entropy);
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("window_entropy");
+        json_field("section", section);
+        json_field("offset", offset);
+        json_field("size", size);
+        json_field("entropy", entropy);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::window_entropy, section, offset, size, entropy);
+        break;
+    }
+  }
+
+  // where a -S signature matched: the RVA (PE) or address (ELF; the section offset in an object) and the file offset
+  void signature_match(std::string_view signature, std::string_view section, std::uint64_t address, std::uint64_t offset) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("Signature '", 11);
+        out_.write(signature);
+        out_.write("' in '", 6);
+        out_.write(section);
+        out_.write("' at 0x", 7);
+        out_.hex(address);
+        out_.write(" (file offset 0x", 16);
+        out_.hex(offset);
+        out_.write(")\n", 2);
+        break;
+      case dump_format::ndjson:
+        json_begin("signature_match");
+        json_field("signature", signature);
+        json_field("section", section);
+        json_field("address", address);
+        json_field("offset", offset);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::signature_match, signature, section, address, offset);
+        break;
+    }
+  }
+
+  // a printable string found by -T, with the RVA (PE) or address (ELF) it is at; `encoding` is ascii or utf-16le,
+  // and `text` its characters either way
+  void string_run(std::string_view section, std::uint64_t address, std::uint64_t offset, std::string_view encoding, std::string_view text) {
+    switch (format_) {
+      case dump_format::text:
+        out_.hex(address, 8);
+        out_.put(' ');
+        out_.write(section);
+        out_.put(' ');
+        out_.write(encoding);
+        out_.put(' ');
+        out_.write(text);
+        out_.put('\n');
+        break;
+      case dump_format::ndjson:
+        json_begin("string_run");
+        json_field("section", section);
+        json_field("address", address);
+        json_field("offset", offset);
+        json_field("encoding", encoding);
+        json_field("text", text);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::string_run, section, address, offset, encoding, text);
+        break;
+    }
+  }
+
+  // the fixups of one relocation block, counted by type
+  void base_relocation_page(std::uint32_t page, const pe_fixup_stats& stats) {
+    switch (format_) {
+      case dump_format::text:
+        out_.write("Base relocation page 0x", 23);
+        out_.hex(page, 8);
+        out_.write(": ", 2);
+        fixup_counts(stats);
+        break;
+      case dump_format::ndjson:
+        json_begin("base_relocation_page");
+        json_field("page", page);
+        json_fixup_counts(stats);
+        json_end();
+        break;
+      case dump_format::binary:
+        binary(record_kind::base_relocation_page, page, stats.dir64, stats.highlow, stats.other, stats.padding, stats.unsupported);
+        break;
+    }
+  }
+
+ private:
+  static std::size_t decimal_digits(std::uint64_t value) {
+    std::size_t n = 1;
+    for (; value >= 10; value /= 10) {
+      ++n;
+    }
+    return n;
+  }
+
+  // thousandths as a decimal, 7912 -> 7.912
+  void millibits(unsigned value) {
+    char digits[3] = {static_cast<char>('0' + value / 100 % 10), static_cast<char>('0' + value / 10 % 10), static_cast<char>('0' + value % 10)};
+    out_.dec(value / 1000);
+    out_.put('.');
+    out_.write(digits, sizeof(digits));
+  }
+
+  void fixup_counts(const pe_fixup_stats& stats) {
+    out_.dec(stats.dir64);
+    out_.write(" dir64, ", 8);
+    out_.dec(stats.highlow);
+    out_.write(" highlow, ", 10);
+    out_.dec(stats.other);
+    out_.write(" other, ", 8);
+    out_.dec(stats.padding);
+    out_.write(" padding, ", 10);
+    out_.dec(stats.unsupported);
+    out_.write(" unsupported\n", 13);
+  }
+
+  void json_fixup_counts(const pe_fixup_stats& stats) {
+    json_field("dir64", stats.dir64);
+    json_field("highlow", stats.highlow);
+    json_field("other", stats.other);
+    json_field("padding", stats.padding);
+    json_field("unsupported", stats.unsupported);
+  }
+
+  // left-aligned in a column of `width` plus one separating space
+  void left(std::string_view value, std::size_t width) {
+    out_.write(value);
+    out_.pad(width + 1 - std::min(width, value.size()));
+  }
+
+  void json_begin(std::string_view type) {
+    out_.write("{\"type\":\"", 9);
+    out_.write(type);
+    out_.put('"');
+  }
+
+  void json_end() { out_.write("}\n", 2); }
+
+  void json_key(std::string_view key) {
+    out_.write(",\"", 2);
+    out_.write(key);
+    out_.write("\":", 2);
+  }
+
+  template <typename T>
+    requires std::is_integral_v<T>
+  void json_field(std::string_view key, T value) {
+    json_key(key);
+    out_.dec(value);
+  }
+
+  void json_field(std::string_view key, std::span<const std::uint64_t> values) {
+    json_key(key);
+    out_.put('[');
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      if (i) {
+        out_.put(',');
+      }
+      out_.dec(values[i]);
+    }
+    out_.put(']');
+  }
+
+  // the length of the well-formed UTF-8 sequence at value[i] (no overlong forms, surrogates or code points past
+  // U+10FFFF), or 0 when there is none
+  static std::size_t utf8_sequence(std::string_view value, std::size_t i) {
+    auto byte = [&value](std::size_t j) { return static_cast<unsigned char>(value[j]); };
+    const auto c = byte(i);
+    std::size_t length = 0;
+    unsigned char low = 0x80, high = 0xbf;  // the range of the second byte
+    if (c >= 0xc2 && c <= 0xdf) {
+      length = 2;
+    } else if (c >= 0xe0 && c <= 0xef) {
+      length = 3;
+      low = (c == 0xe0) ? 0xa0 : 0x80;
+      high = (c == 0xed) ? 0x9f : 0xbf;
+    } else if (c >= 0xf0 && c <= 0xf4) {
+      length = 4;
+      low = (c == 0xf0) ? 0x90 : 0x80;
+      high = (c == 0xf4) ? 0x8f : 0xbf;
+    }
+    if (!length || length > value.size() - i || byte(i + 1) < low || byte(i + 1) > high) {
+      return 0;
+    }
+    for (std::size_t j = 2; j < length; ++j) {
+      if ((byte(i + j) & 0xc0) != 0x80) {
+        return 0;
+      }
+    }
+    return length;
+  }
+
+  // escapes quotes, backslashes and control characters, and replaces each byte that does not start a well-formed
+  // UTF-8 sequence with U+FFFD, so the line is valid JSON whatever the binary holds
+  void json_field(std::string_view key, std::string_view value) {
+    static constexpr char xdigits[] = "0123456789abcdef";
+    json_key(key);
+    out_.put('"');
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < value.size(); ++i) {
+      auto c = static_cast<unsigned char>(value[i]);
+      if (c >= 0x80) {
+        if (auto length = utf8_sequence(value, i)) {
+          i += length - 1;
+          continue;
+        }
+      } else if (c >= 0x20 && c != '"' && c != '\\') {
+        continue;
+      }
+      out_.write(value.data() + run, i - run);
+      run = i + 1;
+      switch (c) {
+        case '"': out_.write("\\\"", 2); break;
+        case '\\': out_.write("\\\\", 2); break;
+        case '\n': out_.write("\\n", 2); break;
+        case '\t': out_.write("\\t", 2); break;
+        default:
+          if (c >= 0x80) {
+            out_.write("\\ufffd", 6);
+          } else {
+            char escape[6] = {'\\', 'u', '0', '0', xdigits[c >> 4], xdigits[c & 0xf]};
+            out_.write(escape, sizeof(escape));
+          }
+      }
+    }
+    out_.write(value.data() + run, value.size() - run);
+    out_.put('"');
+  }
+
+  static constexpr std::size_t binary_size(std::string_view value) { return sizeof(std::uint32_t) + value.size(); }
+  static constexpr std::size_t binary_size(std::span<const std::uint64_t> values) { return sizeof(std::uint32_t) + values.size() * sizeof(std::uint64_t); }
+  template <typename T>
+    requires std::is_integral_v<T>
+  static constexpr std::size_t binary_size(T) {
+    return sizeof(std::uint64_t);
+  }
+
+  void binary_field(std::string_view value) {
+    binary_le(static_cast<std::uint32_t>(value.size()));
+    out_.write(value);
+  }
+  void binary_field(std::span<const std::uint64_t> values) {
+    binary_le(static_cast<std::uint32_t>(values.size()));
+    for (auto value : values) {
+      binary_le(value);
+    }
+  }
+  template <typename T>
+    requires std::is_integral_v<T>
+  void binary_field(T value) {
+    binary_le(static_cast<std::uint64_t>(value));
+  }
+
+  template <typename T>
+  void binary_le(T value) {
+    char bytes[sizeof(T)];
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+      bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    out_.write(bytes, sizeof(bytes));
+  }
+
+  template <typename... Fields>
+  void binary(record_kind kind, Fields... fields) {
+    const std::size_t length = sizeof(std::uint16_t) + (binary_size(fields) + ... + 0);
+    binary_le(static_cast<std::uint32_t>(length));
+    binary_le(static_cast<std::uint16_t>(kind));
+    (binary_field(fields), ...);
+  }
+
+  output_sink& out_;
+  dump_format format_;
+};
+
+#endif  // BINLAB_DUMP_WRITER_H_
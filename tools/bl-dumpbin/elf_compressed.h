@@ -0,0 +1,295 @@
+// elf_compressed.h
+
+#ifndef BINLAB_ELF_COMPRESSED_H_
+#define BINLAB_ELF_COMPRESSED_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/ELF.h"
+#include "elf_file.h"
+#include "thread_pool.h"
+
+#if defined(BINLAB_HAVE_ZLIB)
+#include <zlib.h>
+#endif  // !BINLAB_HAVE_ZLIB
+#if defined(BINLAB_HAVE_ZSTD)
+#include <zstd.h>
+#endif  // !BINLAB_HAVE_ZSTD
+
+// an SHF_COMPRESSED section: the Elf*_Chdr fields and the compressed stream behind it
+struct compressed_data {
+  std::uint32_t type = 0;  // ELFCOMPRESS_*
+  std::uint64_t size = 0;  // uncompressed
+  std::uint64_t addralign = 0;
+  const char* data = nullptr;
+  std::size_t data_size = 0;
+};
+
+// -1 unless the section is SHF_COMPRESSED with its Elf*_Chdr inside the `file_size` bytes of the file; a stream
+// that runs past them is cut short there, so decompressing it fails rather than reading beyond the file
+template <typename Traits>
+int read_compression_header(const elf_file<Traits>& file, const elf_section& section, std::size_t file_size, compressed_data& result) {
+  using chdr_type = Traits::chdr_type;
+  if (!(section.flags & binlab::ELF::SHF_COMPRESSED) || section.type == binlab::ELF::SHT_NOBITS || section.size < sizeof(chdr_type) ||
+      section.offset > file_size || file_size - section.offset < sizeof(chdr_type)) {
+    return -1;
+  }
+  auto& chdr = *file.template at<chdr_type>(section.offset);
+  result.type = Traits::get(chdr.ch_type);
+  result.size = Traits::get(chdr.ch_size);
+  result.addralign = Traits::get(chdr.ch_addralign);
+  result.data = file.template at<char>(section.offset + sizeof(chdr_type));
+  result.data_size = std::min<std::uint64_t>(section.size, file_size - section.offset) - sizeof(chdr_type);
+  return 0;
+}
+
+inline bool can_decompress(std::uint32_t type) {
+  switch (type) {
+#if defined(BINLAB_HAVE_ZLIB)
+    case binlab::ELF::ELFCOMPRESS_ZLIB: return true;
+#endif  // !BINLAB_HAVE_ZLIB
+#if defined(BINLAB_HAVE_ZSTD)
+    case binlab::ELF::ELFCOMPRESS_ZSTD: return true;
+#endif  // !BINLAB_HAVE_ZSTD
+    default: return false;
+  }
+}
+
+inline std::string_view compression_name(std::uint32_t type) {
+  switch (type) {
+    case binlab::ELF::ELFCOMPRESS_ZLIB: return "zlib";
+    case binlab::ELF::ELFCOMPRESS_ZSTD: return "zstd";
+    default: return "unknown";
+  }
+}
+
+// streams the decompressed bytes through sink(const char*, std::size_t) in chunks of at most `window_size` bytes,
+// so a consumer that only scans never holds more than that; -1 on a corrupt or truncated stream, a size
+// mismatch with the header, or a compression type this build cannot handle
+template <typename Sink>
+int decompress_stream(const compressed_data& in, char* window, std::size_t window_size, Sink sink) {
+  std::uint64_t total = 0;
+  switch (in.type) {
+#if defined(BINLAB_HAVE_ZLIB)
+    case binlab::ELF::ELFCOMPRESS_ZLIB: {
+      z_stream z{};
+      if (inflateInit(&z) != Z_OK) {
+        return -1;
+      }
+      auto input = in.data;
+      auto remaining = in.data_size;
+      int status = Z_OK;
+      while (status != Z_STREAM_END) {
+        if (!z.avail_in) {
+          if (!remaining) {
+            break;
+          }
+          auto n = static_cast<uInt>(std::min<std::size_t>(remaining, 1u << 30));
+          z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+          z.avail_in = n;
+          input += n;
+          remaining -= n;
+        }
+        z.next_out = reinterpret_cast<Bytef*>(window);
+        z.avail_out = static_cast<uInt>(std::min<std::size_t>(window_size, 1u << 30));
+        status = inflate(&z, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END) {
+          break;
+        }
+        auto produced = reinterpret_cast<char*>(z.next_out) - window;
+        total += produced;
+        if (produced) {
+          sink(static_cast<const char*>(window), static_cast<std::size_t>(produced));
+        }
+      }
+      inflateEnd(&z);
+      return (status == Z_STREAM_END && total == in.size) ? 0 : -1;
+    }
+#endif  // !BINLAB_HAVE_ZLIB
+#if defined(BINLAB_HAVE_ZSTD)
+    case binlab::ELF::ELFCOMPRESS_ZSTD: {
+      std::unique_ptr<ZSTD_DStream, decltype(&ZSTD_freeDStream)> z{ZSTD_createDStream(), &ZSTD_freeDStream};
+      if (!z) {
+        return -1;
+      }
+      ZSTD_inBuffer input{in.data, in.data_size, 0};
+      std::size_t status = 1;
+      while (status) {
+        ZSTD_outBuffer output{window, window_size, 0};
+        status = ZSTD_decompressStream(z.get(), &output, &input);
+        if (ZSTD_isError(status) || (!output.pos && input.pos == input.size && status)) {
+          return -1;
+        }
+        total += output.pos;
+        if (output.pos) {
+          sink(static_cast<const char*>(window), output.pos);
+        }
+      }
+      return (total == in.size) ? 0 : -1;
+    }
+#endif  // !BINLAB_HAVE_ZSTD
+    default:
+      return -1;
+  }
+}
+
+// the whole stream into out[0, in.size), in one call to the library
+inline int decompress(const compressed_data& in, char* out) {
+  switch (in.type) {
+#if defined(BINLAB_HAVE_ZLIB)
+    case binlab::ELF::ELFCOMPRESS_ZLIB: {
+      uLongf size = in.size;
+      uLong used = in.data_size;
+      auto status = uncompress2(reinterpret_cast<Bytef*>(out), &size, reinterpret_cast<const Bytef*>(in.data), &used);
+      return (status == Z_OK && size == in.size) ? 0 : -1;
+    }
+#endif  // !BINLAB_HAVE_ZLIB
+#if defined(BINLAB_HAVE_ZSTD)
+    case binlab::ELF::ELFCOMPRESS_ZSTD: {
+      auto size = ZSTD_decompress(out, in.size, in.data, in.data_size);
+      return (!ZSTD_isError(size) && size == in.size) ? 0 : -1;
+    }
+#endif  // !BINLAB_HAVE_ZSTD
+    default:
+      return -1;
+  }
+}
+
+// recycles decompression buffers; sections of similar size come and go while debug info is walked
+class buffer_pool {
+ public:
+  struct buffer {
+    std::unique_ptr<char[]> data;
+    std::size_t capacity = 0;
+  };
+
+  explicit buffer_pool(std::size_t max_cached = 8) : max_cached_{max_cached} {}
+
+  // the smallest cached buffer that fits, else a new one
+  buffer acquire(std::size_t size) {
+    {
+      std::lock_guard lock{mutex_};
+      auto best = free_.end();
+      for (auto iter = free_.begin(); iter != free_.end(); ++iter) {
+        if (iter->capacity >= size && (best == free_.end() || iter->capacity < best->capacity)) {
+          best = iter;
+        }
+      }
+      if (best != free_.end()) {
+        auto result = std::move(*best);
+        free_.erase(best);
+        return result;
+      }
+    }
+    return {std::unique_ptr<char[]>{new char[std::max<std::size_t>(size, 1)]}, size};
+  }
+
+  // keeps the largest `max_cached` buffers
+  void release(buffer b) {
+    if (!b.data) {
+      return;
+    }
+    std::lock_guard lock{mutex_};
+    free_.push_back(std::move(b));
+    if (free_.size() > max_cached_) {
+      auto smallest = std::min_element(free_.begin(), free_.end(), [](const buffer& lhs, const buffer& rhs) { return lhs.capacity < rhs.capacity; });
+      free_.erase(smallest);
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<buffer> free_;
+  const std::size_t max_cached_;
+};
+
+// section bytes with SHF_COMPRESSED sections decompressed on first access (once, also under concurrent
+// callers) into pooled buffers; uncompressed sections are returned in place, up to the end of the `file_size` bytes
+template <typename Traits>
+class section_contents {
+ public:
+  section_contents(const elf_file<Traits>& file, std::size_t file_size, buffer_pool& pool)
+      : file_{file}, file_size_{file_size}, pool_{pool}, slots_{new slot[file.section_count()]}, count_{file.section_count()} {}
+  section_contents(const section_contents&) = delete;
+  section_contents& operator=(const section_contents&) = delete;
+  ~section_contents() {
+    for (std::size_t i = 0; i < count_; ++i) {
+      release(i);
+    }
+  }
+
+  // empty view with a null data() when the section cannot be decompressed or starts past the end of the file
+  std::string_view get(std::size_t index) {
+    if (index >= count_) {
+      return {};
+    }
+    auto section = file_.section(index);
+    if (section.type == binlab::ELF::SHT_NOBITS) {
+      return {"", 0};
+    }
+    compressed_data in;
+    if (read_compression_header(file_, section, file_size_, in)) {
+      if (section.offset > file_size_) {
+        return {};
+      }
+      return {file_.template at<char>(section.offset), static_cast<std::size_t>(std::min<std::uint64_t>(section.size, file_size_ - section.offset))};
+    }
+
+    auto& s = slots_[index];
+    std::lock_guard lock{s.mutex};
+    if (!s.done) {
+      s.done = true;
+      if (can_decompress(in.type)) {
+        s.buffer = pool_.acquire(in.size);
+        if (!decompress(in, s.buffer.data.get())) {
+          s.view = {s.buffer.data.get(), static_cast<std::size_t>(in.size)};
+        } else {
+          pool_.release(std::move(s.buffer));
+        }
+      }
+    }
+    return s.view;
+  }
+
+  // decompresses the listed sections across the pool ahead of their first get()
+  void prefetch(const std::vector<std::size_t>& indices, std::size_t jobs) {
+    parallel_for(indices.size(), jobs, [this, &indices](std::size_t i) { get(indices[i]); });
+  }
+
+  // hands the section's buffer back to the pool; views from get() are invalid afterwards
+  void release(std::size_t index) {
+    if (index >= count_) {
+      return;
+    }
+    auto& s = slots_[index];
+    std::lock_guard lock{s.mutex};
+    pool_.release(std::move(s.buffer));
+    s.buffer = {};
+    s.view = {};
+    s.done = false;
+  }
+
+ private:
+  struct slot {
+    std::mutex mutex;
+    bool done = false;
+    buffer_pool::buffer buffer;
+    std::string_view view;
+  };
+
+  const elf_file<Traits>& file_;
+  std::size_t file_size_;
+  buffer_pool& pool_;
+  std::unique_ptr<slot[]> slots_;
+  std::size_t count_;
+};
+
+#endif  // BINLAB_ELF_COMPRESSED_H_
@@ -0,0 +1,190 @@
+// elf_file.h
+
+#ifndef BINLAB_ELF_FILE_H_
+#define BINLAB_ELF_FILE_H_
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/ELF.h"
+
+template <unsigned char Class>
+struct elf_class_traits;
+
+template <>
+struct elf_class_traits<binlab::ELF::ELFCLASS32> {
+  using ehdr_type = binlab::ELF::Elf32_Ehdr;
+  using shdr_type = binlab::ELF::Elf32_Shdr;
+  using phdr_type = binlab::ELF::Elf32_Phdr;
+  using sym_type = binlab::ELF::Elf32_Sym;
+  using dyn_type = binlab::ELF::Elf32_Dyn;
+  using rel_type = binlab::ELF::Elf32_Rel;
+  using rela_type = binlab::ELF::Elf32_Rela;
+  using chdr_type = binlab::ELF::Elf32_Chdr;
+  using addr_type = binlab::ELF::Elf32_Addr;
+};
+
+template <>
+struct elf_class_traits<binlab::ELF::ELFCLASS64> {
+  using ehdr_type = binlab::ELF::Elf64_Ehdr;
+  using shdr_type = binlab::ELF::Elf64_Shdr;
+  using phdr_type = binlab::ELF::Elf64_Phdr;
+  using sym_type = binlab::ELF::Elf64_Sym;
+  using dyn_type = binlab::ELF::Elf64_Dyn;
+  using rel_type = binlab::ELF::Elf64_Rel;
+  using rela_type = binlab::ELF::Elf64_Rela;
+  using chdr_type = binlab::ELF::Elf64_Chdr;
+  using addr_type = binlab::ELF::Elf64_Addr;
+};
+
+// structure layout from the class, byte order from the data encoding; get() is the identity
+// (and compiles away) when the file's order matches the host's
+template <unsigned char Class, unsigned char Data>
+struct elf_traits : elf_class_traits<Class> {
+  static constexpr unsigned char elf_class = Class;
+  static constexpr unsigned char elf_data = Data;
+  static constexpr bool swap = (Data == binlab::ELF::ELFDATA2MSB) != (std::endian::native == std::endian::big);
+
+  template <typename T>
+    requires std::is_integral_v<T>
+  static constexpr T get(T value) {
+    if constexpr (swap && sizeof(T) > 1) {
+      return std::byteswap(value);
+    } else {
+      return value;
+    }
+  }
+};
+
+using elf32le_traits = elf_traits<binlab::ELF::ELFCLASS32, binlab::ELF::ELFDATA2LSB>;
+using elf32be_traits = elf_traits<binlab::ELF::ELFCLASS32, binlab::ELF::ELFDATA2MSB>;
+using elf64le_traits = elf_traits<binlab::ELF::ELFCLASS64, binlab::ELF::ELFDATA2LSB>;
+using elf64be_traits = elf_traits<binlab::ELF::ELFCLASS64, binlab::ELF::ELFDATA2MSB>;
+
+// a section header widened to 64 bits and in host byte order
+struct elf_section {
+  std::uint32_t name;
+  std::uint32_t type;
+  std::uint64_t flags;
+  std::uint64_t addr;
+  std::uint64_t offset;
+  std::uint64_t size;
+  std::uint32_t link;
+  std::uint32_t info;
+  std::uint64_t addralign;
+  std::uint64_t entsize;
+};
+
+// a program header, widened and in host byte order the same way
+struct elf_segment {
+  std::uint32_t type;
+  std::uint32_t flags;
+  std::uint64_t offset;
+  std::uint64_t vaddr;
+  std::uint64_t filesz;
+  std::uint64_t memsz;
+  std::uint64_t align;
+};
+
+template <typename Traits>
+class elf_file {
+ public:
+  using traits = Traits;
+  using ehdr_type = Traits::ehdr_type;
+  using shdr_type = Traits::shdr_type;
+  using phdr_type = Traits::phdr_type;
+
+  explicit elf_file(const char* base) : base_{base}, ehdr_{reinterpret_cast<const ehdr_type*>(base)} {}
+
+  template <typename T>
+  static constexpr T get(T value) { return Traits::get(value); }
+
+  const char* base() const { return base_; }
+  const ehdr_type& header() const { return *ehdr_; }
+
+  std::size_t section_count() const { return ehdr_->e_shoff ? get(ehdr_->e_shnum) : 0; }
+
+  // whether the section header table lies within the first `size` bytes of the file
+  bool sections_within(std::size_t size) const {
+    const std::size_t shoff = get(ehdr_->e_shoff);
+    return shoff <= size && section_count() <= (size - shoff) / sizeof(shdr_type);
+  }
+
+  // whether the section's file bytes do
+  static bool in_file(const elf_section& section, std::size_t size) { return section.offset <= size && section.size <= size - section.offset; }
+
+  elf_section section(std::size_t i) const {
+    auto& shdr = reinterpret_cast<const shdr_type*>(&base_[get(ehdr_->e_shoff)])[i];
+    return {get(shdr.sh_name), get(shdr.sh_type), get(shdr.sh_flags), get(shdr.sh_addr), get(shdr.sh_offset), get(shdr.sh_size),
+            get(shdr.sh_link), get(shdr.sh_info), get(shdr.sh_addralign), get(shdr.sh_entsize)};
+  }
+
+  std::size_t segment_count() const { return ehdr_->e_phoff ? get(ehdr_->e_phnum) : 0; }
+
+  elf_segment segment(std::size_t i) const {
+    auto& phdr = reinterpret_cast<const phdr_type*>(&base_[get(ehdr_->e_phoff)])[i];
+    return {get(phdr.p_type), get(phdr.p_flags), get(phdr.p_offset), get(phdr.p_vaddr), get(phdr.p_filesz), get(phdr.p_memsz), get(phdr.p_align)};
+  }
+
+  // the section's name from .shstrtab, cut off at the end of the first `size` bytes of the file; empty when it
+  // starts past them
+  std::string_view section_name(const elf_section& section, std::size_t size) const {
+    auto index = get(ehdr_->e_shstrndx);
+    if (index >= section_count()) {
+      return {};
+    }
+    const auto strings = this->section(index).offset;
+    if (strings >= size || section.name >= size - strings) {
+      return {};
+    }
+    auto name = &base_[strings + section.name];
+    return {name, ::strnlen(name, size - strings - section.name)};
+  }
+
+  // calls fn(index, section) for every section header
+  template <typename Fn>
+  void for_each_section(Fn fn) const {
+    for (std::size_t i = 0, count = section_count(); i < count; ++i) {
+      fn(i, section(i));
+    }
+  }
+
+  // calls fn(index, segment) for every program header
+  template <typename Fn>
+  void for_each_segment(Fn fn) const {
+    for (std::size_t i = 0, count = segment_count(); i < count; ++i) {
+      fn(i, segment(i));
+    }
+  }
+
+  template <typename T>
+  const T* at(std::uint64_t offset) const { return reinterpret_cast<const T*>(&base_[offset]); }
+
+ private:
+  const char* base_;
+  const ehdr_type* ehdr_;
+};
+
+// the one runtime branch: picks the instantiation for the file's class and byte order, then calls
+// fn(elf_file<Traits>); -1 when `base` is not an ELF image of a known class and encoding
+template <typename Fn>
+int visit_elf(const char* base, Fn fn) {
+  using namespace binlab::ELF;
+  if (std::memcmp(base, ELFMAG, SELFMAG)) {
+    return -1;
+  }
+  switch (base[EI_CLASS] << 8 | base[EI_DATA]) {
+    case ELFCLASS32 << 8 | ELFDATA2LSB: return fn(elf_file<elf32le_traits>{base});
+    case ELFCLASS32 << 8 | ELFDATA2MSB: return fn(elf_file<elf32be_traits>{base});
+    case ELFCLASS64 << 8 | ELFDATA2LSB: return fn(elf_file<elf64le_traits>{base});
+    case ELFCLASS64 << 8 | ELFDATA2MSB: return fn(elf_file<elf64be_traits>{base});
+    default: return -1;
+  }
+}
+
+#endif  // BINLAB_ELF_FILE_H_
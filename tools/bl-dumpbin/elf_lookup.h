@@ -0,0 +1,312 @@
+// elf_lookup.h
+
+#ifndef BINLAB_ELF_LOOKUP_H_
+#define BINLAB_ELF_LOOKUP_H_
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/ELF.h"
+#include "elf_file.h"
+#include "elf_segments.h"
+#include "elf_symbols.h"
+#include "name_index.h"
+
+inline std::uint32_t gnu_hash(std::string_view name) {
+  std::uint32_t h = 5381;
+  for (auto c : name) {
+    h = h * 33 + static_cast<unsigned char>(c);
+  }
+  return h;
+}
+
+inline std::uint32_t sysv_hash(std::string_view name) {
+  std::uint32_t h = 0;
+  for (auto c : name) {
+    h = (h << 4) + static_cast<unsigned char>(c);
+    h ^= (h >> 24) & 0xf0;
+  }
+  return h & 0x0fffffff;
+}
+
+// "is X defined here" over one ELF image: the object's own .gnu.hash (bloom filter, then one bucket chain),
+// else its SysV .hash, else an open-addressing index built once over .dynsym or .symtab; without section
+// headers, the DT_GNU_HASH or DT_HASH table over DT_SYMTAB
+template <typename Traits>
+class elf_symbol_lookup {
+ public:
+  enum class method { none, gnu, sysv, index };
+
+  elf_symbol_lookup() = default;
+
+  // the image's hash and symbol tables for a file of `file_size` bytes; when its section headers are missing or name
+  // no symbols (an sstrip'd image), they are found through PT_DYNAMIC and the PT_LOAD segments instead
+  int open(const elf_file<Traits>& file, std::size_t file_size) {
+    if (file.section_count() && file.sections_within(file_size) && !open_sections(file, file_size)) {
+      return 0;
+    }
+    return open_dynamic(file, file_size);
+  }
+
+  method kind() const { return method_; }
+
+  // the defined symbol called `name`; false if there is none
+  bool find(std::string_view name, elf_symbol& result) const {
+    std::size_t index = 0;
+    switch (method_) {
+      case method::gnu: index = find_gnu(name); break;
+      case method::sysv: index = find_sysv(name); break;
+      case method::index: index = find_index(name); break;
+      default: return false;
+    }
+    if (index == npos) {
+      return false;
+    }
+    result = symbols_[index];
+    return true;
+  }
+
+  bool contains(std::string_view name) const {
+    elf_symbol sym;
+    return find(name, sym);
+  }
+
+ private:
+  using word_type = Traits::addr_type;  // bloom words are ELFCLASS-sized
+  static constexpr std::size_t npos = ~std::size_t{0};
+  static constexpr std::uint32_t word_bits = 8 * sizeof(word_type);
+
+  static std::uint32_t get(std::uint32_t value) { return Traits::get(value); }
+
+  // through the section headers, which the caller has found within the file
+  int open_sections(const elf_file<Traits>& file, std::size_t file_size) {
+    using namespace binlab::ELF;
+    *this = {};
+    int gnu = -1, sysv = -1, dynsym = -1, symtab = -1;
+    file.for_each_section([&](std::size_t i, const elf_section& section) {
+      switch (section.type) {
+        case SHT_GNU_HASH: gnu = static_cast<int>(i); break;
+        case SHT_HASH: sysv = static_cast<int>(i); break;
+        case SHT_DYNSYM: dynsym = static_cast<int>(i); break;
+        case SHT_SYMTAB: symtab = static_cast<int>(i); break;
+      }
+    });
+
+    if (gnu != -1 && init_gnu(file, file.section(gnu), file_size)) {
+      return 0;
+    }
+    if (sysv != -1 && init_sysv(file, file.section(sysv), file_size)) {
+      return 0;
+    }
+    if (auto table = (dynsym != -1) ? dynsym : symtab; table != -1) {
+      symbols_ = elf_symbol_table<Traits>{file, file.section(table), file_size};
+      if (!symbols_.empty()) {
+        build_index();
+        return 0;
+      }
+    }
+    return -1;
+  }
+
+  // the header fields of a GNU hash table in `size` bytes fit it: a power of two bloom words, a shift that stays
+  // within the 32 bit hash, and the bloom filter and buckets inside the table
+  static bool gnu_fits(const std::uint32_t* words, std::uint64_t size) {
+    const std::uint64_t nbuckets = get(words[0]), bloom_size = get(words[2]);
+    return nbuckets && std::has_single_bit(bloom_size) && get(words[3]) < 32 && 4 * sizeof(std::uint32_t) + bloom_size * sizeof(word_type) + nbuckets * sizeof(std::uint32_t) <= size;
+  }
+
+  bool init_gnu(const elf_file<Traits>& file, const elf_section& section, std::size_t file_size) {
+    // nbuckets, symoffset, bloom_size, bloom_shift, bloom[bloom_size], buckets[nbuckets], chain[]
+    if (section.link >= file.section_count() || !file.in_file(section, file_size) || section.size < 4 * sizeof(std::uint32_t)) {
+      return false;
+    }
+    auto words = file.template at<std::uint32_t>(section.offset);
+    if (!gnu_fits(words, section.size)) {
+      return false;
+    }
+    symbols_ = elf_symbol_table<Traits>{file, file.section(section.link), file_size};
+    if (symbols_.empty()) {
+      return false;
+    }
+    init_gnu(words, section.size / sizeof(std::uint32_t));
+    return true;
+  }
+
+  // a table of `count` words that gnu_fits
+  void init_gnu(const std::uint32_t* words, std::size_t count) {
+    nbuckets_ = get(words[0]);
+    symoffset_ = get(words[1]);
+    bloom_mask_ = get(words[2]) - 1;
+    bloom_shift_ = get(words[3]);
+    bloom_ = reinterpret_cast<const word_type*>(words + 4);
+    buckets_ = reinterpret_cast<const std::uint32_t*>(bloom_ + get(words[2]));
+    chain_ = buckets_ + nbuckets_;
+    chain_size_ = count - static_cast<std::size_t>(chain_ - words);
+    method_ = method::gnu;
+  }
+
+  bool init_sysv(const elf_file<Traits>& file, const elf_section& section, std::size_t file_size) {
+    // nbucket, nchain, buckets[nbucket], chain[nchain]
+    if (section.link >= file.section_count() || !file.in_file(section, file_size) || section.size < 2 * sizeof(std::uint32_t)) {
+      return false;
+    }
+    auto words = file.template at<std::uint32_t>(section.offset);
+    if (!get(words[0]) || 2 + std::uint64_t{get(words[0])} + get(words[1]) > section.size / sizeof(std::uint32_t)) {
+      return false;
+    }
+    symbols_ = elf_symbol_table<Traits>{file, file.section(section.link), file_size};
+    if (symbols_.empty()) {
+      return false;
+    }
+    init_sysv(words);
+    return true;
+  }
+
+  void init_sysv(const std::uint32_t* words) {
+    nbuckets_ = get(words[0]);
+    buckets_ = words + 2;
+    chain_ = buckets_ + nbuckets_;
+    chain_size_ = get(words[1]);
+    method_ = method::sysv;
+  }
+
+  // DT_GNU_HASH, else DT_HASH, over DT_SYMTAB; neither records the symbol count, so it comes from the hash table:
+  // DT_HASH's nchain, or the end of the GNU chain that starts at the highest bucket
+  int open_dynamic(const elf_file<Traits>& file, std::size_t file_size) {
+    using namespace binlab::ELF;
+    *this = {};
+    elf_segment_index segments;
+    if (segments.open(file, file_size) || !segments.has_dynamic()) {
+      return -1;
+    }
+    std::uint64_t gnu = 0, sysv = 0, symtab = 0, strtab = 0, strsz = 0;
+    segments.for_each_dynamic(file, [&](std::int64_t tag, std::uint64_t value) {
+      switch (tag) {
+        case DT_GNU_HASH: gnu = value; break;
+        case DT_HASH: sysv = value; break;
+        case DT_SYMTAB: symtab = value; break;
+        case DT_STRTAB: strtab = value; break;
+        case DT_STRSZ: strsz = value; break;
+      }
+    });
+    auto symbols = reinterpret_cast<const typename Traits::sym_type*>(segments.translate(symtab, sizeof(typename Traits::sym_type)));
+    auto strings = segments.translate(strtab, 1);
+    if (!symbols || !strings) {
+      return -1;
+    }
+    const std::size_t symbols_available = segments.available(symtab) / sizeof(*symbols);
+    const std::size_t strings_size = std::min<std::uint64_t>(strsz ? strsz : ~std::uint64_t{0}, segments.available(strtab));
+
+    if (auto words = reinterpret_cast<const std::uint32_t*>(segments.translate(gnu, 4 * sizeof(std::uint32_t)))) {
+      const std::size_t words_available = segments.available(gnu) / sizeof(std::uint32_t);
+      const std::size_t nbuckets = get(words[0]), bloom_words = get(words[2]) * (sizeof(word_type) / sizeof(std::uint32_t));
+      if (gnu_fits(words, std::uint64_t{words_available} * sizeof(std::uint32_t))) {
+        auto buckets = words + 4 + bloom_words;
+        const std::size_t symoffset = get(words[1]), chain_available = words_available - 4 - bloom_words - nbuckets;
+        std::size_t last = 0;
+        for (std::size_t b = 0; b < nbuckets; ++b) {
+          last = std::max<std::size_t>(last, get(buckets[b]));
+        }
+        std::size_t count = symoffset;
+        if (last >= symoffset) {
+          auto i = last - symoffset;
+          while (i < chain_available && !(get(buckets[nbuckets + i]) & 1)) {
+            ++i;
+          }
+          count = symoffset + i + 1;
+        }
+        symbols_ = elf_symbol_table<Traits>{symbols, std::min(count, symbols_available), strings, strings_size};
+        init_gnu(words, words_available);
+        return 0;
+      }
+    }
+    if (auto words = reinterpret_cast<const std::uint32_t*>(segments.translate(sysv, 2 * sizeof(std::uint32_t)))) {
+      const std::size_t words_available = segments.available(sysv) / sizeof(std::uint32_t);
+      const std::size_t nbuckets = get(words[0]), nchain = get(words[1]);
+      if (nbuckets && nbuckets <= words_available - 2 && nchain <= words_available - 2 - nbuckets) {
+        symbols_ = elf_symbol_table<Traits>{symbols, std::min(nchain, symbols_available), strings, strings_size};
+        init_sysv(words);
+        return 0;
+      }
+    }
+    return -1;
+  }
+
+  // the defined symbols by name
+  void build_index() {
+    std::size_t defined = 0;
+    for (std::size_t i = 1; i < symbols_.size(); ++i) {
+      defined += symbols_.section_of(i) != binlab::ELF::SHN_UNDEF;
+    }
+    names_.reset(defined);
+    for (std::size_t i = 1; i < symbols_.size(); ++i) {
+      if (symbols_.section_of(i) != binlab::ELF::SHN_UNDEF) {
+        names_.insert(symbols_.name_of(i), i);
+      }
+    }
+    method_ = method::index;
+  }
+
+  bool match(std::size_t index, std::string_view name) const {
+    return index < symbols_.size() && symbols_.section_of(index) != binlab::ELF::SHN_UNDEF && symbols_.name_of(index) == name;
+  }
+
+  std::size_t find_gnu(std::string_view name) const {
+    const auto h = gnu_hash(name);
+    const auto word = Traits::get(bloom_[(h / word_bits) & bloom_mask_]);
+    const auto bits = (word_type{1} << (h % word_bits)) | (word_type{1} << ((h >> bloom_shift_) % word_bits));
+    if ((word & bits) != bits) {
+      return npos;
+    }
+    std::size_t index = get(buckets_[h % nbuckets_]);
+    if (index < symoffset_) {
+      return npos;
+    }
+    for (; index < symbols_.size() && index - symoffset_ < chain_size_; ++index) {
+      auto entry = get(chain_[index - symoffset_]);
+      if ((entry | 1) == (h | 1) && match(index, name)) {
+        return index;
+      }
+      if (entry & 1) {
+        break;
+      }
+    }
+    return npos;
+  }
+
+  std::size_t find_sysv(std::string_view name) const {
+    // a chain longer than the table means a cycle in a corrupt file
+    std::size_t steps = 0;
+    for (std::size_t index = get(buckets_[sysv_hash(name) % nbuckets_]); index && index < symbols_.size() && index < chain_size_ && steps++ < symbols_.size(); index = get(chain_[index])) {
+      if (match(index, name)) {
+        return index;
+      }
+    }
+    return npos;
+  }
+
+  std::size_t find_index(std::string_view name) const {
+    auto index = names_.find(name, [this, name](std::size_t i) { return match(i, name); });
+    return (index == name_index::npos) ? npos : index;
+  }
+
+  method method_ = method::none;
+  elf_symbol_table<Traits> symbols_;
+  std::uint32_t nbuckets_ = 0;
+  std::uint32_t symoffset_ = 0;
+  std::uint32_t bloom_mask_ = 0;
+  std::uint32_t bloom_shift_ = 0;
+  const word_type* bloom_ = nullptr;
+  const std::uint32_t* buckets_ = nullptr;
+  const std::uint32_t* chain_ = nullptr;
+  std::size_t chain_size_ = 0;  // words in chain_
+  name_index names_;  // method::index
+};
+
+#endif  // BINLAB_ELF_LOOKUP_H_
@@ -0,0 +1,443 @@
+// elf_relocate.h
+
+#ifndef BINLAB_ELF_RELOCATE_H_
+#define BINLAB_ELF_RELOCATE_H_
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/ELF.h"
+#include "cpu_dispatch.h"
+#include "elf_file.h"
+#include "elf_segments.h"
+
+struct relocation_stats {
+  std::size_t relative = 0;     // B + A, including the DT_RELACOUNT run and DT_RELR
+  std::size_t symbolic = 0;     // S + A with the symbol defined in the image
+  std::size_t unresolved = 0;   // symbol from another module; the target is left as is
+  std::size_t skipped = 0;      // COPY and TLS, which only mean something in a live process
+  std::size_t unsupported = 0;  // unknown type, or a target outside the image
+};
+
+// the largest loaded layout load_segments allocates, zero-filled, in one piece
+inline constexpr std::uint64_t max_load_span = std::uint64_t{1} << 32;
+
+// the loaded layout: every PT_LOAD segment copied to its p_vaddr relative to the lowest one, zero past p_filesz;
+// -1 when there is nothing to load, a segment lies outside the file or wraps the address space, or the span is
+// wider than the segments plus an alignment gap before each (or than max_load_span)
+template <typename Traits>
+int load_segments(const elf_file<Traits>& file, std::size_t file_size, std::vector<char>& image, std::uint64_t& first) {
+  std::uint64_t low = ~std::uint64_t{0}, high = 0, total = 0;
+  bool valid = true;
+  file.for_each_segment([&](std::size_t, const elf_segment& segment) {
+    if (segment.type != binlab::ELF::PT_LOAD) {
+      return;
+    }
+    valid = valid && segment.offset <= file_size && segment.filesz <= file_size - segment.offset && segment.filesz <= segment.memsz &&
+            segment.memsz <= ~std::uint64_t{0} - segment.vaddr;
+    low = std::min(low, segment.vaddr);
+    high = std::max(high, segment.vaddr + segment.memsz);
+    const auto gap = std::max<std::uint64_t>(segment.align, 0x1000);
+    total = std::min(total + std::min(segment.memsz, max_load_span) + std::min(gap, max_load_span), 2 * max_load_span);
+  });
+  if (!valid || low >= high || high - low > std::min(total, max_load_span)) {
+    return -1;
+  }
+  image.assign(high - low, 0);
+  file.for_each_segment([&](std::size_t, const elf_segment& segment) {
+    if (segment.type == binlab::ELF::PT_LOAD) {
+      std::memcpy(&image[segment.vaddr - low], file.base() + segment.offset, segment.filesz);
+    }
+  });
+  first = low;
+  return 0;
+}
+
+namespace relocate {
+
+// the leading R_*_RELATIVE run of DT_RELA that DT_RELACOUNT announces, for 64-bit images in host byte order:
+// image[r_offset - first] = base + r_addend. Returns the index of the first entry that is not a RELATIVE
+// relocation with a target inside the image (so the caller can take the slow path for it), or `count`.
+inline std::size_t relative_run_scalar(const binlab::ELF::Elf64_Rela* rela, std::size_t count, std::uint64_t type, char* image,
+                                       std::uint64_t first, std::size_t size, std::uint64_t base) {
+  for (std::size_t i = 0; i < count; ++i) {
+    auto rel = rela[i].r_offset - first;
+    if (rela[i].r_info != type || size < 8 || rel > size - 8) {
+      return i;
+    }
+    auto value = base + rela[i].r_addend;
+    std::memcpy(&image[rel], &value, 8);
+  }
+  return count;
+}
+
+#if defined(BINLAB_HAVE_AVX512)
+// eight entries per iteration: the 24 words are three loads, split into fields by two permutes each, checked
+// together and scattered; overlapping targets resolve in entry order as in the scalar loop. (gathering the fields,
+// or an avx2 version with scalar stores, measured no faster than relative_run_scalar)
+BINLAB_TARGET_AVX512 inline std::size_t relative_run_avx512(const binlab::ELF::Elf64_Rela* rela, std::size_t count, std::uint64_t type, char* image,
+                                                            std::uint64_t first, std::size_t size, std::uint64_t base) {
+  if (size < 8) {
+    return 0;
+  }
+  // word k of the block sits in register k / 8; the first permute picks from r0:r1, the second blends in r2
+  const auto offset01 = _mm512_setr_epi64(0, 3, 6, 9, 12, 15, 0, 0), offset2 = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 10, 13);
+  const auto info01 = _mm512_setr_epi64(1, 4, 7, 10, 13, 0, 0, 0), info2 = _mm512_setr_epi64(0, 1, 2, 3, 4, 8, 11, 14);
+  const auto addend01 = _mm512_setr_epi64(2, 5, 8, 11, 14, 0, 0, 0), addend2 = _mm512_setr_epi64(0, 1, 2, 3, 4, 9, 12, 15);
+  const auto types = _mm512_set1_epi64(static_cast<long long>(type));
+  const auto firsts = _mm512_set1_epi64(static_cast<long long>(first));
+  const auto limit = _mm512_set1_epi64(static_cast<long long>(size - 8));
+  const auto bases = _mm512_set1_epi64(static_cast<long long>(base));
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    auto words = reinterpret_cast<const char*>(&rela[i]);
+    auto r0 = _mm512_loadu_si512(words), r1 = _mm512_loadu_si512(words + 64), r2 = _mm512_loadu_si512(words + 128);
+    auto rel = _mm512_sub_epi64(_mm512_permutex2var_epi64(_mm512_permutex2var_epi64(r0, offset01, r1), offset2, r2), firsts);
+    auto info = _mm512_permutex2var_epi64(_mm512_permutex2var_epi64(r0, info01, r1), info2, r2);
+    auto value = _mm512_add_epi64(_mm512_permutex2var_epi64(_mm512_permutex2var_epi64(r0, addend01, r1), addend2, r2), bases);
+    if ((_mm512_cmple_epu64_mask(rel, limit) & _mm512_cmpeq_epi64_mask(info, types)) != 0xff) {
+      break;
+    }
+    _mm512_i64scatter_epi64(image, rel, value, 1);
+  }
+  return i + relative_run_scalar(rela + i, count - i, type, image, first, size, base);
+}
+#endif  // !BINLAB_HAVE_AVX512
+
+using relative_run_type = std::size_t (*)(const binlab::ELF::Elf64_Rela*, std::size_t, std::uint64_t, char*, std::uint64_t, std::size_t, std::uint64_t);
+
+inline relative_run_type select_relative_run() {
+#if defined(BINLAB_HAVE_AVX512)
+  if (__builtin_cpu_supports("avx512f")) {
+    return relative_run_avx512;
+  }
+#endif  // !BINLAB_HAVE_AVX512
+  return relative_run_scalar;
+}
+
+inline std::size_t relative_run(const binlab::ELF::Elf64_Rela* rela, std::size_t count, std::uint64_t type, char* image, std::uint64_t first,
+                                std::size_t size, std::uint64_t base) {
+  static const auto kernel = select_relative_run();
+  return kernel(rela, count, type, image, first, size, base);
+}
+
+}  // namespace relocate
+
+// applies an image's dynamic relocations (DT_RELA, DT_REL, DT_JMPREL and DT_RELR) for x86-64 and AArch64 to its
+// loaded layout, the way ld.so would with BIND_NOW: the DT_RELACOUNT run of RELATIVE entries goes
+// through a bulk path and symbols defined in the image bind to themselves. Symbols from other modules are left
+// unresolved, as their addresses depend on where those are loaded; -R checks that they exist
+template <typename Traits>
+class elf_relocator {
+ public:
+  using addr_type = Traits::addr_type;
+  using sym_type = Traits::sym_type;
+  using rel_type = Traits::rel_type;
+  using rela_type = Traits::rela_type;
+
+  elf_relocator() = default;
+
+  // -1 when the image has no dynamic segment, is for another machine, or its tables lie outside the file
+  int open(const elf_file<Traits>& file, std::size_t file_size) {
+    using namespace binlab::ELF;
+    *this = {};
+    file_ = &file;
+    file_size_ = file_size;
+    switch (file.get(file.header().e_machine)) {
+      case EM_X86_64: machine_ = EM_X86_64; break;
+      case EM_AARCH64: machine_ = EM_AARCH64; break;
+      default: return -1;
+    }
+
+    if (segments_.open(file, file_size) || !segments_.has_dynamic()) {
+      return -1;
+    }
+
+    std::uint64_t rela = 0, rela_size = 0, rel = 0, rel_size = 0, jmprel = 0, jmprel_size = 0, relr = 0, relr_size = 0, symtab = 0;
+    std::uint64_t pltrel = DT_RELA;
+    segments_.for_each_dynamic(file, [&](std::int64_t tag, std::uint64_t value) {
+      switch (tag) {
+        case DT_RELA: rela = value; break;
+        case DT_RELASZ: rela_size = value; break;
+        case DT_RELACOUNT: relacount_ = value; break;
+        case DT_REL: rel = value; break;
+        case DT_RELSZ: rel_size = value; break;
+        case DT_JMPREL: jmprel = value; break;
+        case DT_PLTRELSZ: jmprel_size = value; break;
+        case DT_PLTREL: pltrel = value; break;
+        case DT_RELR: relr = value; break;
+        case DT_RELRSZ: relr_size = value; break;
+        case DT_SYMTAB: symtab = value; break;
+      }
+    });
+
+    rela_ = table<rela_type>(rela, rela_size, rela_count_);
+    rel_ = table<rel_type>(rel, rel_size, rel_count_);
+    relr_ = table<addr_type>(relr, relr_size, relr_count_);
+    if (pltrel == DT_RELA) {
+      jmprela_ = table<rela_type>(jmprel, jmprel_size, jmprel_count_);
+    } else {
+      jmprel_ = table<rel_type>(jmprel, jmprel_size, jmprel_count_);
+    }
+    if ((rela_size && !rela_) || (rel_size && !rel_) || (relr_size && !relr_) || (jmprel_size && !jmprela_ && !jmprel_)) {
+      return -1;
+    }
+    relacount_ = std::min<std::uint64_t>(relacount_, rela_count_);
+    if (auto p = translate(symtab, sizeof(sym_type))) {
+      symtab_ = reinterpret_cast<const sym_type*>(p);
+      symtab_count_ = (file_size_ - (p - file.base())) / sizeof(sym_type);
+    }
+    return 0;
+  }
+
+  // number of relocation entries; a RELR bitmap word counts as one
+  std::size_t size() const { return rela_count_ + rel_count_ + jmprel_count_ + relr_count_; }
+
+  // relocates `image` (the loaded layout starting at vaddr `first`, see load_segments) for load bias `base`
+  relocation_stats apply(char* image, std::uint64_t first, std::size_t size, std::uint64_t base) const {
+    relocation_stats stats;
+    context ctx{image, first, size, base, stats};
+
+    std::size_t i = 0;
+    if constexpr (sizeof(addr_type) == 8 && !Traits::swap) {
+      while (i < relacount_) {
+        auto done = relocate::relative_run(reinterpret_cast<const binlab::ELF::Elf64_Rela*>(rela_) + i, relacount_ - i, relative_type(), image, first, size, base);
+        stats.relative += done;
+        i += done;
+        if (i < relacount_) {
+          apply_rela(ctx, rela_[i++]);
+        }
+      }
+    }
+    for (; i < rela_count_; ++i) {
+      apply_rela(ctx, rela_[i]);
+    }
+    for (std::size_t j = 0; j < rel_count_; ++j) {
+      apply_rel(ctx, rel_[j]);
+    }
+    apply_relr(ctx);
+    for (std::size_t j = 0; j < jmprel_count_; ++j) {
+      if (jmprela_) {
+        apply_rela(ctx, jmprela_[j]);
+      } else {
+        apply_rel(ctx, jmprel_[j]);
+      }
+    }
+    return stats;
+  }
+
+ private:
+  enum class kind { none, relative, absolute, absolute32, pc32, pc64, got, plt, copy_or_tls, unknown };
+
+  struct context {
+    char* image;
+    std::uint64_t first;
+    std::size_t size;
+    std::uint64_t base;
+    relocation_stats& stats;
+  };
+
+  static constexpr std::uint32_t r_sym(std::uint64_t info) { return static_cast<std::uint32_t>(sizeof(addr_type) == 8 ? info >> 32 : info >> 8); }
+  static constexpr std::uint32_t r_type(std::uint64_t info) { return static_cast<std::uint32_t>(sizeof(addr_type) == 8 ? info & 0xffffffff : info & 0xff); }
+
+  std::uint64_t relative_type() const {
+    if (machine_ == binlab::ELF::EM_X86_64) {
+      return binlab::ELF::R_X86_64_RELATIVE;
+    }
+    return binlab::ELF::R_AARCH64_RELATIVE;
+  }
+
+  kind classify(std::uint32_t type) const {
+    using namespace binlab::ELF;
+    if (machine_ == EM_X86_64) {
+      switch (type) {
+        case R_X86_64_NONE: return kind::none;
+        case R_X86_64_RELATIVE:
+        case R_X86_64_RELATIVE64:
+        case R_X86_64_IRELATIVE: return kind::relative;  // the resolver's address; the ifunc is not run
+        case R_X86_64_64: return kind::absolute;
+        case R_X86_64_32:
+        case R_X86_64_32S: return kind::absolute32;
+        case R_X86_64_PC32: return kind::pc32;
+        case R_X86_64_PC64: return kind::pc64;
+        case R_X86_64_GLOB_DAT: return kind::got;
+        case R_X86_64_JUMP_SLOT: return kind::plt;
+        case R_X86_64_COPY:
+        case R_X86_64_DTPMOD64:
+        case R_X86_64_DTPOFF64:
+        case R_X86_64_TPOFF64:
+        case R_X86_64_TLSDESC: return kind::copy_or_tls;
+        default: return kind::unknown;
+      }
+    }
+    switch (type) {
+      case R_AARCH64_NONE: return kind::none;
+      case R_AARCH64_RELATIVE:
+      case R_AARCH64_IRELATIVE: return kind::relative;
+      case R_AARCH64_ABS64: return kind::absolute;
+      case R_AARCH64_ABS32: return kind::absolute32;
+      case R_AARCH64_PREL32: return kind::pc32;
+      case R_AARCH64_PREL64: return kind::pc64;
+      case R_AARCH64_GLOB_DAT: return kind::got;
+      case R_AARCH64_JUMP_SLOT: return kind::plt;
+      case R_AARCH64_COPY:
+      case R_AARCH64_TLS_DTPMOD:
+      case R_AARCH64_TLS_DTPREL:
+      case R_AARCH64_TLS_TPREL:
+      case R_AARCH64_TLSDESC: return kind::copy_or_tls;
+      default: return kind::unknown;
+    }
+  }
+
+  // file bytes behind [vaddr, vaddr + size) of one PT_LOAD segment, or nullptr
+  const char* translate(std::uint64_t vaddr, std::uint64_t size) const { return segments_.translate(vaddr, size); }
+
+  template <typename T>
+  const T* table(std::uint64_t vaddr, std::uint64_t size, std::size_t& count) const {
+    count = 0;
+    if (!size) {
+      return nullptr;
+    }
+    auto p = translate(vaddr, size);
+    if (p) {
+      count = size / sizeof(T);
+    }
+    return reinterpret_cast<const T*>(p);
+  }
+
+  template <typename T>
+  static T load(const char* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return Traits::get(value);
+  }
+
+  template <typename T>
+  static void store(char* p, T value) {
+    value = Traits::get(value);
+    std::memcpy(p, &value, sizeof(T));
+  }
+
+  // S for symbol `index`: B + st_value when the image defines it; an undefined weak reference is 0 as in ld.so
+  bool symbol_value(context& ctx, std::uint32_t index, std::uint64_t& value) const {
+    if (!symtab_ || index >= symtab_count_) {
+      return false;
+    }
+    const auto& sym = symtab_[index];
+    auto section = Traits::get(sym.st_shndx);
+    if (section != binlab::ELF::SHN_UNDEF) {
+      value = Traits::get(sym.st_value) + (section == binlab::ELF::SHN_ABS ? 0 : ctx.base);
+      return true;
+    }
+    if ((sym.st_info >> 4) == binlab::ELF::STB_WEAK) {
+      value = 0;
+      return true;
+    }
+    return false;
+  }
+
+  // one relocation with explicit (`has_addend`) or in-place addend
+  void apply_one(context& ctx, std::uint64_t offset, std::uint64_t info, std::int64_t addend, bool has_addend) const {
+    auto k = classify(r_type(info));
+    if (k == kind::none) {
+      return;
+    }
+    if (k == kind::copy_or_tls) {
+      ++ctx.stats.skipped;
+      return;
+    }
+    const std::size_t width = (k == kind::absolute32 || k == kind::pc32) ? 4 : (k == kind::pc64) ? 8 : sizeof(addr_type);
+    auto rel = offset - ctx.first;
+    if (k == kind::unknown || ctx.size < width || rel > ctx.size - width) {
+      ++ctx.stats.unsupported;
+      return;
+    }
+    auto target = ctx.image + rel;
+    auto a = has_addend ? static_cast<std::uint64_t>(addend) : (width == 4) ? static_cast<std::uint64_t>(static_cast<std::int32_t>(load<std::uint32_t>(target))) : load<addr_type>(target);
+    if (k == kind::relative) {
+      store<addr_type>(target, static_cast<addr_type>(ctx.base + a));
+      ++ctx.stats.relative;
+      return;
+    }
+
+    std::uint64_t s = 0;
+    if (!symbol_value(ctx, r_sym(info), s)) {
+      // an unbound PLT slot keeps pointing at its lazy-binding stub, which moves with the image
+      if (k == kind::plt) {
+        store<addr_type>(target, static_cast<addr_type>(ctx.base + load<addr_type>(target)));
+      }
+      ++ctx.stats.unresolved;
+      return;
+    }
+    switch (k) {
+      case kind::absolute: store<addr_type>(target, static_cast<addr_type>(s + a)); break;
+      case kind::got:
+      case kind::plt: store<addr_type>(target, static_cast<addr_type>(has_addend ? s + a : s)); break;
+      case kind::absolute32: store<std::uint32_t>(target, static_cast<std::uint32_t>(s + a)); break;
+      case kind::pc32: store<std::uint32_t>(target, static_cast<std::uint32_t>(s + a - (ctx.base + offset))); break;
+      case kind::pc64: store<std::uint64_t>(target, s + a - (ctx.base + offset)); break;
+      default: break;
+    }
+    ++ctx.stats.symbolic;
+  }
+
+  void apply_rela(context& ctx, const rela_type& r) const {
+    apply_one(ctx, Traits::get(r.r_offset), Traits::get(r.r_info), Traits::get(r.r_addend), true);
+  }
+
+  void apply_rel(context& ctx, const rel_type& r) const {
+    apply_one(ctx, Traits::get(r.r_offset), Traits::get(r.r_info), 0, false);
+  }
+
+  // an even entry is the address of one relative relocation; an odd one is a bitmap over the next
+  // 8 * sizeof(addr_type) - 1 words
+  void apply_relr(context& ctx) const {
+    constexpr std::uint64_t word = sizeof(addr_type);
+    auto relocate_at = [&ctx](std::uint64_t vaddr) {
+      auto rel = vaddr - ctx.first;
+      if (ctx.size < word || rel > ctx.size - word) {
+        ++ctx.stats.unsupported;
+        return;
+      }
+      store<addr_type>(ctx.image + rel, static_cast<addr_type>(ctx.base + load<addr_type>(ctx.image + rel)));
+      ++ctx.stats.relative;
+    };
+    std::uint64_t where = 0;
+    for (std::size_t i = 0; i < relr_count_; ++i) {
+      std::uint64_t entry = Traits::get(relr_[i]);
+      if (!(entry & 1)) {
+        relocate_at(entry);
+        where = entry + word;
+        continue;
+      }
+      for (auto bits = entry >> 1; bits; bits &= bits - 1) {
+        relocate_at(where + std::countr_zero(bits) * word);
+      }
+      where += (8 * word - 1) * word;
+    }
+  }
+
+  const elf_file<Traits>* file_ = nullptr;
+  std::size_t file_size_ = 0;
+  std::uint32_t machine_ = 0;
+  elf_segment_index segments_;
+  const rela_type* rela_ = nullptr;
+  const rel_type* rel_ = nullptr;
+  const rela_type* jmprela_ = nullptr;
+  const rel_type* jmprel_ = nullptr;
+  const addr_type* relr_ = nullptr;
+  std::size_t rela_count_ = 0;
+  std::size_t rel_count_ = 0;
+  std::size_t jmprel_count_ = 0;
+  std::size_t relr_count_ = 0;
+  std::uint64_t relacount_ = 0;
+  const sym_type* symtab_ = nullptr;
+  std::size_t symtab_count_ = 0;
+};
+
+#endif  // BINLAB_ELF_RELOCATE_H_
@@ -0,0 +1,106 @@
+// elf_segments.h
+
+#ifndef BINLAB_ELF_SEGMENTS_H_
+#define BINLAB_ELF_SEGMENTS_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/ELF.h"
+#include "address_mode_policy.h"
+#include "elf_file.h"
+
+// an ELF image navigated by its program headers alone, the way the dynamic loader sees it: the PT_LOAD segments
+// sorted by p_vaddr for O(log n) virtual address to file offset translation (the same section_index the PE side
+// uses), and the PT_DYNAMIC table. Works on images whose section headers were stripped; each segment's file part
+// is clamped to the file, so every translated range can be read
+class elf_segment_index {
+ public:
+  elf_segment_index() = default;
+  // the index points into loads_, which a move carries along but a copy would not
+  elf_segment_index(const elf_segment_index&) = delete;
+  elf_segment_index& operator=(const elf_segment_index&) = delete;
+  elf_segment_index(elf_segment_index&&) = default;
+  elf_segment_index& operator=(elf_segment_index&&) = default;
+
+  // -1 when the program header table lies outside the file or nothing is loaded
+  template <typename Traits>
+  int open(const elf_file<Traits>& file, std::size_t file_size) {
+    using namespace binlab::ELF;
+    *this = elf_segment_index{};
+    const std::size_t phoff = file.get(file.header().e_phoff);
+    if (phoff > file_size || file.segment_count() > (file_size - phoff) / sizeof(typename Traits::phdr_type)) {
+      return -1;
+    }
+    base_ = file.base();
+    file.for_each_segment([&](std::size_t, const elf_segment& segment) {
+      if ((segment.type != PT_LOAD && segment.type != PT_DYNAMIC) || segment.offset > file_size) {
+        return;
+      }
+      auto clamped = segment;
+      clamped.filesz = std::min<std::uint64_t>(segment.filesz, file_size - segment.offset);
+      if (segment.type == PT_LOAD) {
+        loads_.push_back(clamped);
+      } else {
+        dynamic_ = clamped;
+      }
+    });
+    index_.assign(loads_.data(), loads_.data() + loads_.size());
+    return loads_.empty() ? -1 : 0;
+  }
+
+  std::size_t size() const { return loads_.size(); }
+  bool empty() const { return loads_.empty(); }
+
+  // the file offset of `vaddr`, when the file holds all `size` bytes from there within one segment
+  bool to_offset(std::uint64_t vaddr, std::uint64_t size, std::size_t& offset) const {
+    auto segment = index_.find(vaddr);
+    if (!segment) {
+      return false;
+    }
+    const auto delta = vaddr - segment->vaddr;
+    if (delta > segment->filesz || size > segment->filesz - delta) {
+      return false;
+    }
+    offset = segment->offset + delta;
+    return true;
+  }
+
+  const char* translate(std::uint64_t vaddr, std::uint64_t size) const {
+    std::size_t offset = 0;
+    return to_offset(vaddr, size, offset) ? base_ + offset : nullptr;
+  }
+
+  // the file bytes from `vaddr` to the end of its segment; 0 when unmapped or in the zero-filled tail
+  std::size_t available(std::uint64_t vaddr) const {
+    auto segment = index_.find(vaddr);
+    return (segment && vaddr - segment->vaddr < segment->filesz) ? segment->filesz - (vaddr - segment->vaddr) : 0;
+  }
+
+  // calls fn(tag, value) for each PT_DYNAMIC entry up to DT_NULL
+  template <typename Traits, typename Fn>
+  void for_each_dynamic(const elf_file<Traits>& file, Fn fn) const {
+    using dyn_type = Traits::dyn_type;
+    auto entries = file.template at<dyn_type>(dynamic_.offset);
+    for (std::size_t i = 0, n = dynamic_.filesz / sizeof(dyn_type); i < n; ++i) {
+      auto tag = static_cast<std::int64_t>(file.get(entries[i].d_tag));
+      if (tag == binlab::ELF::DT_NULL) {
+        break;
+      }
+      fn(tag, static_cast<std::uint64_t>(file.get(entries[i].d_un.d_val)));
+    }
+  }
+
+  bool has_dynamic() const { return dynamic_.filesz != 0; }
+
+ private:
+  const char* base_ = nullptr;
+  std::vector<elf_segment> loads_;
+  elf_segment dynamic_{};
+  section_index<elf_segment, relative_virtual_address_policy> index_;
+};
+
+#endif  // BINLAB_ELF_SEGMENTS_H_
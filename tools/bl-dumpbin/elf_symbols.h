@@ -0,0 +1,128 @@
+// elf_symbols.h
+
+#ifndef BINLAB_ELF_SYMBOLS_H_
+#define BINLAB_ELF_SYMBOLS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/ELF.h"
+#include "elf_file.h"
+
+struct elf_symbol {
+  std::size_t index;
+  std::string_view name;  // points into the image's string table
+  std::uint64_t value;
+  std::uint64_t size;
+  std::uint16_t section;
+  std::uint8_t bind;
+  std::uint8_t type;
+  std::uint8_t visibility;
+};
+
+// view over one SHT_SYMTAB/SHT_DYNSYM section and the string table its sh_link names; nothing is copied
+template <typename Traits>
+class elf_symbol_table {
+ public:
+  using sym_type = Traits::sym_type;
+
+  elf_symbol_table() = default;
+  // empty unless the section headers, the table and its string table all lie within the `file_size` bytes of the file
+  elf_symbol_table(const elf_file<Traits>& file, const elf_section& table, std::size_t file_size) {
+    using namespace binlab::ELF;
+    if ((table.type != SHT_SYMTAB && table.type != SHT_DYNSYM) || !file.sections_within(file_size) || table.link >= file.section_count()) {
+      return;
+    }
+    auto strtab = file.section(table.link);
+    auto entsize = table.entsize ? table.entsize : sizeof(sym_type);
+    if (entsize != sizeof(sym_type) || strtab.type != SHT_STRTAB || !file.in_file(table, file_size) || !file.in_file(strtab, file_size)) {
+      return;
+    }
+    symbols_ = file.template at<sym_type>(table.offset);
+    count_ = table.size / entsize;
+    strings_ = file.template at<char>(strtab.offset);
+    strings_size_ = strtab.size;
+  }
+
+  // a table found without section headers, through DT_SYMTAB and DT_STRTAB; the caller bounds both
+  elf_symbol_table(const sym_type* symbols, std::size_t count, const char* strings, std::size_t strings_size)
+      : symbols_{symbols}, count_{count}, strings_{strings}, strings_size_{strings_size} {}
+
+  std::size_t size() const { return count_; }
+  bool empty() const { return !count_; }
+
+  // bounded by the string table, so a corrupt st_name yields an empty name instead of a wild read
+  std::string_view name(std::uint32_t offset) const {
+    if (offset >= strings_size_) {
+      return {};
+    }
+    auto first = strings_ + offset;
+    auto last = static_cast<const char*>(std::memchr(first, 0, strings_size_ - offset));
+    return {first, last ? static_cast<std::size_t>(last - first) : strings_size_ - offset};
+  }
+
+  std::string_view name_of(std::size_t i) const { return name(Traits::get(symbols_[i].st_name)); }
+  std::uint16_t section_of(std::size_t i) const { return Traits::get(symbols_[i].st_shndx); }
+
+  elf_symbol operator[](std::size_t i) const {
+    auto& sym = symbols_[i];
+    return {i, name(Traits::get(sym.st_name)), Traits::get(sym.st_value), Traits::get(sym.st_size), Traits::get(sym.st_shndx),
+            static_cast<std::uint8_t>(ELF64_ST_BIND(sym.st_info)), static_cast<std::uint8_t>(ELF64_ST_TYPE(sym.st_info)),
+            static_cast<std::uint8_t>(ELF64_ST_VISIBILITY(sym.st_other))};
+  }
+
+  template <typename Fn>
+  void for_each(Fn fn) const {
+    for (std::size_t i = 0; i < count_; ++i) {
+      fn((*this)[i]);
+    }
+  }
+
+ private:
+  const sym_type* symbols_ = nullptr;
+  std::size_t count_ = 0;
+  const char* strings_ = nullptr;
+  std::size_t strings_size_ = 0;
+};
+
+inline std::string_view elf_bind_name(std::uint8_t bind) {
+  using namespace binlab::ELF;
+  switch (bind) {
+    case STB_LOCAL: return "LOCAL";
+    case STB_GLOBAL: return "GLOBAL";
+    case STB_WEAK: return "WEAK";
+    case STB_GNU_UNIQUE: return "UNIQUE";
+    default: return "<other>";
+  }
+}
+
+inline std::string_view elf_type_name(std::uint8_t type) {
+  using namespace binlab::ELF;
+  switch (type) {
+    case STT_NOTYPE: return "NOTYPE";
+    case STT_OBJECT: return "OBJECT";
+    case STT_FUNC: return "FUNC";
+    case STT_SECTION: return "SECTION";
+    case STT_FILE: return "FILE";
+    case STT_COMMON: return "COMMON";
+    case STT_TLS: return "TLS";
+    case STT_GNU_IFUNC: return "IFUNC";
+    default: return "<other>";
+  }
+}
+
+inline std::string_view elf_visibility_name(std::uint8_t visibility) {
+  using namespace binlab::ELF;
+  switch (visibility) {
+    case STV_DEFAULT: return "DEFAULT";
+    case STV_INTERNAL: return "INTERNAL";
+    case STV_HIDDEN: return "HIDDEN";
+    case STV_PROTECTED: return "PROTECTED";
+    default: return "<other>";
+  }
+}
+
+#endif  // BINLAB_ELF_SYMBOLS_H_
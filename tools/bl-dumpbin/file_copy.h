@@ -0,0 +1,99 @@
+// file_copy.h
+
+#ifndef BINLAB_FILE_COPY_H_
+#define BINLAB_FILE_COPY_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+
+#include "binlab/Config.h"
+
+#if defined(unix) || defined(__unix__) || defined(__unix)
+#include <fcntl.h>
+#include <unistd.h>
+#endif  // !unix
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif  // !__linux__
+
+// writes the file `path`: `count` bytes of the source at `offset`, zero-filled up to `size`. On Linux the bytes go
+// file to file inside the kernel (copy_file_range, else sendfile); otherwise they are written from `data`, the same
+// bytes already in memory (a mapping of the source), or read with pread when `data` is null. -1 on any failure,
+// which may leave a partial file behind
+inline int write_file_range(const char* path, int source, std::uint64_t offset, std::size_t count, std::size_t size, const char* data) {
+#if defined(unix) || defined(__unix__) || defined(__unix)
+  int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    return -1;
+  }
+  auto write_all = [fd](const char* p, std::size_t n) {
+    while (n) {
+      auto written = ::write(fd, p, n);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written <= 0) {
+        return false;
+      }
+      p += written;
+      n -= written;
+    }
+    return true;
+  };
+
+  std::size_t done = 0;
+#if defined(__linux__)
+  for (auto in = static_cast<off_t>(offset); done < count;) {
+    auto n = ::copy_file_range(source, &in, fd, nullptr, count - done, 0);
+    if (n <= 0) {
+      break;
+    }
+    done += n;
+  }
+  for (auto in = static_cast<off_t>(offset + done); done < count;) {
+    auto n = ::sendfile(fd, source, &in, count - done);
+    if (n <= 0) {
+      break;
+    }
+    done += n;
+  }
+#endif  // !__linux__
+  bool ok = true;
+  if (done < count && data) {
+    ok = write_all(data + done, count - done);
+    done = count;
+  }
+  if (done < count) {
+    constexpr std::size_t chunk = 1 << 16;
+    std::unique_ptr<char[]> buffer{new char[chunk]};
+    while (ok && done < count) {
+      auto n = ::pread(source, buffer.get(), std::min(chunk, count - done), offset + done);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      ok = n > 0 && write_all(buffer.get(), n);
+      done += std::max<decltype(n)>(n, 0);
+    }
+  }
+  ok = ok && (size <= count || !::ftruncate(fd, size));
+  return (::close(fd) || !ok) ? -1 : 0;
+#else
+  (void)source;
+  (void)offset;
+  if (!data) {
+    return -1;
+  }
+  std::ofstream os{path, std::ios::binary | std::ios::trunc};
+  os.write(data, count);
+  for (std::size_t n = count; n < size; ++n) {
+    os.put('\0');
+  }
+  return os ? 0 : -1;
+#endif  // !unix
+}
+
+#endif  // BINLAB_FILE_COPY_H_
@@ -0,0 +1,217 @@
+// hexdump_kernel.h
+
+#ifndef BINLAB_HEXDUMP_KERNEL_H_
+#define BINLAB_HEXDUMP_KERNEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "binlab/Config.h"
+#include "cpu_dispatch.h"
+
+namespace hexdump {
+
+// one row is " xx" * 16, two spaces, 16 printable characters and a newline, i.e. "%-48s  %-s\n"
+static constexpr std::size_t block = 16;
+static constexpr std::size_t text_column = 3 * block + 2;
+static constexpr std::size_t row_width = text_column + block + 1;
+
+static constexpr char xdigits[] = "0123456789abcdef";
+
+// same set as isprint() in the "C" locale
+inline constexpr bool is_printable(const std::uint8_t c) {
+  return static_cast<std::uint8_t>(c - 0x20) < 0x5f;
+}
+
+// a partial (or any) row; returns the number of characters written, at most row_width
+inline std::size_t format_row_scalar(const std::uint8_t* data, const std::size_t count, char* out) {
+  auto hex = out, str = out + text_column;
+  for (std::size_t j = 0; j < count; ++j) {
+    hex[3 * j + 0] = ' ';
+    hex[3 * j + 1] = xdigits[data[j] >> 4];
+    hex[3 * j + 2] = xdigits[data[j] & 0xf];
+    str[j] = is_printable(data[j]) ? static_cast<char>(data[j]) : ' ';
+  }
+  std::memset(&hex[3 * count], ' ', 3 * (block - count) + 2);
+  str[count] = '\n';
+  return text_column + count + 1;
+}
+
+inline void format_rows_scalar(const std::uint8_t* data, std::size_t rows, char* out) {
+  for (; rows; --rows, data += block, out += row_width) {
+    format_row_scalar(data, block, out);
+  }
+}
+
+#if defined(BINLAB_HAVE_SSE2)
+// 0xff for every byte that is_printable()
+inline __m128i printable_mask(const __m128i v) {
+  auto x = _mm_sub_epi8(v, _mm_set1_epi8(0x20));
+  return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(0x5e)), x);
+}
+
+inline __m128i nibbles_to_hex(const __m128i n) {
+  auto digits = _mm_add_epi8(n, _mm_set1_epi8('0'));
+  return _mm_add_epi8(digits, _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10)));
+}
+
+inline void format_rows_sse2(const std::uint8_t* data, std::size_t rows, char* out) {
+  const auto low = _mm_set1_epi8(0x0f);
+  const auto space = _mm_set1_epi8(' ');
+  for (; rows; --rows, data += block, out += row_width) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    auto hi = nibbles_to_hex(_mm_and_si128(_mm_srli_epi16(v, 4), low));
+    auto lo = nibbles_to_hex(_mm_and_si128(v, low));
+
+    alignas(16) char pairs[2 * block];
+    _mm_store_si128(reinterpret_cast<__m128i*>(&pairs[0]), _mm_unpacklo_epi8(hi, lo));
+    _mm_store_si128(reinterpret_cast<__m128i*>(&pairs[block]), _mm_unpackhi_epi8(hi, lo));
+    for (std::size_t j = 0; j < block; ++j) {
+      out[3 * j] = ' ';
+      std::memcpy(&out[3 * j + 1], &pairs[2 * j], 2);
+    }
+    out[3 * block + 0] = ' ';
+    out[3 * block + 1] = ' ';
+
+    auto mask = printable_mask(v);
+    auto str = _mm_or_si128(_mm_and_si128(mask, v), _mm_andnot_si128(mask, space));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[text_column]), str);
+    out[row_width - 1] = '\n';
+  }
+}
+
+// output column p of the 48 byte hex field is ' ' when p % 3 == 0, otherwise pair byte 2 * (p / 3) + p % 3 - 1;
+// the field is assembled as three 16 byte chunks from the pairs of bytes 0..7 (pairs0) and 8..15 (pairs1)
+struct hex_shuffle {
+  static constexpr char z = -1;
+  static constexpr char m0[16] = {z, 0, 1, z, 2, 3, z, 4, 5, z, 6, 7, z, 8, 9, z};
+  static constexpr char m1a[16] = {10, 11, z, 12, 13, z, 14, 15, z, z, z, z, z, z, z, z};
+  static constexpr char m1b[16] = {z, z, z, z, z, z, z, z, z, 0, 1, z, 2, 3, z, 4};
+  static constexpr char m2[16] = {5, z, 6, 7, z, 8, 9, z, 10, 11, z, 12, 13, z, 14, 15};
+  static constexpr char s1[16] = {0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0};
+};
+
+inline void store_row(char* row, __m128i c0, __m128i c1, __m128i c2, __m128i str) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&row[0]), c0);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&row[block]), c1);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&row[2 * block]), c2);
+  row[3 * block + 0] = ' ';
+  row[3 * block + 1] = ' ';
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&row[text_column]), str);
+  row[row_width - 1] = '\n';
+}
+#endif  // !BINLAB_HAVE_SSE2
+
+#if defined(BINLAB_HAVE_AVX2)
+BINLAB_TARGET_AVX2 inline __m256i printable_mask(const __m256i v) {
+  auto x = _mm256_sub_epi8(v, _mm256_set1_epi8(0x20));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(0x5e)), x);
+}
+
+BINLAB_TARGET_AVX2 inline __m256i broadcast256(const char* p) {
+  return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+// two rows per iteration, one per 128-bit lane, so every shuffle stays in-lane
+BINLAB_TARGET_AVX2 inline void format_rows_avx2(const std::uint8_t* data, std::size_t rows, char* out) {
+  const auto low = _mm256_set1_epi8(0x0f);
+  const auto space = _mm256_set1_epi8(' ');
+  const auto table = broadcast256(xdigits);
+  const auto m0 = broadcast256(hex_shuffle::m0), m1a = broadcast256(hex_shuffle::m1a), m1b = broadcast256(hex_shuffle::m1b), m2 = broadcast256(hex_shuffle::m2);
+  // shuffled-out columns are zero, so the separating spaces are or'ed in
+  const auto s0 = _mm256_and_si256(_mm256_cmpeq_epi8(m0, _mm256_set1_epi8(-1)), space);
+  const auto s1 = broadcast256(hex_shuffle::s1);
+  const auto s2 = _mm256_and_si256(_mm256_cmpeq_epi8(m2, _mm256_set1_epi8(-1)), space);
+
+  for (; rows >= 2; rows -= 2, data += 2 * block, out += 2 * row_width) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    auto hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    auto lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low));
+    auto pairs0 = _mm256_unpacklo_epi8(hi, lo);
+    auto pairs1 = _mm256_unpackhi_epi8(hi, lo);
+
+    auto c0 = _mm256_or_si256(_mm256_shuffle_epi8(pairs0, m0), s0);
+    auto c1 = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(pairs0, m1a), _mm256_shuffle_epi8(pairs1, m1b)), s1);
+    auto c2 = _mm256_or_si256(_mm256_shuffle_epi8(pairs1, m2), s2);
+
+    auto str = _mm256_blendv_epi8(space, v, printable_mask(v));
+
+    store_row(out, _mm256_castsi256_si128(c0), _mm256_castsi256_si128(c1), _mm256_castsi256_si128(c2), _mm256_castsi256_si128(str));
+    store_row(out + row_width, _mm256_extracti128_si256(c0, 1), _mm256_extracti128_si256(c1, 1), _mm256_extracti128_si256(c2, 1), _mm256_extracti128_si256(str, 1));
+  }
+  format_rows_sse2(data, rows, out);
+}
+#endif  // !BINLAB_HAVE_AVX2
+
+#if defined(BINLAB_HAVE_AVX512)
+// one bit per byte that is_printable()
+BINLAB_TARGET_AVX512 inline __mmask64 printable_mask(const __m512i v) {
+  return _mm512_cmple_epu8_mask(_mm512_sub_epi8(v, _mm512_set1_epi8(0x20)), _mm512_set1_epi8(0x5e));
+}
+
+BINLAB_TARGET_AVX512 inline __m512i broadcast512(const char* p) {
+  return _mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+// four rows per iteration, same in-lane layout as the avx2 kernel
+BINLAB_TARGET_AVX512 inline void format_rows_avx512(const std::uint8_t* data, std::size_t rows, char* out) {
+  const auto low = _mm512_set1_epi8(0x0f);
+  const auto space = _mm512_set1_epi8(' ');
+  const auto table = broadcast512(xdigits);
+  const auto m0 = broadcast512(hex_shuffle::m0), m1a = broadcast512(hex_shuffle::m1a), m1b = broadcast512(hex_shuffle::m1b), m2 = broadcast512(hex_shuffle::m2);
+  const auto s0 = _mm512_maskz_mov_epi8(_mm512_cmpeq_epi8_mask(m0, _mm512_set1_epi8(-1)), space);
+  const auto s1 = broadcast512(hex_shuffle::s1);
+  const auto s2 = _mm512_maskz_mov_epi8(_mm512_cmpeq_epi8_mask(m2, _mm512_set1_epi8(-1)), space);
+
+  for (; rows >= 4; rows -= 4, data += 4 * block, out += 4 * row_width) {
+    auto v = _mm512_loadu_si512(data);
+    auto hi = _mm512_shuffle_epi8(table, _mm512_and_si512(_mm512_srli_epi16(v, 4), low));
+    auto lo = _mm512_shuffle_epi8(table, _mm512_and_si512(v, low));
+    auto pairs0 = _mm512_unpacklo_epi8(hi, lo);
+    auto pairs1 = _mm512_unpackhi_epi8(hi, lo);
+
+    auto c0 = _mm512_or_si512(_mm512_shuffle_epi8(pairs0, m0), s0);
+    auto c1 = _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(pairs0, m1a), _mm512_shuffle_epi8(pairs1, m1b)), s1);
+    auto c2 = _mm512_or_si512(_mm512_shuffle_epi8(pairs1, m2), s2);
+
+    auto str = _mm512_mask_blend_epi8(printable_mask(v), space, v);
+
+    store_row(out, _mm512_castsi512_si128(c0), _mm512_castsi512_si128(c1), _mm512_castsi512_si128(c2), _mm512_castsi512_si128(str));
+    store_row(out + row_width, _mm512_extracti32x4_epi32(c0, 1), _mm512_extracti32x4_epi32(c1, 1), _mm512_extracti32x4_epi32(c2, 1), _mm512_extracti32x4_epi32(str, 1));
+    store_row(out + 2 * row_width, _mm512_extracti32x4_epi32(c0, 2), _mm512_extracti32x4_epi32(c1, 2), _mm512_extracti32x4_epi32(c2, 2), _mm512_extracti32x4_epi32(str, 2));
+    store_row(out + 3 * row_width, _mm512_extracti32x4_epi32(c0, 3), _mm512_extracti32x4_epi32(c1, 3), _mm512_extracti32x4_epi32(c2, 3), _mm512_extracti32x4_epi32(str, 3));
+  }
+  format_rows_avx2(data, rows, out);
+}
+#endif  // !BINLAB_HAVE_AVX512
+
+using format_rows_type = void (*)(const std::uint8_t*, std::size_t, char*);
+
+inline format_rows_type select_format_rows() {
+#if defined(BINLAB_HAVE_AVX512)
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return format_rows_avx512;
+  }
+#endif  // !BINLAB_HAVE_AVX512
+#if defined(BINLAB_HAVE_AVX2)
+  if (__builtin_cpu_supports("avx2")) {
+    return format_rows_avx2;
+  }
+#endif  // !BINLAB_HAVE_AVX2
+#if defined(BINLAB_HAVE_SSE2)
+  return format_rows_sse2;
+#else
+  return format_rows_scalar;
+#endif  // !BINLAB_HAVE_SSE2
+}
+
+// formats `rows` full rows (row_width bytes each) into `out`, picking the widest kernel the cpu supports
+inline void format_rows(const std::uint8_t* data, std::size_t rows, char* out) {
+  static const auto kernel = select_format_rows();
+  kernel(data, rows, out);
+}
+
+}  // namespace hexdump
+
+#endif  // BINLAB_HEXDUMP_KERNEL_H_
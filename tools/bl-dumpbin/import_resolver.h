@@ -0,0 +1,459 @@
+// import_resolver.h
+
+#ifndef BINLAB_IMPORT_RESOLVER_H_
+#define BINLAB_IMPORT_RESOLVER_H_
+
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/COFF.h"
+#include "binlab/BinaryFormat/ELF.h"
+#include "address_mode_policy.h"
+#include "elf_file.h"
+#include "elf_symbols.h"
+#include "mapped_image.h"
+#include "pe_exports.h"
+#include "pe_headers.h"
+#include "result_cache.h"
+#include "thread_pool.h"
+
+// dense ids for strings; the views handed out stay valid for the interner's lifetime
+class string_interner {
+ public:
+  static constexpr std::uint32_t npos = ~std::uint32_t{0};
+
+  std::uint32_t intern(std::string_view str) {
+    if (auto iter = ids_.find(str); iter != ids_.end()) {
+      return iter->second;
+    }
+    auto& stored = storage_.emplace_back(str);  // deque never relocates, so the view below stays put
+    auto id = static_cast<std::uint32_t>(views_.size());
+    views_.push_back(stored);
+    ids_.emplace(stored, id);
+    return id;
+  }
+
+  std::uint32_t find(std::string_view str) const {
+    auto iter = ids_.find(str);
+    return (iter != ids_.end()) ? iter->second : npos;
+  }
+
+  std::string_view operator[](std::uint32_t id) const { return views_[id]; }
+  std::size_t size() const { return views_.size(); }
+
+ private:
+  std::deque<std::string> storage_;
+  std::vector<std::string_view> views_;
+  std::unordered_map<std::string_view, std::uint32_t> ids_;
+};
+
+// what one image exports and imports; the views point into `image`. PE exports are not listed but looked up in
+// place, through the section index and export directory kept here
+struct module_summary {
+  enum class kind { none, pe, elf };
+
+  struct export_entry {
+    std::string_view name;
+  };
+
+  struct import_entry {
+    std::string_view module;  // empty for ELF, where the needed closure is searched instead
+    std::string_view name;    // empty for PE imports by ordinal
+    std::uint32_t ordinal = 0;
+    std::uint16_t hint = 0;   // PE: where in the exporter's AddressOfNames to look first
+  };
+
+  kind format = kind::none;
+  std::string path;
+  std::string name;  // PE: lower-case file name; ELF: DT_SONAME, else the file name
+  std::vector<std::string_view> needed;
+  std::vector<export_entry> exports;
+  std::vector<import_entry> imports;
+  rva_index index;
+  binlab::COFF::IMAGE_DATA_DIRECTORY export_directory{};
+  mapped_image image;
+};
+
+inline std::string lower_module_name(std::string_view name) {
+  std::string result{name};
+  for (auto& c : result) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return result;
+}
+
+template <typename Thunk>
+int summarize_pe(const pe_headers& headers, module_summary& summary) {
+  using namespace binlab::COFF;
+  auto base = summary.image.data();
+  auto& index = summary.index;
+  index = headers.index;
+  summary.export_directory = headers.directories[IMAGE_DIRECTORY_ENTRY_EXPORT];
+
+  // both lists end at their null entry or where the file data behind them does
+  auto& imports = headers.directories[IMAGE_DIRECTORY_ENTRY_IMPORT];
+  for (std::size_t rva = imports.VirtualAddress; rva; rva += sizeof(IMAGE_IMPORT_DESCRIPTOR)) {
+    auto descriptor = rva_cast<IMAGE_IMPORT_DESCRIPTOR>(base, index, rva);
+    if (!descriptor || !descriptor->Name) {
+      break;
+    }
+    auto module = rva_string(base, index, descriptor->Name);
+    std::size_t thunk_rva = descriptor->OriginalFirstThunk ? descriptor->OriginalFirstThunk : descriptor->FirstThunk;
+    for (; module.data(); thunk_rva += sizeof(Thunk)) {
+      auto thunk = rva_cast<Thunk>(base, index, thunk_rva);
+      if (!thunk || !thunk->u1.AddressOfData) {
+        break;
+      }
+      constexpr auto flag = decltype(thunk->u1.Ordinal){1} << (8 * sizeof(thunk->u1.Ordinal) - 1);
+      if (thunk->u1.Ordinal & flag) {
+        summary.imports.push_back({module, {}, static_cast<std::uint32_t>(thunk->u1.Ordinal & 0xffff), 0});
+      } else if (auto hint = rva_cast<WORD>(base, index, thunk->u1.AddressOfData)) {
+        summary.imports.push_back({module, rva_string(base, index, thunk->u1.AddressOfData + sizeof(WORD)), 0, *hint});
+      }
+    }
+  }
+  summary.format = module_summary::kind::pe;
+  summary.name = lower_module_name(std::filesystem::path{summary.path}.filename().string());
+  return 0;
+}
+
+template <typename Traits>
+int summarize_elf(const elf_file<Traits>& elf, module_summary& summary) {
+  using namespace binlab::ELF;
+  using dyn_type = Traits::dyn_type;
+  const auto count = elf.section_count();
+  if (!elf.sections_within(summary.image.size())) {
+    return -1;
+  }
+  elf.for_each_section([&](std::size_t, const elf_section& section) {
+    if (section.type == SHT_DYNSYM) {
+      elf_symbol_table<Traits>{elf, section, summary.image.size()}.for_each([&summary](const elf_symbol& sym) {
+        if (sym.name.empty() || (sym.bind != STB_GLOBAL && sym.bind != STB_WEAK && sym.bind != STB_GNU_UNIQUE)) {
+          return;
+        }
+        if (sym.section != SHN_UNDEF) {
+          if (sym.visibility == STV_DEFAULT || sym.visibility == STV_PROTECTED) {
+            summary.exports.push_back({sym.name});
+          }
+        } else if (sym.bind != STB_WEAK) {  // weak references may stay unresolved
+          summary.imports.push_back({{}, sym.name, 0, 0});
+        }
+      });
+    } else if (section.type == SHT_DYNAMIC && section.link < count && elf.in_file(section, summary.image.size()) && elf.in_file(elf.section(section.link), summary.image.size())) {
+      auto strtab = elf.section(section.link);
+      auto strings = elf.template at<char>(strtab.offset);
+      auto string = [strings, &strtab](std::uint64_t off) {
+        return (off < strtab.size) ? std::string_view{strings + off, ::strnlen(strings + off, strtab.size - off)} : std::string_view{};
+      };
+      auto dyn = elf.template at<dyn_type>(section.offset);
+      for (auto last = dyn + section.size / sizeof(dyn_type); dyn != last && elf.get(dyn->d_tag) != DT_NULL; ++dyn) {
+        if (elf.get(dyn->d_tag) == DT_NEEDED) {
+          summary.needed.push_back(string(elf.get(dyn->d_un.d_val)));
+        } else if (elf.get(dyn->d_tag) == DT_SONAME) {
+          summary.name = string(elf.get(dyn->d_un.d_val));
+        }
+      }
+    }
+  });
+  summary.format = module_summary::kind::elf;
+  if (summary.name.empty()) {
+    summary.name = std::filesystem::path{summary.path}.filename().string();
+  }
+  return 0;
+}
+
+// maps `path` and collects its exports and imports; -1 for anything that is neither PE nor ELF
+inline int summarize(const std::string& path, module_summary& summary) {
+  using namespace binlab::COFF;
+  summary.path = path;
+  if (summary.image.open(path.c_str(), mapped_image::access::random) || summary.image.size() < sizeof(IMAGE_DOS_HEADER)) {
+    return -1;
+  }
+  auto base = summary.image.data();
+  if (reinterpret_cast<const IMAGE_DOS_HEADER*>(base)->e_magic == IMAGE_DOS_SIGNATURE) {
+    pe_headers headers;
+    if (open_pe_headers(base, summary.image.size(), headers)) {
+      return -1;
+    }
+    return headers.pe64 ? summarize_pe<IMAGE_THUNK_DATA64>(headers, summary) : summarize_pe<IMAGE_THUNK_DATA32>(headers, summary);
+  }
+  if (summary.image.size() < sizeof(binlab::ELF::Elf64_Ehdr)) {
+    return -1;
+  }
+  return visit_elf(base, [&summary](const auto& elf) { return summarize_elf(elf, summary); });
+}
+
+// every import of a tree checked against the modules in it: PE imports in the export tables of the modules of that
+// name, by hint or ordinal and following forwarders, ELF imports in a global index over the DT_NEEDED closure. An
+// ELF symbol defined by several modules in the closure binds to the first of them in load order, as ld.so does,
+// which is only worth a warning; a PE symbol exported by several modules of the same name is a real conflict
+class import_resolver {
+ public:
+  enum class status { missing_module, missing_symbol, ambiguous, interposed };
+
+  struct problem {
+    std::size_t importer;  // index into modules()
+    status what;
+    std::string module;       // for interposed, the module the import binds to
+    std::string symbol;       // empty for missing_module; "#<ordinal>" for PE imports by ordinal
+    std::size_t providers;    // how many modules define it, for ambiguous and interposed
+  };
+
+  static std::string_view status_name(status what) {
+    switch (what) {
+      case status::missing_module: return "missing-module";
+      case status::missing_symbol: return "missing-symbol";
+      case status::ambiguous: return "ambiguous";
+      default: return "interposed";
+    }
+  }
+
+  // interposition is how ELF is meant to work; it is reported, but the import does resolve
+  static bool is_warning(status what) { return what == status::interposed; }
+
+  // summarizes the files across the pool, interns the ELF names and indexes the exports, then resolves the PE
+  // imports while their export tables are still mapped. Every image is unmapped by the time build() returns; hard
+  // links and symlinks to an already seen file are only counted once
+  void build(thread_pool& pool, const std::vector<std::string>& files) {
+    std::vector<module_summary> summaries(files.size());
+    std::vector<result_cache::key> keys(files.size());
+    pool.parallel_for(files.size(), [&](std::size_t i) {
+      if (result_cache::stat(files[i].c_str(), keys[i]) || summarize(files[i], summaries[i])) {
+        summaries[i].format = module_summary::kind::none;
+        summaries[i].image.close();
+      }
+    });
+
+    std::unordered_set<std::uint64_t> seen;
+    for (std::size_t i = 0; i < summaries.size(); ++i) {
+      if (summaries[i].format != module_summary::kind::none && seen.insert(hash_bytes(&keys[i], 2 * sizeof(std::uint64_t))).second) {
+        modules_.push_back(std::move(summaries[i]));
+      }
+    }
+    summaries.clear();
+
+    // the tables point at modules_[m].index, which stays put from here on
+    tables_.resize(modules_.size());
+    pool.parallel_for(modules_.size(), [this](std::size_t m) {
+      auto& module = modules_[m];
+      if (module.format == module_summary::kind::pe && !tables_[m].open(module.image.data(), module.image.size(), module.index, module.export_directory)) {
+        tables_[m].build_index();
+      }
+    });
+
+    module_ids_.resize(modules_.size());
+    needed_.resize(modules_.size());
+    imports_.resize(modules_.size());
+    for (std::size_t m = 0; m < modules_.size(); ++m) {
+      auto& module = modules_[m];
+      auto id = names_.intern(module.name);
+      module_ids_[m] = id;
+      by_name_[id].push_back(static_cast<std::uint32_t>(m));
+      if (module.format != module_summary::kind::elf) {
+        continue;
+      }
+      for (auto& entry : module.exports) {
+        add_export(id, names_.intern(entry.name), m);
+      }
+      for (auto needed : module.needed) {
+        needed_[m].push_back(names_.intern(needed));
+      }
+      for (auto& import : module.imports) {
+        imports_[m].push_back(names_.intern(import.name));
+      }
+      release(module);
+    }
+
+    problems_.resize(modules_.size());
+    checked_.resize(modules_.size());
+    pool.parallel_for(modules_.size(), [this](std::size_t m) {
+      if (modules_[m].format == module_summary::kind::pe) {
+        checked_[m] = resolve_pe(m, problems_[m]);
+      }
+    });
+    tables_.clear();
+    for (auto& module : modules_) {
+      release(module);
+    }
+  }
+
+  const std::vector<module_summary>& modules() const { return modules_; }
+
+  // checks the ELF imports across the pool; report(problem) is then called in module order for them and the PE
+  // problems build() found
+  template <typename Fn>
+  std::size_t resolve(thread_pool& pool, Fn report) {
+    pool.parallel_for(modules_.size(), [this](std::size_t m) {
+      if (modules_[m].format == module_summary::kind::elf) {
+        checked_[m] = resolve_elf(m, problems_[m]);
+      }
+    });
+    std::size_t total = 0;
+    for (std::size_t m = 0; m < modules_.size(); ++m) {
+      for (auto& p : problems_[m]) {
+        report(p);
+      }
+      problems_[m].clear();
+      total += checked_[m];
+    }
+    return total;
+  }
+
+ private:
+  struct provider {
+    std::uint32_t module;  // index into modules_ of the first definition
+    std::uint32_t count;   // distinct modules defining the same (name, symbol)
+  };
+
+  static constexpr std::size_t max_forwards = 8;
+
+  static std::uint64_t key(std::uint32_t module, std::uint32_t symbol) { return static_cast<std::uint64_t>(module) << 32 | symbol; }
+
+  static std::string_view ordinal_name(char (&buff)[16], std::uint32_t ordinal) {
+    buff[0] = '#';
+    auto [ptr, ec] = std::to_chars(buff + 1, buff + sizeof(buff), ordinal);
+    return {buff, static_cast<std::size_t>(ptr - buff)};
+  }
+
+  // drops the image and the views into it; the name and path stay
+  static void release(module_summary& module) {
+    module.needed = {};
+    module.exports = {};
+    module.imports = {};
+    module.image.close();
+  }
+
+  void add_export(std::uint32_t module_id, std::uint32_t symbol_id, std::size_t m) {
+    auto [iter, inserted] = exports_.try_emplace(key(module_id, symbol_id), provider{static_cast<std::uint32_t>(m), 1});
+    if (!inserted && iter->second.module != m) {  // versioned duplicates within one module are one definition
+      ++iter->second.count;
+    }
+  }
+
+  // PE module names are case-insensitive; a forwarder's module has no extension
+  std::uint32_t pe_module(std::string_view name, bool forwarded) const {
+    auto lower = lower_module_name(name);
+    if (forwarded) {
+      lower += ".dll";
+    }
+    auto id = names_.find(lower);
+    return (id != string_interner::npos && by_name_.count(id)) ? id : string_interner::npos;
+  }
+
+  // the export that find(table, result) finds in the first of the modules named `module_id`, and how many of them
+  // define it
+  template <typename Find>
+  std::size_t find_pe(std::uint32_t module_id, pe_export& result, Find find) const {
+    std::size_t providers = 0;
+    pe_export entry;
+    for (auto p : by_name_.at(module_id)) {
+      if (find(tables_[p], entry) && !providers++) {
+        result = entry;
+      }
+    }
+    return providers;
+  }
+
+  std::size_t resolve_pe(std::size_t m, std::vector<problem>& problems) const {
+    std::unordered_set<std::string_view> missing;
+    char buff[16];
+    for (auto& import : modules_[m].imports) {
+      auto module_id = pe_module(import.module, false);
+      if (module_id == string_interner::npos) {
+        if (missing.insert(import.module).second) {
+          problems.push_back({m, status::missing_module, std::string{import.module}, {}, 0});
+        }
+        continue;
+      }
+      auto symbol = import.name.empty() ? ordinal_name(buff, import.ordinal) : import.name;
+      auto module = import.module;
+      pe_export entry;
+      auto providers = find_pe(module_id, entry, [&import](const pe_export_table& table, pe_export& result) {
+        return import.name.empty() ? table.by_ordinal(import.ordinal, result) : table.by_hint(import.hint, import.name, result);
+      });
+      for (std::size_t hop = 0;; ++hop) {
+        if (!providers) {
+          problems.push_back({m, status::missing_symbol, std::string{module}, std::string{symbol}, 0});
+          break;
+        }
+        if (providers > 1) {
+          problems.push_back({m, status::ambiguous, std::string{module}, std::string{symbol}, providers});
+          break;
+        }
+        if (hop == max_forwards || !split_forwarder(entry.forwarder, module, symbol)) {
+          break;
+        }
+        module_id = pe_module(module, true);
+        if (module_id == string_interner::npos) {
+          problems.push_back({m, status::missing_module, std::string{module}, std::string{symbol}, 0});
+          break;
+        }
+        providers = find_pe(module_id, entry, [symbol](const pe_export_table& table, pe_export& result) { return table.find(symbol, result); });
+      }
+    }
+    return modules_[m].imports.size();
+  }
+
+  std::size_t resolve_elf(std::size_t m, std::vector<problem>& problems) const {
+    // breadth-first DT_NEEDED closure, in load order
+    std::vector<std::uint32_t> scope;
+    std::unordered_set<std::uint32_t> visited{static_cast<std::uint32_t>(m)};
+    std::vector<std::uint32_t> queue{static_cast<std::uint32_t>(m)};
+    for (std::size_t q = 0; q < queue.size(); ++q) {
+      for (auto needed : needed_[queue[q]]) {
+        auto iter = by_name_.find(needed);
+        if (iter == by_name_.end()) {
+          if (queue[q] == m) {
+            problems.push_back({m, status::missing_module, std::string{names_[needed]}, {}, 0});
+          }
+          continue;
+        }
+        auto provider = iter->second.front();
+        if (visited.insert(provider).second) {
+          queue.push_back(provider);
+          scope.push_back(module_ids_[provider]);
+        }
+      }
+    }
+
+    for (auto symbol_id : imports_[m]) {
+      std::size_t providers = 0;
+      std::uint32_t binding = 0;
+      for (auto module_id : scope) {
+        if (exports_.count(key(module_id, symbol_id)) && !providers++) {
+          binding = module_id;
+        }
+      }
+      if (!providers) {
+        problems.push_back({m, status::missing_symbol, {}, std::string{names_[symbol_id]}, 0});
+      } else if (providers > 1) {
+        problems.push_back({m, status::interposed, std::string{names_[binding]}, std::string{names_[symbol_id]}, providers});
+      }
+    }
+    return imports_[m].size();
+  }
+
+  std::vector<module_summary> modules_;
+  std::vector<std::uint32_t> module_ids_;  // interned name of each module
+  string_interner names_;                  // module names and symbols share one pool
+  std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> by_name_;
+  std::unordered_map<std::uint64_t, provider> exports_;  // ELF only
+  std::vector<pe_export_table> tables_;                   // PE only, empty for ELF modules; gone after build()
+  std::vector<std::vector<std::uint32_t>> needed_;        // ELF: interned DT_NEEDED names
+  std::vector<std::vector<std::uint32_t>> imports_;       // ELF: interned undefined symbols
+  std::vector<std::vector<problem>> problems_;            // per importer, in import order
+  std::vector<std::size_t> checked_;                      // imports of each module checked
+};
+
+#endif  // BINLAB_IMPORT_RESOLVER_H_
@@ -0,0 +1,248 @@
+// loaded_image.h
+
+#ifndef BINLAB_LOADED_IMAGE_H_
+#define BINLAB_LOADED_IMAGE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/COFF.h"
+#include "binlab/BinaryFormat/ELF.h"
+#include "elf_file.h"
+#include "pe_headers.h"
+
+#if defined(unix) || defined(__unix__) || defined(__unix)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif  // !unix
+
+// a PE or ELF file laid out the way the loader would: PE sections at their VirtualAddress within SizeOfImage bytes
+// (headers at 0), ELF PT_LOAD segments at p_vaddr relative to the page holding the lowest one; whatever the file
+// does not supply reads as zero. The bytes come from the caller's view of the file; given the file's path, whole
+// pages whose file offset is congruent with their address are mapped MAP_PRIVATE straight from it instead, so the
+// cost follows the number of regions rather than the image size, and only partial pages and misaligned regions
+// are copied. The view is writable and never the file.
+class loaded_image {
+ public:
+  enum class format { none, pe, elf };
+
+  // `size` file bytes at `offset` belong at `address` in the layout
+  struct region {
+    std::uint64_t address;
+    std::uint64_t offset;
+    std::size_t size;
+  };
+
+  static constexpr std::size_t page_alignment = 0x1000;
+
+  loaded_image() = default;
+  loaded_image(const loaded_image&) = delete;
+  loaded_image& operator=(const loaded_image&) = delete;
+  loaded_image(loaded_image&& other) noexcept { swap(other); }
+  loaded_image& operator=(loaded_image&& other) noexcept {
+    loaded_image{std::move(other)}.swap(*this);
+    return *this;
+  }
+  ~loaded_image() { close(); }
+
+  // lays out the `size` bytes of a file at `buff`, which must hold every range file_ranges() lists; `path`, when
+  // given, names the same file for the pages that can be mapped rather than copied. -1 when the file is neither PE
+  // nor ELF, its headers are cut short, or the layout cannot be allocated
+  int open(const char* buff, std::size_t size, const char* path = nullptr) {
+    close();
+    std::vector<region> regions;
+    if (!size || layout(buff, size, regions) || build(buff, path, regions)) {
+      close();
+      return -1;
+    }
+    regions_ = regions.size();
+    return 0;
+  }
+
+  // the file ranges open() places, for a caller that reads the file piecemeal; only the headers (and for ELF the
+  // program headers) need to be present in `buff`
+  static int file_ranges(const char* buff, std::size_t size, std::vector<region>& regions) {
+    loaded_image scratch;
+    return scratch.layout(buff, size, regions);
+  }
+
+  void close() {
+#if defined(unix) || defined(__unix__) || defined(__unix)
+    if (mapped_) {
+      ::munmap(data_, size_);
+    }
+#endif  // !unix
+    std::vector<char>{}.swap(buffer_);
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    format_ = format::none;
+    first_ = preferred_base_ = 0;
+    regions_ = mapped_bytes_ = copied_bytes_ = 0;
+  }
+
+  char* data() { return data_; }
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return !size_; }
+  format kind() const { return format_; }
+
+  // the RVA (PE, always 0) or virtual address (ELF) of data()[0]
+  std::uint64_t first() const { return first_; }
+  // where the image expects to be loaded: ImageBase for PE, first() for ELF
+  std::uint64_t preferred_base() const { return preferred_base_; }
+
+  // headers and sections (PE) or PT_LOAD segments (ELF) placed, and how their bytes got there
+  std::size_t regions() const { return regions_; }
+  std::size_t mapped_bytes() const { return mapped_bytes_; }
+  std::size_t copied_bytes() const { return copied_bytes_; }
+
+  void swap(loaded_image& other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(mapped_, other.mapped_);
+    std::swap(format_, other.format_);
+    std::swap(first_, other.first_);
+    std::swap(preferred_base_, other.preferred_base_);
+    std::swap(regions_, other.regions_);
+    std::swap(mapped_bytes_, other.mapped_bytes_);
+    std::swap(copied_bytes_, other.copied_bytes_);
+    buffer_.swap(other.buffer_);
+  }
+
+ private:
+  int layout(const char* buff, std::size_t size, std::vector<region>& regions) {
+    return (layout_pe(buff, size, regions) && layout_elf(buff, size, regions)) ? -1 : 0;
+  }
+
+  int layout_pe(const char* base, std::size_t size, std::vector<region>& regions) {
+    pe_headers headers;
+    if (open_pe_headers(base, size, headers) || !headers.image_size) {
+      return -1;
+    }
+    preferred_base_ = headers.image_base;
+    size_ = headers.image_size;
+
+    regions.push_back({0, 0, std::min<std::size_t>({headers.headers_size, size, size_})});
+    for (const auto& section : headers.sections) {
+      // the loader copies SizeOfRawData bytes, but never more than the section occupies in memory
+      std::size_t bytes = section.SizeOfRawData;
+      if (section.Misc.VirtualSize) {
+        bytes = std::min<std::size_t>(bytes, section.Misc.VirtualSize);
+      }
+      if (section.PointerToRawData >= size || section.VirtualAddress >= size_) {
+        continue;
+      }
+      bytes = std::min({bytes, size - section.PointerToRawData, size_ - section.VirtualAddress});
+      if (bytes) {
+        regions.push_back({section.VirtualAddress, section.PointerToRawData, bytes});
+      }
+    }
+    format_ = format::pe;
+    return 0;
+  }
+
+  int layout_elf(const char* base, std::size_t size, std::vector<region>& regions) {
+    if (size < sizeof(binlab::ELF::Elf64_Ehdr)) {
+      return -1;
+    }
+    return visit_elf(base, [&](const auto& elf) {
+      using phdr_type = std::remove_cvref_t<decltype(elf)>::phdr_type;
+      auto& ehdr = elf.header();
+      const std::size_t phoff = elf.get(ehdr.e_phoff);
+      if (phoff > size || elf.segment_count() > (size - phoff) / sizeof(phdr_type)) {
+        return -1;
+      }
+      std::uint64_t low = ~std::uint64_t{0}, high = 0;
+      elf.for_each_segment([&](std::size_t, const elf_segment& segment) {
+        if (segment.type == binlab::ELF::PT_LOAD && segment.memsz && segment.vaddr + segment.memsz > segment.vaddr) {
+          low = std::min(low, segment.vaddr);
+          high = std::max(high, segment.vaddr + segment.memsz);
+        }
+      });
+      if (low >= high) {
+        return -1;
+      }
+      first_ = preferred_base_ = low & ~std::uint64_t{page_alignment - 1};
+      size_ = high - first_;
+      elf.for_each_segment([&](std::size_t, const elf_segment& segment) {
+        if (segment.type == binlab::ELF::PT_LOAD && segment.memsz && segment.vaddr + segment.memsz > segment.vaddr && segment.offset < size) {
+          auto bytes = std::min({segment.filesz, segment.memsz, size - segment.offset});
+          if (bytes) {
+            regions.push_back({segment.vaddr - first_, segment.offset, static_cast<std::size_t>(bytes)});
+          }
+        }
+      });
+      format_ = format::elf;
+      return 0;
+    });
+  }
+
+  // zeroed memory of size_ bytes, then each region in order (a later one wins where they overlap)
+  int build(const char* buff, const char* path, const std::vector<region>& regions) {
+#if defined(unix) || defined(__unix__) || defined(__unix)
+    auto addr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr == MAP_FAILED) {
+      return -1;
+    }
+    data_ = static_cast<char*>(addr);
+    mapped_ = true;
+
+    const std::size_t page = ::sysconf(_SC_PAGESIZE);
+    int fd = path ? ::open(path, O_RDONLY | O_CLOEXEC) : -1;
+    for (const auto& r : regions) {
+      // the pages wholly inside the region are file pages; the partial ones at either end are shared with
+      // zero fill or a neighbouring region, so they are copied
+      if (fd != -1 && r.address % page == r.offset % page) {
+        const std::size_t head = std::min<std::size_t>((page - r.address % page) % page, r.size);
+        const std::size_t body = (r.size - head) / page * page;
+        if (body && ::mmap(data_ + r.address + head, body, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, r.offset + head) != MAP_FAILED) {
+          copy(buff, r.address, r.offset, head);
+          copy(buff, r.address + head + body, r.offset + head + body, r.size - head - body);
+          mapped_bytes_ += body;
+          continue;
+        }
+      }
+      copy(buff, r.address, r.offset, r.size);
+    }
+    if (fd != -1) {
+      ::close(fd);
+    }
+    return 0;
+#else
+    buffer_.assign(size_, 0);
+    data_ = buffer_.data();
+    for (const auto& r : regions) {
+      copy(buff, r.address, r.offset, r.size);
+    }
+    return 0;
+#endif  // !unix
+  }
+
+  void copy(const char* buff, std::uint64_t address, std::uint64_t offset, std::size_t size) {
+    if (size) {
+      std::memcpy(data_ + address, buff + offset, size);
+      copied_bytes_ += size;
+    }
+  }
+
+  char* data_ = nullptr;
+  std::size_t size_ = 0;
+  bool mapped_ = false;
+  format format_ = format::none;
+  std::uint64_t first_ = 0;
+  std::uint64_t preferred_base_ = 0;
+  std::size_t regions_ = 0;
+  std::size_t mapped_bytes_ = 0;
+  std::size_t copied_bytes_ = 0;
+  std::vector<char> buffer_;
+};
+
+#endif  // BINLAB_LOADED_IMAGE_H_
@@ -1,10 +1,19 @@
 //
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
-#include <fstream>
-#include <locale>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -12,270 +21,1987 @@
 #include "binlab/BinaryFormat/COFF.h"
 #include "binlab/BinaryFormat/ELF.h"
 #include "address_mode_policy.h"
+#include "binary_diff.h"
+#include "byte_stats.h"
+#include "coff_symbols.h"
+#include "dump_writer.h"
+#include "elf_compressed.h"
+#include "elf_file.h"
+#include "elf_lookup.h"
+#include "elf_relocate.h"
+#include "elf_segments.h"
+#include "elf_symbols.h"
+#include "file_copy.h"
+#include "hexdump_kernel.h"
+#include "import_resolver.h"
+#include "loaded_image.h"
+#include "mapped_image.h"
+#include "output_sink.h"
+#include "pe_exports.h"
+#include "pe_headers.h"
+#include "pe_relocate.h"
+#include "pe_resources.h"
+#include "range_reader.h"
+#include "result_cache.h"
+#include "signature_scan.h"
+#include "string_scan.h"
+#include "thread_pool.h"
+#include "utf16_transcode.h"
 
 using namespace binlab::COFF;
 using namespace binlab::ELF;
 
-int dump(const char* base, const std::size_t off, const std::size_t size) {
-  auto data = base + off;
-  constexpr std::size_t block = 16;
-  const char* fmt = "%-48s  %-s\n";  // block * 3 = 48
+int dump(output_sink& out, const char* base, const std::size_t off, const std::size_t size) {
+  auto data = reinterpret_cast<const std::uint8_t*>(base + off);
+  const auto batch = out.capacity() / hexdump::row_width;
 
-  for (std::size_t i = 0; i < size; i += block) {
-    char hex[3 * block + 1] = {0}, str[1 * block + 1] = {0};
+  for (auto rows = size / hexdump::block; rows;) {
+    auto count = std::min(rows, batch);
+    hexdump::format_rows(data, count, out.reserve(count * hexdump::row_width));
+    out.commit(count * hexdump::row_width);
+    data += count * hexdump::block;
+    rows -= count;
+  }
+  if (auto tail = size % hexdump::block) {
+    out.commit(hexdump::format_row_scalar(data, tail, out.reserve(hexdump::row_width)));
+  }
+  return 0;
+}
 
-    for (std::size_t j = 0, pos = 0; (j < block) && ((i + j) < size); ++j) {
-      auto count = std::snprintf(&hex[pos], sizeof(hex) - pos, " %02x", static_cast<std::uint8_t>(data[i + j]));
-      if (count < 0 || (sizeof(hex) - pos - 1) < count) {
-        return -1;
+// the import descriptors from `rva` up to the null one, and each module's thunks up to theirs; either list also
+// ends where the file data behind it does
+int dump64(dump_writer& out, const char* base, const rva_index& index, std::size_t rva) {
+  for (;; rva += sizeof(IMAGE_IMPORT_DESCRIPTOR)) {
+    auto descriptor = rva_cast<IMAGE_IMPORT_DESCRIPTOR>(base, index, rva);
+    if (!descriptor || !descriptor->Name) {
+      break;
+    }
+    auto module = rva_string(base, index, descriptor->Name);
+    if (module.data()) {
+      out.import_module(module);
+    }
+    for (std::size_t thunk_rva = descriptor->OriginalFirstThunk;; thunk_rva += sizeof(IMAGE_THUNK_DATA64)) {
+      auto thunk = rva_cast<IMAGE_THUNK_DATA64>(base, index, thunk_rva);
+      if (!thunk || !thunk->u1.AddressOfData) {
+        break;
+      }
+      if (!IMAGE_SNAP_BY_ORDINAL64(thunk->u1.Ordinal)) {
+        if (auto hint = rva_cast<WORD>(base, index, thunk->u1.AddressOfData)) {
+          out.import_by_name(module, *hint, rva_string(base, index, thunk->u1.AddressOfData + sizeof(WORD)));
+        }
+      } else {
+        out.import_by_ordinal(module, IMAGE_ORDINAL64(thunk->u1.Ordinal));
       }
-      pos += count;
     }
+  }
+  return 0;
+}
 
-    for (std::size_t j = 0, pos = 0; (j < block) && ((i + j) < size); ++j) {
-      auto count = std::snprintf(&str[pos], sizeof(str) - pos, "%c", (std::isprint(static_cast<std::uint8_t>(data[i + j])) ? data[i + j] : ' '));
-      if (count < 0 || (sizeof(hex) - pos - 1) < count) {
-        return -1;
-      }
-      pos += count;
+// every exported function in ordinal order; the printed ordinal is the unbiased AddressOfFunctions index
+int dump64(dump_writer& out, const pe_export_table& exports) {
+  out.export_directory(exports.module(), exports.ordinal_base());
+  exports.for_each([&out, &exports](const pe_export& entry) {
+    out.export_entry(exports.module(), entry.rva, entry.ordinal - exports.ordinal_base(), entry.name, entry.forwarder);
+  });
+  return 0;
+}
+
+//template <typename Section, template <typename T> class AddressPolicy>
+//Section* find(Section* first, Section* last, std::size_t address) {
+//  return std::find_if(first, last, [address](const Section& section) { return AddressPolicy<Section>::in_section(address, section); });
+//}
+
+#ifdef _WIN32
+using WCHAR       = wchar_t;
+#else  // __GNU__
+using WCHAR       = char16_t;
+#endif  // _WIN32
+
+struct IMAGE_RESOURCE_DIRECTORY_STRING {
+  WORD    Length;
+  CHAR    NameString[1];
+};
+
+struct IMAGE_RESOURCE_DIR_STRING_U {
+  WORD    Length;
+  WCHAR   NameString[1];
+};
+
+// a resource name as UTF-8 straight into the sink; a name longer than the sink's buffer goes through in pieces
+// that never split a surrogate pair
+int dump(output_sink& out, const char* units, std::size_t count) {
+  const std::size_t batch = out.capacity() / 3;
+  while (count) {
+    auto n = std::min(count, batch);
+    if (n < count && utf16::load_unit(units + 2 * (n - 1)) - 0xd800u < 0x400) {
+      --n;
+    }
+    out.commit(utf16::to_utf8(units, n, out.reserve(utf16::max_utf8_size(n))));
+    units += 2 * n;
+    count -= n;
+  }
+  out.put('\n');
+  return 0;
+}
+
+// the resource tree in preorder: each entry's name or id, and for a leaf the file range of its data
+int dump_resources(output_sink& out, const char* base, std::size_t size, const rva_index& index, const IMAGE_DATA_DIRECTORY& directory) {
+  pe_resource_tree tree;
+  auto section = index.find(directory.VirtualAddress);
+  if (!section || tree.open(base, size, index, directory)) {
+    return -1;
+  }
+  out.print("pointer to raw data: %x\n", section->PointerToRawData);
+  const std::size_t off = section->PointerToRawData, va = section->VirtualAddress;
+  return tree.walk([&out, off, va](const pe_resource_key* path, std::size_t depth, const IMAGE_RESOURCE_DATA_ENTRY* entry) {
+    if (path[depth].name) {
+      dump(out, path[depth].name, path[depth].length);
+    } else {
+      out.dec(path[depth].id);
+      out.put('\n');
+    }
+    if (entry) {
+      IMAGE_RESOURCE_DATA_ENTRY data;
+      std::memcpy(&data, entry, sizeof(data));
+      out.print("[%p, %p), offset: %8x, size: %8x, code page: %8x, reserved: %8x\n", reinterpret_cast<void*>(off + data.OffsetToData - va), reinterpret_cast<void*>(off + data.OffsetToData - va + data.Size), data.OffsetToData, data.Size, data.CodePage, data.Reserved);
     }
+  });
+}
+
+int dump_pe64(dump_writer& out, const char* buff, std::size_t size) {
+  pe_headers headers;
+  if (open_pe_headers(buff, size, headers) || !headers.pe64) {
+    return 0;
+  }
+
+  pe_export_table exports;
+  if (!exports.open(buff, size, headers.index, headers.directories[IMAGE_DIRECTORY_ENTRY_EXPORT])) {
+    dump64(out, exports);
+  }
+
+  if (auto va1 = headers.directories[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress) {
+    dump64(out, buff, headers.index, va1);
+  }
+
+  if (out.text()) {
+    dump_resources(out.sink(), buff, size, headers.index, headers.directories[IMAGE_DIRECTORY_ENTRY_RESOURCE]);
+  }
+  return 0;
+}
+
+// resource trees only have a text rendering
+int dump_pe32(dump_writer& writer, const char* buff, std::size_t size) {
+  pe_headers headers;
+  if (!writer.text() || open_pe_headers(buff, size, headers) || headers.pe64) {
+    return 0;
+  }
+  dump_resources(writer.sink(), buff, size, headers.index, headers.directories[IMAGE_DIRECTORY_ENTRY_RESOURCE]);
+  return 0;
+}
+
+// section names of a COFF object
+int dump_obj64(dump_writer& out, const char* buff, std::size_t size) {
+  auto header = coff_object_header(buff, size);
+  if (!header) {
+    return -1;
+  }
+  if (out.text()) {
+    out.sink().print("NumberOfSections: %d\n", header->NumberOfSections);
+  }
+  auto Sections = reinterpret_cast<const IMAGE_SECTION_HEADER*>(header + 1);
+  for (std::size_t i = 0; i < header->NumberOfSections; ++i) {
+    std::string_view name{reinterpret_cast<const char*>(Sections[i].Name), ::strnlen(reinterpret_cast<const char*>(Sections[i].Name), sizeof(Sections[i].Name))};
+    out.section(i + 1, name, sizeof(Sections[i].Name));
+  }
+  return 0;
+}
+
+void dump(dump_writer& out, const coff_symbol& symbol) {
+  // short names keep the historical right-aligned column
+  const std::size_t width = (symbol.name.size() <= sizeof(IMAGE_SYMBOL::N.ShortName)) ? sizeof(IMAGE_SYMBOL::N.ShortName) : 0;
+  out.coff_symbol(symbol.index, symbol.value, symbol.section, symbol.type, symbol.storage_class, symbol.name, width);
+}
+
+// a COFF object's symbols in table order, aux records skipped; with `sections`, only those sections' symbols, each
+// section in value order
+int dump_obj_sym(dump_writer& out, const char* buff, std::size_t size, const std::vector<std::int16_t>& sections = {}) {
+  coff_symbol_table symbols;
+  if (symbols.open(buff, size)) {
+    return -1;
+  }
+  if (sections.empty()) {
+    symbols.for_each([&out](const coff_symbol& symbol) { dump(out, symbol); });
+  }
+  for (auto section : sections) {
+    symbols.for_each_in_section(section, [&out](const coff_symbol& symbol) { dump(out, symbol); });
+  }
+  return 0;
+}
 
-    std::printf(fmt, hex, str);
+// answers each name through a sorted index of the object's names; undefined references do not count as found
+int dump_obj_lookup(dump_writer& out, const char* buff, std::size_t size, const std::vector<std::string>& names) {
+  coff_symbol_table symbols;
+  if (symbols.open(buff, size)) {
+    return -1;
+  }
+  symbols.build_name_index();
+  coff_symbol symbol;
+  for (const auto& name : names) {
+    auto found = symbols.find(name, symbol);
+    out.symbol_lookup(name, found, found ? symbol.value : 0);
   }
   return 0;
 }
 
-int dump64(const char* base, const std::size_t off, const std::size_t va, const IMAGE_IMPORT_DESCRIPTOR* descriptors) {
-  const std::ptrdiff_t delta = reinterpret_cast<std::size_t>(base) + off - va;
-  auto print_thunks = [delta](const IMAGE_IMPORT_DESCRIPTOR& descriptor) {
-    for (auto thunks = reinterpret_cast<const IMAGE_THUNK_DATA64*>(descriptor.OriginalFirstThunk + delta); thunks->u1.AddressOfData; ++thunks) {
-      if (!IMAGE_SNAP_BY_ORDINAL64(thunks->u1.Ordinal)) {
-        auto name = reinterpret_cast<const IMAGE_IMPORT_BY_NAME*>(thunks->u1.AddressOfData + delta);
-        std::printf("\t%04x: %s\n", name->Hint, &name->Name[0]);
+// section names of any ELF class and byte order; the traits instantiation is chosen once per file. An image whose
+// section headers were stripped (or lie past the end of the file) has none to print
+int dump_elf(dump_writer& out, const char* buff, std::size_t size) {
+  return visit_elf(buff, [&out, buff, size](const auto& elf) {
+    using shdr_type = std::remove_cvref_t<decltype(elf)>::shdr_type;
+    const std::size_t shoff = elf.get(elf.header().e_shoff), count = elf.section_count(), strndx = elf.get(elf.header().e_shstrndx);
+    if (shoff > size || count > (size - shoff) / sizeof(shdr_type)) {
+      return -1;
+    }
+    const std::size_t strings = (strndx < count) ? elf.section(strndx).offset : size;
+    elf.for_each_section([&](std::size_t i, const elf_section& section) {
+      const auto offset = strings + section.name;
+      out.section(i, (strings < size && offset < size) ? std::string_view{buff + offset, ::strnlen(buff + offset, size - offset)} : std::string_view{""});
+    });
+    return 0;
+  });
+}
+
+// every symbol table whose section headers, symbols and strings lie within the `size` bytes of the file
+int dump_elf_symbols(dump_writer& out, const char* buff, std::size_t size) {
+  return visit_elf(buff, [&out, size](const auto& elf) {
+    using traits = std::remove_cvref_t<decltype(elf)>::traits;
+    if (!elf.sections_within(size)) {
+      return -1;
+    }
+    elf.for_each_section([&out, &elf, size](std::size_t, const elf_section& section) {
+      elf_symbol_table<traits> table{elf, section, size};
+      if (table.empty()) {
+        return;
+      }
+      auto name = elf.section_name(section, size);
+      out.elf_symbol_table(name, table.size());
+      table.for_each([&out, name](const elf_symbol& sym) { out.elf_symbol(name, sym); });
+    });
+    return 0;
+  });
+}
+
+// answers each name through the image's own hash tables, found through PT_DYNAMIC when the section headers are
+// gone; undefined references do not count as found
+int dump_elf_lookup(dump_writer& out, const char* buff, std::size_t size, const std::vector<std::string>& names) {
+  return visit_elf(buff, [&out, size, &names](const auto& elf) {
+    elf_symbol_lookup<typename std::remove_cvref_t<decltype(elf)>::traits> lookup;
+    if (lookup.open(elf, size)) {
+      return -1;
+    }
+    elf_symbol sym;
+    for (const auto& name : names) {
+      auto found = lookup.find(name, sym);
+      out.symbol_lookup(name, found, found ? sym.value : 0);
+    }
+    return 0;
+  });
+}
+
+// exact names, or prefixes when the pattern ends in '*'
+bool section_selected(const std::vector<std::string>& patterns, std::string_view name) {
+  return std::any_of(patterns.begin(), patterns.end(), [name](std::string_view pattern) {
+    return (!pattern.empty() && pattern.back() == '*') ? name.starts_with(pattern.substr(0, pattern.size() - 1)) : name == pattern;
+  });
+}
+
+// hex dump of the selected sections with SHF_COMPRESSED ones decompressed: those up to `stream_threshold`
+// are inflated up front across a pool, larger ones are streamed through a bounded window instead. A section that
+// runs past the end of the `size` bytes of the file is dumped up to there, and one that cannot be decompressed is
+// reported as such
+int dump_elf_contents(dump_writer& out, const char* buff, std::size_t size, const std::vector<std::string>& patterns, std::size_t jobs) {
+  static constexpr std::size_t stream_threshold = 64 << 20;
+  static constexpr std::size_t window_size = 1 << 20;
+
+  return visit_elf(buff, [&](const auto& elf) {
+    using traits = std::remove_cvref_t<decltype(elf)>::traits;
+    if (!elf.sections_within(size)) {
+      return -1;
+    }
+    std::vector<std::size_t> selected, inflate;
+    elf.for_each_section([&](std::size_t i, const elf_section& section) {
+      if (section_selected(patterns, elf.section_name(section, size))) {
+        selected.push_back(i);
+        compressed_data in;
+        if (!read_compression_header(elf, section, size, in) && can_decompress(in.type) && in.size <= stream_threshold) {
+          inflate.push_back(i);
+        }
+      }
+    });
+
+    buffer_pool buffers;
+    section_contents<traits> contents{elf, size, buffers};
+    contents.prefetch(inflate, jobs);
+
+    std::unique_ptr<char[]> window;
+    for (auto i : selected) {
+      auto section = elf.section(i);
+      auto name = elf.section_name(section, size);
+      compressed_data in;
+      if (read_compression_header(elf, section, size, in)) {
+        const std::uint64_t stored = (section.type == SHT_NOBITS) ? 0 : section.size;
+        const std::uint64_t available = (section.offset < size) ? std::min<std::uint64_t>(stored, size - section.offset) : 0;
+        out.section_contents(name, {}, stored, stored);
+        if (out.text() && available) {
+          dump(out.sink(), buff, section.offset, available);
+        }
+        if (available < stored) {
+          out.section_error(name, "cut short by the end of the file");
+        }
+        continue;
+      }
+      out.section_contents(name, compression_name(in.type), in.data_size, in.size);
+      if (!can_decompress(in.type)) {
+        out.section_error(name, "compression not supported by this build");
+        continue;
+      }
+      if (!out.text()) {
+        continue;
+      }
+      if (std::find(inflate.begin(), inflate.end(), i) != inflate.end()) {
+        auto bytes = contents.get(i);
+        if (bytes.data()) {
+          dump(out.sink(), bytes.data(), 0, bytes.size());
+        } else {
+          out.section_error(name, "decompression failed");
+        }
+        contents.release(i);
       } else {
-        std::printf("\t%p\n", reinterpret_cast<const void*>(IMAGE_ORDINAL64(thunks->u1.Ordinal)));
+        if (!window) {
+          window.reset(new char[window_size]);
+        }
+        // chunks may end mid-row; carry the partial row over so the output matches the materialized dump
+        char carry[hexdump::block];
+        std::size_t carried = 0;
+        auto status = decompress_stream(in, window.get(), window_size, [&](const char* chunk, std::size_t n) {
+          if (carried) {
+            auto take = std::min(hexdump::block - carried, n);
+            std::memcpy(carry + carried, chunk, take);
+            carried += take;
+            chunk += take;
+            n -= take;
+            if (carried < hexdump::block) {
+              return;
+            }
+            dump(out.sink(), carry, 0, carried);
+            carried = 0;
+          }
+          auto whole = n - n % hexdump::block;
+          dump(out.sink(), chunk, 0, whole);
+          carried = n - whole;
+          std::memcpy(carry, chunk + whole, carried);
+        });
+        dump(out.sink(), carry, 0, carried);
+        if (status) {
+          out.section_error(name, "decompression failed");
+        }
       }
     }
+    return 0;
+  });
+}
+
+// `size` bytes to `output` and the record saying so
+int write_image(dump_writer& out, const char* output, const char* data, std::size_t size) {
+  const bool failed = write_file_range(output, -1, 0, size, size, data) != 0;
+  out.image_written(output, size, failed);
+  return failed ? -1 : 0;
+}
+
+// rebases each ELF image to `base` (the load address of its lowest PT_LOAD segment) and reports what was applied;
+// symbols from other modules are left unresolved, so only those the image binds itself count as symbolic. With
+// `output`, the relocated segments are copied back over the file's own bytes in `writable` and the result written
+int dump_elf_relocations(dump_writer& out, const char* buff, std::size_t size, char* writable, std::uint64_t base, const char* output) {
+  return visit_elf(buff, [&](const auto& elf) {
+    using traits = std::remove_cvref_t<decltype(elf)>::traits;
+    elf_relocator<traits> relocator;
+    std::vector<char> image;
+    std::uint64_t first = 0;
+    if (relocator.open(elf, size) || load_segments(elf, size, image, first)) {
+      return -1;
+    }
+    auto stats = relocator.apply(image.data(), first, image.size(), base - first);
+    out.relocations(base, stats.relative, stats.symbolic, stats.unresolved, stats.skipped, stats.unsupported);
+    if (!output || !writable) {
+      return 0;
+    }
+    elf.for_each_segment([&](std::size_t, const elf_segment& segment) {
+      if (segment.type == PT_LOAD) {
+        std::memcpy(writable + segment.offset, &image[segment.vaddr - first], segment.filesz);
+      }
+    });
+    return write_image(out, output, writable, size);
+  });
+}
+
+// answers each name through the image's export directory, "#123" by ordinal and anything else by name through a
+// hash index over the names; forwarders back into the image are followed, one into another module is reported
+int dump_pe_lookup(dump_writer& out, const char* buff, std::size_t size, const std::vector<std::string>& names) {
+  pe_headers headers;
+  pe_export_table exports;
+  if (open_pe_headers(buff, size, headers) || exports.open(buff, size, headers.index, headers.directories[IMAGE_DIRECTORY_ENTRY_EXPORT])) {
+    return -1;
+  }
+  exports.build_index();
+  pe_export entry;
+  for (const auto& name : names) {
+    auto found = exports.find_forwarded(name, entry);
+    out.symbol_lookup(name, found, found ? entry.rva : 0, found ? entry.forwarder : std::string_view{});
+  }
+  return 0;
+}
+
+// the base relocation directory of a PE32 or PE32+ file
+struct pe_relocation_directory : pe_headers {
+  IMAGE_DATA_DIRECTORY entry;
+  pe_base_relocations blocks;
+};
+
+int open_pe_relocations(const char* buff, std::size_t size, pe_relocation_directory& result) {
+  if (open_pe_headers(buff, size, result)) {
+    return -1;
+  }
+  auto& directory = result.entry = result.directories[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+  std::size_t off = 0;
+  if (!directory.VirtualAddress || !result.index.cast(directory.VirtualAddress, off) || off >= size) {
+    return -1;
+  }
+  return result.blocks.open(buff + off, std::min<std::size_t>(directory.Size, size - off));
+}
+
+// rebases a PE image's file layout in place to load address `base` and reports what was applied; fixups that land
+// in the uninitialized tail of a section (no raw data behind it) count as unsupported. With `output`, ImageBase is
+// set to `base` too and the rebased file written there
+int dump_pe_relocations(dump_writer& out, char* buff, std::size_t size, std::uint64_t base, const char* output) {
+  pe_relocation_directory directory;
+  if (!buff || open_pe_relocations(buff, size, directory)) {
+    return -1;
+  }
+  auto locate = [&directory, buff, size](std::uint64_t rva, std::size_t& available) -> char* {
+    auto section = (rva <= ~DWORD{0}) ? directory.index.find(static_cast<DWORD>(rva)) : nullptr;
+    if (!section) {
+      return nullptr;
+    }
+    const std::size_t delta = rva - section->VirtualAddress;
+    const std::size_t off = section->PointerToRawData + delta;
+    if (delta >= section->SizeOfRawData || off >= size) {
+      return nullptr;
+    }
+    available = std::min<std::size_t>({section->SizeOfRawData - delta, section->Misc.VirtualSize - delta, size - off});
+    return buff + off;
   };
+  out.base_relocations(base, directory.blocks.apply(locate, base - directory.image_base));
+  if (!output) {
+    return 0;
+  }
+  auto& Nt = reinterpret_cast<IMAGE_NT_HEADERS64&>(buff[reinterpret_cast<const IMAGE_DOS_HEADER*>(buff)->e_lfanew]);
+  if (Nt.OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC) {
+    Nt.OptionalHeader.ImageBase = base;
+  } else {
+    reinterpret_cast<IMAGE_NT_HEADERS32&>(Nt).OptionalHeader.ImageBase = static_cast<DWORD>(base);
+  }
+  return write_image(out, output, buff, size);
+}
 
-  for (auto iter = descriptors; iter->Name; ++iter) {
-    std::printf("%s\n", reinterpret_cast<char*>(iter->Name + delta));
-    print_thunks(*iter);
+// the report-only pass: each relocation block's fixups counted by type, nothing written
+int dump_pe_relocation_pages(dump_writer& out, const char* buff, std::size_t size) {
+  pe_relocation_directory directory;
+  if (open_pe_relocations(buff, size, directory)) {
+    return -1;
   }
+  directory.blocks.for_each_block([&out](std::uint32_t page, const std::uint16_t* entries, std::size_t count) {
+    pe_fixup_stats stats;
+    pe_base_relocations::tally(entries, count, stats);
+    out.base_relocation_page(page, stats);
+  });
   return 0;
 }
 
-int dump64(const char* base, const std::size_t off, const std::size_t va, const IMAGE_EXPORT_DIRECTORY* directories) {
-  const std::ptrdiff_t delta = reinterpret_cast<std::size_t>(base) + off - va;
-  std::printf("Name: %s\n", reinterpret_cast<const char*>(directories->Name + delta));
-  std::printf("Base: %08x\n", directories->Base);
+// lays the file in `buff` out the way the loader would and reports the layout; with `rebase`, applies the
+// relocations there (PE base relocations, or the ELF dynamic relocations read from the file) instead of in the file
+// layout, and with `output` also writes that layout out. Only a `complete` view may have its pages mapped from
+// `path`; otherwise every byte is copied from what the prefetch read
+int dump_loaded_image(dump_writer& out, const char* path, const char* buff, std::size_t size, bool complete, bool rebase, std::uint64_t base, const char* output) {
+  loaded_image image;
+  if (image.open(buff, size, complete ? path : nullptr)) {
+    return -1;
+  }
+  out.image_layout(image.first(), image.size(), image.regions(), image.mapped_bytes(), image.copied_bytes());
+  if (!rebase) {
+    return 0;
+  }
+  if (image.kind() == loaded_image::format::pe) {
+    // the directory is found through the file's headers; its blocks are read where the loader put them
+    pe_relocation_directory directory;
+    pe_base_relocations blocks;
+    if (open_pe_relocations(buff, size, directory) || directory.entry.VirtualAddress >= image.size() ||
+        blocks.open(image.data() + directory.entry.VirtualAddress, std::min<std::size_t>(directory.entry.Size, image.size() - directory.entry.VirtualAddress))) {
+      return -1;
+    }
+    out.base_relocations(base, blocks.apply(image.data(), image.size(), base - image.preferred_base()));
+    return output ? write_image(out, output, image.data(), image.size()) : 0;
+  }
+  return visit_elf(buff, [&](const auto& elf) {
+    using traits = std::remove_cvref_t<decltype(elf)>::traits;
+    elf_relocator<traits> relocator;
+    if (relocator.open(elf, size)) {
+      return -1;
+    }
+    auto stats = relocator.apply(image.data(), image.first(), image.size(), base - image.first());
+    out.relocations(base, stats.relative, stats.symbolic, stats.unresolved, stats.skipped, stats.unsupported);
+    return output ? write_image(out, output, image.data(), image.size()) : 0;
+  });
+}
+
+// one path component from a resource key: ids in decimal, names with separators and control characters replaced,
+// and names that could pass for an id or a dot entry prefixed, so no key can leave its directory or collide
+std::string resource_component(const pe_resource_key& key) {
+  auto name = key.str();
+  if (!key.name) {
+    return name;
+  }
+  for (auto& c : name) {
+    if (c == '/' || c == '\\' || static_cast<unsigned char>(c) < 0x20 || c == 0x7f) {
+      c = '_';
+    }
+  }
+  if (name.find_first_not_of("0123456789.") == std::string::npos) {
+    name.insert(0, 1, '_');
+  }
+  return name;
+}
+
+// writes every resource of a PE32 or PE32+ image to <directory>/<path>/<type>/<name>/<language>: the directories
+// first, then the files in parallel across `jobs` workers, each copied file to file from `path` where the system
+// allows, otherwise from `data` (the image in memory, or null when only its headers were read). Bytes past the
+// section's raw data are zero-filled up to the resource's size
+int extract_pe_resources(dump_writer& out, const char* path, const char* buff, std::size_t size, const char* data, const std::string& directory, std::size_t jobs) {
+  pe_headers headers;
+  pe_resource_tree tree;
+  if (open_pe_headers(buff, size, headers) || tree.open(buff, size, headers.index, headers.directories[IMAGE_DIRECTORY_ENTRY_RESOURCE])) {
+    return -1;
+  }
+  // a malformed part of the tree is skipped; whatever else it holds is still extracted
+  std::vector<pe_resource> resources;
+  tree.resources(resources);
+
+  std::filesystem::path root{directory};
+  for (const auto& part : std::filesystem::path{path}.relative_path()) {
+    if (part != "." && part != "..") {
+      root /= part;
+    }
+  }
+
+  struct file_range {
+    std::string path;
+    std::uint64_t offset;
+    std::size_t count;
+    std::size_t size;
+  };
+  std::vector<file_range> files;
+  std::uint64_t bytes = 0;
+  std::size_t failed = 0;
+  std::filesystem::path parent;
+  for (const auto& r : resources) {
+    auto dir = root / resource_component(r.type) / resource_component(r.name);
+    std::error_code ec;
+    if (dir != parent && (std::filesystem::create_directories(dir, ec), ec)) {
+      ++failed;
+      continue;
+    }
+    parent = dir;
+
+    std::size_t offset = 0, count = 0;
+    if (auto section = headers.index.find(r.rva)) {
+      const std::size_t delta = r.rva - section->VirtualAddress;
+      offset = section->PointerToRawData + delta;
+      if (delta < section->SizeOfRawData && offset < size) {
+        count = std::min<std::size_t>({r.size, section->SizeOfRawData - delta, size - offset});
+      }
+    }
+    files.push_back({(dir / resource_component(r.language)).string(), offset, count, r.size});
+    bytes += r.size;
+  }
 
-  auto functions = reinterpret_cast<const DWORD*>(directories->AddressOfFunctions + delta);
-  auto names = reinterpret_cast<const DWORD*>(directories->AddressOfNames + delta);
-  auto ordinals = reinterpret_cast<const WORD*>(directories->AddressOfNameOrdinals + delta);
-  for (std::size_t i = 0; i < directories->NumberOfFunctions; ++i, ++functions, ++names, ++ordinals) {
-    std::printf("\t%08x", *functions);
-    std::printf("\t%04x", *ordinals);
-    std::printf("\t%s\n", reinterpret_cast<const char*>(*names + delta));
+  int source = -1;
+#if defined(unix) || defined(__unix__) || defined(__unix)
+  source = ::open(path, O_RDONLY | O_CLOEXEC);
+#endif  // !unix
+  std::atomic<std::size_t> errors{0};
+  auto write = [&](std::size_t i) {
+    const auto& f = files[i];
+    if (write_file_range(f.path.c_str(), source, f.offset, f.count, f.size, data ? data + f.offset : nullptr)) {
+      errors.fetch_add(1, std::memory_order_relaxed);
+    }
+  };
+  parallel_for(files.size(), jobs, write);
+#if defined(unix) || defined(__unix__) || defined(__unix)
+  if (source != -1) {
+    ::close(source);
   }
+#endif  // !unix
+  out.resources_extracted(root.string(), files.size(), bytes, failed + errors.load());
   return 0;
 }
 
-//template <typename Section, template <typename T> class AddressPolicy>
-//Section* find(Section* first, Section* last, std::size_t address) {
-//  return std::find_if(first, last, [address](const Section& section) { return AddressPolicy<Section>::in_section(address, section); });
-//}
+// a named stretch of a file: a section's file data, or for a diff what lies before or after all of them
+struct file_region {
+  std::string name;
+  std::size_t offset;
+  std::size_t size;
+  std::uint64_t address = 0;  // RVA of a PE section, address of an ELF one
+  bool executable = false;
+};
 
-int dump_pe64(const char* buff) {
-  auto& Dos = reinterpret_cast<const IMAGE_DOS_HEADER&>(buff[0]);
-  if (Dos.e_magic == IMAGE_DOS_SIGNATURE) {
-    auto& Nt = reinterpret_cast<const IMAGE_NT_HEADERS64&>(buff[Dos.e_lfanew]);
-    if (Nt.Signature == IMAGE_NT_SIGNATURE && Nt.OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC) {
-      using rva = relative_virtual_address_policy<IMAGE_SECTION_HEADER>;
-      auto first = IMAGE_FIRST_SECTION(&Nt);
-      auto last = first + Nt.FileHeader.NumberOfSections;
-
-      auto va0 = Nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress;
-      if (va0) {
-        auto pred = [va0](const IMAGE_SECTION_HEADER& section) { return rva::in_section(va0, section); };
-        auto iter = std::find_if(first, last, pred);
-        if (iter != last) {
-          auto directories = reinterpret_cast<const IMAGE_EXPORT_DIRECTORY*>(&buff[rva::cast(va0, *iter)]);
-          dump64(buff, iter->PointerToRawData, iter->VirtualAddress, directories);
-        }
+// a region's file extent and where it is in memory, so the address policies translate offsets inside it
+template <>
+struct section_traits<file_region> {
+  using address_type = std::uint64_t;
+
+  static inline constexpr std::uint64_t address(const file_region& region) {
+    return region.offset;
+  }
+  static inline constexpr std::uint64_t size(const file_region& region) {
+    return region.size;
+  }
+
+  static inline constexpr std::uint64_t vaddress(const file_region& region) {
+    return region.address;
+  }
+  static inline constexpr std::uint64_t vsize(const file_region& region) {
+    return region.size;
+  }
+};
+
+// a sized symbol with file data, at `offset` within region `region`
+struct file_symbol {
+  std::string_view name;
+  std::size_t region;
+  std::size_t offset;
+  std::size_t size;
+  std::uint64_t value;
+};
+
+struct file_layout {
+  std::vector<file_region> regions;
+  std::vector<file_symbol> symbols;
+};
+
+// the sections with file data of a PE image or COFF object, clamped to the file
+void coff_regions(const IMAGE_SECTION_HEADER* first, std::size_t count, std::size_t size, file_layout& result) {
+  for (auto section = first; section != first + count; ++section) {
+    if (section->PointerToRawData && section->SizeOfRawData && section->PointerToRawData < size) {
+      result.regions.push_back({std::string{reinterpret_cast<const char*>(section->Name), ::strnlen(reinterpret_cast<const char*>(section->Name), sizeof(section->Name))},
+                                section->PointerToRawData, std::min<std::size_t>(section->SizeOfRawData, size - section->PointerToRawData), section->VirtualAddress,
+                                (section->Characteristics & (IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_CNT_CODE)) != 0});
+    }
+  }
+}
+
+// the sections of an ELF image, with `symbols` also their FUNC and OBJECT symbols (from .symtab, or .dynsym when it
+// was stripped), every table bounds-checked against the file
+int elf_regions(const char* buff, std::size_t size, file_layout& result, bool symbols) {
+  if (size < EI_NIDENT) {
+    return -1;
+  }
+  return visit_elf(buff, [buff, size, &result, symbols](const auto& elf) {
+    using traits = std::remove_cvref_t<decltype(elf)>::traits;
+    using shdr_type = traits::shdr_type;
+    using ehdr_type = traits::ehdr_type;
+    const std::size_t shoff = elf.get(elf.header().e_shoff), count = elf.section_count(), strndx = elf.get(elf.header().e_shstrndx);
+    if (size < sizeof(ehdr_type) || shoff > size || count > (size - shoff) / sizeof(shdr_type)) {
+      return -1;
+    }
+    auto in_file = [size](const elf_section& section) { return elf_file<traits>::in_file(section, size); };
+    const std::size_t strings = (strndx < count) ? elf.section(strndx).offset : size;
+    std::vector<std::size_t> region_of(count, static_cast<std::size_t>(-1));
+    std::size_t table = count;
+    elf.for_each_section([&](std::size_t i, const elf_section& section) {
+      if ((section.type == SHT_SYMTAB || (section.type == SHT_DYNSYM && table == count)) && in_file(section) && section.link < count && in_file(elf.section(section.link))) {
+        table = i;
       }
+      if (section.type == SHT_NOBITS || section.type == SHT_NULL || !section.size || section.offset >= size) {
+        return;
+      }
+      const auto offset = strings + section.name;
+      region_of[i] = result.regions.size();
+      result.regions.push_back({(strings < size && offset < size) ? std::string{buff + offset, ::strnlen(buff + offset, size - offset)} : std::string{},
+                                static_cast<std::size_t>(section.offset), static_cast<std::size_t>(std::min<std::uint64_t>(section.size, size - section.offset)), section.addr,
+                                (section.flags & SHF_EXECINSTR) != 0});
+    });
+    if (!symbols || table == count) {
+      return 0;
+    }
 
-      auto va1 = Nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress;
-      if (va1) {
-        auto pred = [va1](const IMAGE_SECTION_HEADER& section) { return rva::in_section(va1, section); };
-        auto iter = std::find_if(first, last, pred);
-        if (iter != last) {
-          auto descriptoies = reinterpret_cast<const IMAGE_IMPORT_DESCRIPTOR*>(&buff[rva::cast(va1, *iter)]);
-          dump64(buff, iter->PointerToRawData, iter->VirtualAddress, descriptoies);
+    // symbol values are addresses, except in relocatable objects where they are offsets into their section
+    const bool relocatable = elf.get(elf.header().e_type) == ET_REL;
+    elf_symbol_table<traits>{elf, elf.section(table), size}.for_each([&](const elf_symbol& sym) {
+      if ((sym.type != STT_FUNC && sym.type != STT_OBJECT) || !sym.size || sym.section >= count || region_of[sym.section] == static_cast<std::size_t>(-1)) {
+        return;
+      }
+      const auto& region = result.regions[region_of[sym.section]];
+      const auto offset = sym.value - (relocatable ? 0 : elf.section(sym.section).addr);
+      if (offset <= region.size && sym.size <= region.size - offset) {
+        result.symbols.push_back({sym.name, region_of[sym.section], static_cast<std::size_t>(offset), static_cast<std::size_t>(sym.size), sym.value});
+      }
+    });
+    return 0;
+  });
+}
+
+// the sections of a COFF object, with `symbols` also its external and static symbols, each sized up to the next
+// symbol of its section
+int obj_regions(const char* buff, std::size_t size, file_layout& result, bool symbols) {
+  auto header = coff_object_header(buff, size);
+  if (!header) {
+    return -1;
+  }
+  auto first = reinterpret_cast<const IMAGE_SECTION_HEADER*>(header + 1);
+  std::vector<std::size_t> region_of;
+  for (std::size_t i = 0; i < header->NumberOfSections; ++i) {
+    const auto mark = result.regions.size();
+    coff_regions(first + i, 1, size, result);
+    region_of.push_back(result.regions.size() > mark ? mark : static_cast<std::size_t>(-1));
+  }
+
+  coff_symbol_table table;
+  if (!symbols || table.open(buff, size)) {
+    return 0;
+  }
+  std::vector<coff_symbol> sorted;
+  for (std::size_t i = 0; i < region_of.size(); ++i) {
+    if (region_of[i] == static_cast<std::size_t>(-1)) {
+      continue;
+    }
+    // section definitions and function records carry aux records; the symbols that name code or data do not
+    sorted.clear();
+    table.for_each_in_section(static_cast<std::int16_t>(i + 1), [&sorted](const coff_symbol& symbol) {
+      if (!symbol.aux && (symbol.storage_class == IMAGE_SYM_CLASS_EXTERNAL || symbol.storage_class == IMAGE_SYM_CLASS_STATIC)) {
+        sorted.push_back(symbol);
+      }
+    });
+    const auto& region = result.regions[region_of[i]];
+    for (std::size_t k = 0; k < sorted.size(); ++k) {
+      auto end = region.size;
+      for (auto n = k + 1; n < sorted.size(); ++n) {
+        if (sorted[n].value > sorted[k].value) {
+          end = std::min<std::size_t>(end, sorted[n].value);
+          break;
         }
       }
+      if (sorted[k].value < end) {
+        result.symbols.push_back({sorted[k].name, region_of[i], sorted[k].value, end - sorted[k].value, sorted[k].value});
+      }
     }
   }
   return 0;
 }
 
-#ifdef _WIN32
-using WCHAR       = wchar_t;
-#else  // __GNU__
-using WCHAR       = char16_t;
-#endif  // _WIN32
+// the sections of a PE image, ELF image or COFF object, with `symbols` also the symbols that locate code and data
+// inside them; -1 for any other file
+int section_layout(const char* buff, std::size_t size, file_layout& result, bool symbols = false) {
+  pe_headers headers;
+  if (!open_pe_headers(buff, size, headers)) {
+    coff_regions(headers.sections.data(), headers.sections.size(), size, result);
+    return 0;
+  }
+  return (elf_regions(buff, size, result, symbols) && obj_regions(buff, size, result, symbols)) ? -1 : 0;
+}
 
-struct IMAGE_RESOURCE_DIRECTORY_STRING {
-  WORD    Length;
-  CHAR    NameString[1];
-};
+// what a diff compares a file by: its sections and symbols, plus "(headers)" before the first section and
+// "(trailer)" after the last; a file without sections is compared as a whole, as "(file)"
+void diff_layout_of(const char* buff, std::size_t size, file_layout& result) {
+  section_layout(buff, size, result, true);
+  if (result.regions.empty()) {
+    result.regions.push_back({"(file)", 0, size});
+    return;
+  }
 
-struct IMAGE_RESOURCE_DIR_STRING_U {
-  WORD    Length;
-  WCHAR   NameString[1];
+  std::size_t first = size, last = 0;
+  for (const auto& region : result.regions) {
+    first = std::min(first, region.offset);
+    last = std::max(last, region.offset + region.size);
+  }
+  if (first) {
+    result.regions.insert(result.regions.begin(), {"(headers)", 0, first});
+    for (auto& symbol : result.symbols) {
+      ++symbol.region;
+    }
+  }
+  if (last < size) {
+    result.regions.push_back({"(trailer)", last, size - last});
+  }
+}
+
+// the bytes [first, last) of layout region `region`, a share of it one worker takes on
+struct region_piece {
+  std::size_t region;
+  std::size_t first;
+  std::size_t last;
 };
 
-#if defined(unix) || defined(__unix__) || defined(__unix)
-#include <unistd.h>
+// cuts each region of the layout into pieces of `step` bytes (an empty region still gets one) and calls fn on every
+// piece across `jobs` workers; `Piece` is a region_piece with room for what fn finds, and the pieces come back in
+// layout order with it filled in
+template <typename Piece, typename Fn>
+std::vector<Piece> for_each_piece(const file_layout& layout, std::size_t step, std::size_t jobs, Fn fn) {
+  std::vector<Piece> pieces;
+  for (std::size_t i = 0; i < layout.regions.size(); ++i) {
+    std::size_t first = 0;
+    do {
+      auto& p = pieces.emplace_back();
+      p.region = i;
+      p.first = first;
+      p.last = std::min(first + step, layout.regions[i].size);
+      first += step;
+    } while (first < layout.regions[i].size);
+  }
+  parallel_for(pieces.size(), jobs, [&](std::size_t k) { fn(pieces[k]); });
+  return pieces;
+}
 
-#if defined(_POSIX_VERSION) && (_POSIX_VERSION >= 200809L)
-#include <iconv.h>
+// byte histogram and entropy of every section of a PE image, ELF image or COFF object (of the whole file, as
+// "(file)", for anything else); with `window`, also the entropy of each window of that many bytes within them.
+// The sections are cut into pieces of whole windows, so one large section spreads across `jobs` workers as well
+int dump_section_stats(dump_writer& out, const char* buff, std::size_t size, std::size_t window, std::size_t jobs) {
+  static constexpr std::size_t piece_size = 64 << 20;
+  file_layout layout;
+  if (section_layout(buff, size, layout) || layout.regions.empty()) {
+    layout.regions.assign(1, {"(file)", 0, size});
+  }
 
-int dump(const IMAGE_RESOURCE_DIR_STRING_U& string) {
-  int result = 0;
-  auto cd = iconv_open("UTF-8", "UTF-16LE");
-  if (cd != reinterpret_cast<iconv_t>(-1)) {
-    char buff[1024] = {0};
-    auto inbuf = const_cast<char*>(reinterpret_cast<const char*>(string.NameString));
-    std::size_t inbytesleft = string.Length * sizeof(string.NameString[0]);
-    auto outbuf = buff;
-    std::size_t outbytesleft = sizeof(buff);
-    if (iconv(cd, &inbuf, &inbytesleft, &outbuf, &outbytesleft) != static_cast<std::size_t>(-1)) {
-      std::printf("%s\n", buff);
-    }
-    result = iconv_close(cd);
+  struct piece : region_piece {
+    bytestats::histogram histogram;
+    std::vector<unsigned> windows;
+  };
+  const bytestats::window_entropy entropy{window};
+  const auto step = window ? std::max<std::size_t>(window, piece_size / window * window) : piece_size;
+  auto pieces = for_each_piece<piece>(layout, step, jobs, [&](piece& p) {
+    auto data = buff + layout.regions[p.region].offset + p.first;
+    const auto count = p.last - p.first;
+    if (!window) {
+      bytestats::count(data, count, p.histogram);
+      return;
+    }
+    for (std::size_t offset = 0; offset < count; offset += window) {
+      p.windows.push_back(entropy(data + offset, std::min(window, count - offset), p.histogram));
+    }
+  });
+
+  for (std::size_t k = 0; k < pieces.size();) {
+    const auto& region = layout.regions[pieces[k].region];
+    bytestats::histogram histogram{};
+    auto last = k;
+    for (; last < pieces.size() && pieces[last].region == pieces[k].region; ++last) {
+      for (std::size_t v = 0; v < histogram.size(); ++v) {
+        histogram[v] += pieces[last].histogram[v];
+      }
+    }
+    out.section_stats(region.name, region.offset, region.size, bytestats::entropy(histogram, region.size), bytestats::distinct(histogram), histogram);
+    for (; k < last; ++k) {
+      for (std::size_t w = 0; w < pieces[k].windows.size(); ++w) {
+        const auto offset = pieces[k].first + w * window;
+        out.window_entropy(region.name, offset, std::min(window, region.size - offset), pieces[k].windows[w]);
+      }
+    }
   }
-  return result;
+  return 0;
 }
-#endif  // !_POSIX_VERSION
-#else
-int dump(const IMAGE_RESOURCE_DIR_STRING_U& string) {
-  using char_type = std::decay_t<decltype(string.NameString[0])>;
-  std::locale loc;
-  std::string name;
-  std::use_facet<std::ctype<char_type>>(loc).narrow(string.NameString, string.NameString + string.Length, '.', name.data());
 
-  std::printf("%s\n", name.c_str());
+// what -S and -T scan: the sections of a PE image, ELF image or COFF object (the whole file, as "(file)", for
+// anything else when no sections are asked for); `sections` keeps the sections it names, and "+x" the executable ones
+void scanned_regions(const char* buff, std::size_t size, const std::vector<std::string>& sections, file_layout& layout) {
+  if ((section_layout(buff, size, layout) || layout.regions.empty()) && sections.empty()) {
+    layout.regions.assign(1, {"(file)", 0, size});
+  }
+  const bool executable = std::find(sections.begin(), sections.end(), "+x") != sections.end();
+  std::erase_if(layout.regions, [&](const file_region& region) {
+    return !sections.empty() && !(executable && region.executable) && !section_selected(sections, region.name);
+  });
+}
+
+// every match of the signatures in the scanned_regions; large sections are cut into pieces scanned across `jobs`
+// workers
+int dump_signatures(dump_writer& out, const char* buff, std::size_t size, const sigscan::scanner& scanner, const std::vector<std::string>& sections, std::size_t jobs) {
+  static constexpr std::size_t piece_size = 64 << 20;
+  file_layout layout;
+  scanned_regions(buff, size, sections, layout);
+
+  // each piece holds the matches whose anchor starts in it
+  struct piece : region_piece {
+    std::vector<sigscan::match> matches;
+  };
+  auto pieces = for_each_piece<piece>(layout, piece_size, jobs, [&](piece& p) {
+    const auto& region = layout.regions[p.region];
+    scanner.scan(buff + region.offset, region.size, p.first, p.last, p.matches);
+  });
+
+  // a match may start in the piece before the one its anchor is in, so each region is sorted as a whole
+  std::vector<sigscan::match> matches;
+  for (std::size_t k = 0; k < pieces.size();) {
+    const auto& region = layout.regions[pieces[k].region];
+    matches.clear();
+    for (auto i = pieces[k].region; k < pieces.size() && pieces[k].region == i; ++k) {
+      matches.insert(matches.end(), pieces[k].matches.begin(), pieces[k].matches.end());
+    }
+    std::sort(matches.begin(), matches.end());
+    for (const auto& m : matches) {
+      out.signature_match(scanner.patterns()[m.pattern].name, region.name, file_offset_policy<file_region>::cast(region.offset + m.offset, region), region.offset + m.offset);
+    }
+  }
   return 0;
 }
-#endif  // !unix
 
-int dump(const char* base, const std::size_t off, const std::size_t va, const IMAGE_RESOURCE_DIRECTORY* directories) {
-  int result = 0;
-  auto entries = reinterpret_cast<const IMAGE_RESOURCE_DIRECTORY_ENTRY*>(directories + 1);
-  for (std::size_t i = 0; i < directories->NumberOfIdEntries + directories->NumberOfNamedEntries; ++i) {
-    if (entries[i].NameIsString) {
-      if (result = dump(reinterpret_cast<const IMAGE_RESOURCE_DIR_STRING_U&>(base[off + entries[i].NameOffset]))) {
-        break;
+// the ASCII and UTF-16LE strings of at least `min` characters in the scanned_regions, in pieces across `jobs` workers
+// like dump_signatures
+int dump_strings(dump_writer& out, const char* buff, std::size_t size, std::size_t min, const std::vector<std::string>& sections, std::size_t jobs) {
+  static constexpr std::size_t piece_size = 64 << 20;
+  file_layout layout;
+  scanned_regions(buff, size, sections, layout);
+
+  // each piece holds the strings that start in it
+  struct piece : region_piece {
+    std::vector<strscan::run> runs;
+  };
+  auto pieces = for_each_piece<piece>(layout, piece_size, jobs, [&](piece& p) {
+    const auto& region = layout.regions[p.region];
+    strscan::scan(buff + region.offset, region.size, p.first, p.last, min, p.runs);
+  });
+
+  // runs are appended as they end, so each piece is put in order of where they start
+  std::string text;
+  for (auto& p : pieces) {
+    const auto& region = layout.regions[p.region];
+    std::sort(p.runs.begin(), p.runs.end());
+    for (const auto& r : p.runs) {
+      auto data = buff + region.offset + r.offset;
+      if (r.utf16) {
+        text.clear();
+        for (std::size_t i = 0; i < r.size; i += 2) {
+          text.push_back(data[i]);
+        }
       }
-    } else {
-      std::printf("%d\n", entries[i].Id);
+      out.string_run(region.name, file_offset_policy<file_region>::cast(region.offset + r.offset, region), region.offset + r.offset,
+                     r.utf16 ? "utf-16le" : "ascii", r.utf16 ? std::string_view{text} : std::string_view{data, r.size});
     }
+  }
+  return 0;
+}
 
-    if (entries[i].DataIsDirectory) {
-      if (result = dump(base, off, va, reinterpret_cast<const IMAGE_RESOURCE_DIRECTORY*>(&base[off + entries[i].OffsetToDirectory]))) {
-        break;
+// pulls in only what dump_pe64/dump_pe32 dereference: headers, section table and the directories they walk;
+// with `exports`, also a PE32 export directory for dump_pe_lookup, with `relocations`, the base relocation blocks
+// and, with `pages`, every page they patch
+int prefetch_pe(range_reader& reader, bool exports = false, bool relocations = false, bool pages = false) {
+  auto base = reader.data();
+  if (!reader.ensure(0, sizeof(IMAGE_DOS_HEADER))) {
+    return -1;
+  }
+  auto& Dos = reinterpret_cast<const IMAGE_DOS_HEADER&>(base[0]);
+  if (Dos.e_magic != IMAGE_DOS_SIGNATURE || !reader.ensure(Dos.e_lfanew, sizeof(IMAGE_NT_HEADERS32))) {
+    return -1;
+  }
+  reader.ensure(Dos.e_lfanew, sizeof(IMAGE_NT_HEADERS64));
+  auto& Nt = reinterpret_cast<const IMAGE_NT_HEADERS64&>(base[Dos.e_lfanew]);
+  if (Nt.Signature != IMAGE_NT_SIGNATURE) {
+    return -1;
+  }
+  auto first = IMAGE_FIRST_SECTION(&Nt);
+  if (!reader.ensure(reinterpret_cast<const char*>(first) - base, Nt.FileHeader.NumberOfSections * sizeof(IMAGE_SECTION_HEADER))) {
+    return -1;
+  }
+  const rva_index index{first, first + Nt.FileHeader.NumberOfSections, reader.size()};
+  auto offset = [&index](std::size_t rva) {
+    std::size_t off = 0;
+    return index.cast(rva, off) ? off : ~std::size_t{0};
+  };
+
+  auto& Nt32 = reinterpret_cast<const IMAGE_NT_HEADERS32&>(Nt);
+  const bool pe64 = Nt.OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+  if (pe64 || (exports && Nt.OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC)) {
+    auto& directory = pe64 ? Nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT] : Nt32.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+    if (auto va0 = directory.VirtualAddress) {
+      if (auto directories = reinterpret_cast<const IMAGE_EXPORT_DIRECTORY*>(reader.ensure(offset(va0), sizeof(IMAGE_EXPORT_DIRECTORY)))) {
+        const std::size_t count = directories->NumberOfNames;
+        // forwarder strings live inside the directory's own range
+        reader.request(offset(va0), directory.Size);
+        reader.request(offset(directories->AddressOfFunctions), directories->NumberOfFunctions * sizeof(DWORD));
+        reader.request(offset(directories->AddressOfNames), count * sizeof(DWORD));
+        reader.request(offset(directories->AddressOfNameOrdinals), count * sizeof(WORD));
+        reader.fetch();
+
+        std::vector<std::size_t> strings{offset(directories->Name)};
+        auto names = offset(directories->AddressOfNames);
+        if (reader.present(names, count * sizeof(DWORD))) {
+          for (std::size_t i = 0; i < count; ++i) {
+            strings.push_back(offset(reinterpret_cast<const DWORD*>(&base[names])[i]));
+          }
+        }
+        reader.ensure_strings(std::move(strings));
       }
-    } else {
-      auto& data = reinterpret_cast<const IMAGE_RESOURCE_DATA_ENTRY&>(base[off + entries[i].OffsetToData]);
-      std::printf("[%p, %p), offset: %8x, size: %8x, code page: %8x, reserved: %8x\n", reinterpret_cast<void*>(off + data.OffsetToData - va), reinterpret_cast<void*>(off + data.OffsetToData - va + data.Size), data.OffsetToData, data.Size, data.CodePage, data.Reserved);
     }
   }
-  return result;
-}
 
-int dump_pe32(const char* buff) {
-  auto& Dos = reinterpret_cast<const IMAGE_DOS_HEADER&>(buff[0]);
-  if (Dos.e_magic == IMAGE_DOS_SIGNATURE) {
-    auto& Nt = reinterpret_cast<const IMAGE_NT_HEADERS32&>(buff[Dos.e_lfanew]);
-    if (Nt.Signature == IMAGE_NT_SIGNATURE && Nt.OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC) {
-      auto Sections = IMAGE_FIRST_SECTION(&Nt);
-      std::size_t va2 = Nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_RESOURCE].VirtualAddress;
-      if (va2) {
-        for (std::size_t i = 0; i < Nt.FileHeader.NumberOfSections; ++i) {
-          if ((Sections[i].VirtualAddress <= va2) && (va2 < Sections[i].VirtualAddress + Sections[i].Misc.VirtualSize)) {
-            std::printf("pointer to raw data: %x\n", Sections[i].PointerToRawData);
-            const std::ptrdiff_t delta = reinterpret_cast<std::size_t>(buff) + Sections[i].PointerToRawData - Sections[i].VirtualAddress;
-            dump(buff, Sections[i].PointerToRawData, Sections[i].VirtualAddress, reinterpret_cast<const IMAGE_RESOURCE_DIRECTORY*>(&buff[Sections[i].PointerToRawData + va2 - Sections[i].VirtualAddress]));
-            break;
+  if (pe64) {
+    if (auto va1 = Nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress) {
+      // descriptor and thunk arrays are zero-terminated: grow each in chunks until the terminator is in
+      std::vector<const IMAGE_IMPORT_DESCRIPTOR*> descriptors;
+      for (std::size_t off = offset(va1), n = 0;; n += 16) {
+        if (!reader.ensure(off, (n + 16) * sizeof(IMAGE_IMPORT_DESCRIPTOR)) && !reader.ensure(off, (n + 1) * sizeof(IMAGE_IMPORT_DESCRIPTOR))) {
+          break;
+        }
+        auto iter = reinterpret_cast<const IMAGE_IMPORT_DESCRIPTOR*>(&base[off]) + n, last = iter + 16;
+        for (; iter != last && reader.present(reinterpret_cast<const char*>(iter) - base, sizeof(*iter)) && iter->Name; ++iter) {
+          descriptors.push_back(iter);
+        }
+        if (iter != last) {
+          break;
+        }
+      }
+
+      std::vector<std::size_t> strings, thunks;
+      for (auto descriptor : descriptors) {
+        strings.push_back(offset(descriptor->Name));
+        thunks.push_back(offset(descriptor->OriginalFirstThunk));
+      }
+      for (std::size_t n = 16; !thunks.empty(); n *= 4) {
+        for (auto off : thunks) {
+          reader.request(off, n * sizeof(IMAGE_THUNK_DATA64));
+        }
+        reader.fetch();
+        std::erase_if(thunks, [&](std::size_t off) {
+          for (auto thunk = reinterpret_cast<const IMAGE_THUNK_DATA64*>(&base[off]), last = thunk + n; thunk != last; ++thunk) {
+            if (!reader.present(reinterpret_cast<const char*>(thunk) - base, sizeof(*thunk)) || !thunk->u1.AddressOfData) {
+              return true;
+            }
+            if (!IMAGE_SNAP_BY_ORDINAL64(thunk->u1.Ordinal)) {
+              auto name = offset(static_cast<DWORD>(thunk->u1.AddressOfData));
+              reader.request(name, sizeof(IMAGE_IMPORT_BY_NAME::Hint));
+              strings.push_back(name + sizeof(IMAGE_IMPORT_BY_NAME::Hint));
+            }
+          }
+          return false;
+        });
+      }
+      reader.ensure_strings(std::move(strings));
+    }
+  }
+
+  if (pe64 || Nt.OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC) {
+    std::size_t va2 = pe64 ? Nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_RESOURCE].VirtualAddress
+                           : Nt32.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_RESOURCE].VirtualAddress;
+    if (va2 && offset(va2) < reader.size()) {
+      // same addressing as pe_resource_tree: names, subdirectories and data entries are relative to the root
+      const std::size_t off = offset(va2);
+      std::vector<std::size_t> level{offset(va2)}, visited;
+      while (!level.empty()) {
+        std::vector<std::size_t> next, names;
+        for (auto dir : level) {
+          reader.request(dir, sizeof(IMAGE_RESOURCE_DIRECTORY));
+        }
+        reader.fetch();
+        for (auto dir : level) {
+          if (reader.present(dir, sizeof(IMAGE_RESOURCE_DIRECTORY))) {
+            auto& directory = reinterpret_cast<const IMAGE_RESOURCE_DIRECTORY&>(base[dir]);
+            reader.request(dir + sizeof(directory), (directory.NumberOfIdEntries + directory.NumberOfNamedEntries) * sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY));
+          }
+        }
+        reader.fetch();
+        for (auto dir : level) {
+          if (!reader.present(dir, sizeof(IMAGE_RESOURCE_DIRECTORY))) {
+            continue;
+          }
+          auto& directory = reinterpret_cast<const IMAGE_RESOURCE_DIRECTORY&>(base[dir]);
+          auto entries = reinterpret_cast<const IMAGE_RESOURCE_DIRECTORY_ENTRY*>(&directory + 1);
+          const std::size_t count = directory.NumberOfIdEntries + directory.NumberOfNamedEntries;
+          if (!reader.present(reinterpret_cast<const char*>(entries) - base, count * sizeof(*entries))) {
+            continue;
+          }
+          for (std::size_t i = 0; i < count; ++i) {
+            if (entries[i].NameIsString) {
+              names.push_back(off + entries[i].NameOffset);
+              reader.request(names.back(), sizeof(WORD));
+            }
+            if (!entries[i].DataIsDirectory) {
+              reader.request(off + entries[i].OffsetToData, sizeof(IMAGE_RESOURCE_DATA_ENTRY));
+            } else if (auto sub = off + entries[i].OffsetToDirectory; std::find(visited.begin(), visited.end(), sub) == visited.end()) {
+              visited.push_back(sub);
+              next.push_back(sub);
+            }
+          }
+        }
+        reader.fetch();
+        for (auto name : names) {
+          if (reader.present(name, sizeof(WORD))) {
+            reader.request(name, sizeof(WORD) + reinterpret_cast<const WORD&>(base[name]) * sizeof(WCHAR));
           }
         }
+        reader.fetch();
+        level = std::move(next);
+      }
+    }
+  }
+
+  if (relocations) {
+    auto directory = pe64 ? Nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC] : Nt32.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+    if (auto off = directory.VirtualAddress ? offset(directory.VirtualAddress) : reader.size(); off < reader.size()) {
+      const auto size = std::min<std::size_t>(directory.Size, reader.size() - off);
+      pe_base_relocations blocks;
+      if (reader.ensure(off, size) && pages && !blocks.open(&base[off], size)) {
+        // the span between the block's lowest and highest target, which need not start at a section boundary
+        blocks.for_each_block([&](std::uint32_t page, const std::uint16_t* entries, std::size_t count) {
+          std::uint32_t low = rebase::page_size, high = 0;
+          for (std::size_t i = 0; i < count; ++i) {
+            low = std::min<std::uint32_t>(low, entries[i] & 0xfff);
+            high = std::max<std::uint32_t>(high, entries[i] & 0xfff);
+          }
+          if (low <= high) {
+            reader.request(offset(page + low), high - low + 8);
+          }
+        });
+        reader.fetch();
       }
     }
   }
   return 0;
 }
 
-int dump_obj64(const char* buff) {
-  auto& FileHeader = reinterpret_cast<const IMAGE_FILE_HEADER&>(buff[0]);
-  std::printf("NumberOfSections: %d\n", FileHeader.NumberOfSections);
-  auto Sections = reinterpret_cast<const IMAGE_SECTION_HEADER*>(&buff[sizeof(FileHeader) + FileHeader.SizeOfOptionalHeader]);
-  for (std::size_t i = 0; i < FileHeader.NumberOfSections; ++i) {
-    std::printf("%8s\n", Sections[i].Name);
+// ELF header, section header table, and the section name strings dump_elf prints;
+// with `symbols`, also the symbol tables, their string tables and hash tables for dump_elf_symbols/dump_elf_lookup
+// (through PT_DYNAMIC when there are no section headers),
+// every file range loaded_image places, once prefetch_pe or prefetch_elf has pulled in the headers, so -L lays the
+// image out from what was read rather than from the file
+int prefetch_loaded(range_reader& reader) {
+  std::vector<loaded_image::region> regions;
+  if (loaded_image::file_ranges(reader.data(), reader.size(), regions)) {
+    return -1;
+  }
+  for (const auto& r : regions) {
+    reader.request(r.offset, r.size);
+  }
+  return reader.fetch();
+}
+
+// the sections dump_elf_contents selects, and with `segments` every PT_LOAD segment for dump_elf_relocations
+int prefetch_elf(range_reader& reader, bool symbols = false, const std::vector<std::string>& contents = {}, bool segments = false) {
+  auto base = reader.data();
+  if (!reader.ensure(0, std::min(sizeof(Elf64_Ehdr), reader.size()))) {
+    return -1;
+  }
+  return visit_elf(base, [&reader, symbols, &contents, segments](const auto& elf) {
+    using shdr_type = std::remove_cvref_t<decltype(elf)>::shdr_type;
+    using phdr_type = std::remove_cvref_t<decltype(elf)>::phdr_type;
+    auto& ehdr = elf.header();
+    if (segments && reader.ensure(elf.get(ehdr.e_phoff), elf.get(ehdr.e_phnum) * sizeof(phdr_type))) {
+      elf.for_each_segment([&](std::size_t, const elf_segment& segment) {
+        if (segment.type == PT_LOAD) {
+          reader.request(segment.offset, segment.filesz);
+        }
+      });
+      reader.fetch();
+    }
+    const std::size_t count = elf.section_count(), strndx = elf.get(ehdr.e_shstrndx);
+    if (symbols && !count && reader.ensure(elf.get(ehdr.e_phoff), elf.get(ehdr.e_phnum) * sizeof(phdr_type))) {
+      // no section headers: the dynamic table, then from each table it names to the end of that table's segment
+      elf_segment_index index;
+      if (!index.open(elf, reader.size())) {
+        elf.for_each_segment([&](std::size_t, const elf_segment& segment) {
+          if (segment.type == PT_DYNAMIC) {
+            reader.request(segment.offset, segment.filesz);
+          }
+        });
+        reader.fetch();
+        index.for_each_dynamic(elf, [&](std::int64_t tag, std::uint64_t value) {
+          std::size_t offset = 0;
+          if ((tag == DT_GNU_HASH || tag == DT_HASH || tag == DT_SYMTAB || tag == DT_STRTAB) && index.to_offset(value, 1, offset)) {
+            reader.request(offset, index.available(value));
+          }
+        });
+        reader.fetch();
+      }
+    }
+    if (!reader.ensure(elf.get(ehdr.e_shoff), count * sizeof(shdr_type)) || strndx >= count) {
+      return -1;
+    }
+    std::vector<std::size_t> strings;
+    const auto shstr = elf.section(strndx).offset;
+    elf.for_each_section([&](std::size_t, const elf_section& section) {
+      strings.push_back(shstr + section.name);
+      if (symbols && (section.type == SHT_SYMTAB || section.type == SHT_DYNSYM) && section.link < count) {
+        auto strtab = elf.section(section.link);
+        reader.request(section.offset, section.size);
+        reader.request(strtab.offset, strtab.size);
+      }
+      if (symbols && (section.type == SHT_GNU_HASH || section.type == SHT_HASH)) {
+        reader.request(section.offset, section.size);
+      }
+    });
+    reader.ensure_strings(std::move(strings));
+    if (!contents.empty()) {
+      elf.for_each_section([&](std::size_t, const elf_section& section) {
+        if (section.type != SHT_NOBITS && section_selected(contents, elf.section_name(section, reader.size()))) {
+          reader.request(section.offset, section.size);
+        }
+      });
+      reader.fetch();
+    }
+    return 0;
+  });
+}
+
+// the file header and section table of a COFF object; with `symbols`, also its symbol and string tables
+int prefetch_obj(range_reader& reader, bool symbols = false) {
+  auto base = reader.data();
+  if (!reader.ensure(0, std::min(sizeof(IMAGE_FILE_HEADER), reader.size()))) {
+    return -1;
+  }
+  auto header = coff_object_header(base, reader.size());
+  if (!header || !reader.ensure(sizeof(IMAGE_FILE_HEADER), header->NumberOfSections * sizeof(IMAGE_SECTION_HEADER))) {
+    return -1;
+  }
+  const std::size_t strings = header->PointerToSymbolTable + std::size_t{header->NumberOfSymbols} * sizeof(IMAGE_SYMBOL);
+  if (symbols && strings <= reader.size() && reader.ensure(header->PointerToSymbolTable, strings - header->PointerToSymbolTable + std::min<std::size_t>(sizeof(DWORD), reader.size() - strings))) {
+    if (reader.present(strings, sizeof(DWORD))) {
+      reader.ensure(strings, std::min<std::size_t>(reinterpret_cast<const DWORD&>(base[strings]), reader.size() - strings));
+    }
   }
   return 0;
 }
 
-int dump_obj_sym(const char* buff) {
-  std::size_t addr = reinterpret_cast<std::size_t>(buff);
+// pulls in the file data of every section for the statistics, or the whole file when it has none
+int prefetch_sections(range_reader& reader) {
+  file_layout layout;
+  if (section_layout(reader.data(), reader.size(), layout) || layout.regions.empty()) {
+    return reader.ensure(0, reader.size()) ? 0 : -1;
+  }
+  for (const auto& region : layout.regions) {
+    reader.request(region.offset, region.size);
+  }
+  return reader.fetch();
+}
 
-  auto& FileHeader = reinterpret_cast<const IMAGE_FILE_HEADER&>(buff[0]);
-  auto symbols = reinterpret_cast<const IMAGE_SYMBOL*>(addr + FileHeader.PointerToSymbolTable);
-  auto table = reinterpret_cast<const char*>(symbols + FileHeader.NumberOfSymbols);
-  for (std::size_t i = 0; i < FileHeader.NumberOfSymbols; ++i) {
-    std::printf("%-08x %-04x %-04x %-02x", symbols[i].Value, static_cast<std::uint16_t>(symbols[i].SectionNumber), symbols[i].Type, symbols[i].StorageClass);
-    if (symbols[i].N.Name.Short) {
-      char name[sizeof(IMAGE_SYMBOL::N.ShortName) + 1] = {0};
-      std::strncpy(name, reinterpret_cast<const char*>(symbols[i].N.ShortName), sizeof(IMAGE_SYMBOL::N.ShortName));
-      std::printf("%8s\n", name);
-    } else {
-      std::printf("%s\n", table + symbols[i].N.Name.Long);
+struct options {
+  bool recursive = false;
+  bool headers_only = false;
+  bool symbols = false;
+  bool resolve = false;
+  bool diff = false;  // -D: compare the second path, a newer build, against the first
+  std::vector<std::string> contents;  // sections to hex dump, decompressed
+  bool rebase = false;
+  std::uint64_t image_base = 0;  // load address for -b
+  bool relocation_pages = false;
+  bool loaded = false;  // -L: lay images out as loaded; -b then rebases that layout
+  const char* output = nullptr;  // -o: where -b writes the rebased image
+  std::string extract;  // -X: directory to write PE resources under
+  bool verbose = false;
+  std::size_t jobs = 0;  // 0: one worker per hardware thread
+  dump_format format = dump_format::text;
+  const char* cache = nullptr;
+  bool cache_verify = false;
+  std::vector<std::string> lookups;  // symbol names to look up in each PE or ELF image or COFF object
+  std::vector<std::int16_t> symbol_sections;  // -y: COFF sections whose symbols to list in value order
+  bool stats = false;  // -E: byte histogram and entropy per section
+  std::size_t entropy_window = 0;  // and per window of this many bytes, when not 0
+  sigscan::scanner signatures;  // -S: byte signatures to scan for
+  std::size_t strings = 0;  // -T: the shortest string to report, none when 0
+  std::vector<std::string> scan_sections;  // -M: sections -S and -T scan, "+x" for the executable ones; all when empty
+  std::vector<std::string> paths;
+};
+
+// runs every dumper the options ask for over the `size` bytes of `path` at `data`: `writable` is a private copy of
+// them that rebasing may patch (null when none is needed), and `complete` says whether all of them were read rather
+// than only what the prefetch for these options pulled in
+void dump_contents(dump_writer& writer, const char* path, const char* data, std::size_t size, char* writable, bool complete, const options& opts) {
+  dump_pe64(writer, data, size);
+  dump_pe32(writer, data, size);
+  dump_elf(writer, data, size);
+  dump_obj64(writer, data, size);
+  if (opts.symbols) {
+    dump_elf_symbols(writer, data, size);
+  }
+  if (opts.symbols || !opts.symbol_sections.empty()) {
+    dump_obj_sym(writer, data, size, opts.symbol_sections);
+  }
+  if (!opts.lookups.empty()) {
+    dump_pe_lookup(writer, data, size, opts.lookups);
+    dump_elf_lookup(writer, data, size, opts.lookups);
+    dump_obj_lookup(writer, data, size, opts.lookups);
+  }
+  if (!opts.contents.empty()) {
+    dump_elf_contents(writer, data, size, opts.contents, opts.jobs);
+  }
+  if (opts.relocation_pages) {
+    dump_pe_relocation_pages(writer, data, size);
+  }
+  if (opts.loaded) {
+    dump_loaded_image(writer, path, data, size, complete, opts.rebase, opts.image_base, opts.output);
+  } else if (opts.rebase) {
+    dump_pe_relocations(writer, writable, size, opts.image_base, opts.output);
+    dump_elf_relocations(writer, data, size, writable, opts.image_base, opts.output);
+  }
+  if (!opts.extract.empty()) {
+    extract_pe_resources(writer, path, data, size, complete ? data : nullptr, opts.extract, opts.jobs);
+  }
+  if (opts.stats) {
+    dump_section_stats(writer, data, size, opts.entropy_window, opts.jobs);
+  }
+  if (!opts.signatures.empty()) {
+    dump_signatures(writer, data, size, opts.signatures, opts.scan_sections, opts.jobs);
+  }
+  if (opts.strings) {
+    dump_strings(writer, data, size, opts.strings, opts.scan_sections, opts.jobs);
+  }
+}
+
+// opens `path` the way the options ask for, either mapped whole or (-H) prefetching only what the dumpers will
+// read, and runs dump_contents over it; -1 if it cannot be opened
+int dump_image(output_sink& out, const char* path, const options& opts, bool header = true) {
+  dump_writer writer{out, opts.format};
+  if (opts.headers_only) {
+    range_reader reader;
+    if (reader.open(path)) {
+      return -1;
+    }
+    if (header) {
+      writer.file(path);
+    }
+    if (!reader.empty()) {
+      prefetch_pe(reader, !opts.lookups.empty(), opts.rebase || opts.relocation_pages, opts.rebase);
+      prefetch_elf(reader, opts.symbols || !opts.lookups.empty(), opts.contents, opts.rebase || opts.loaded);
+      prefetch_obj(reader, opts.symbols || !opts.lookups.empty() || !opts.symbol_sections.empty());
+      if (opts.stats || !opts.signatures.empty() || opts.strings) {
+        prefetch_sections(reader);
+      }
+      if (opts.loaded) {
+        prefetch_loaded(reader);
+      }
+      if (opts.output) {
+        reader.ensure(0, reader.size());  // -o writes out every byte
+      }
+      dump_contents(writer, path, reader.data(), reader.size(), reader.data(), false, opts);
+    }
+    if (opts.verbose) {
+      std::fprintf(stderr, "%s: read %zu of %zu bytes in %zu calls\n", path, reader.bytes_read(), reader.size(), reader.reads());
     }
+    return 0;
+  }
+
+  mapped_image image;
+  if (image.open(path, (opts.symbols || opts.stats || !opts.signatures.empty() || opts.strings) ? mapped_image::access::sequential : mapped_image::access::random)) {
+    return -1;
+  }
+  if (header) {
+    writer.file(path);
+  }
+  if (!image.empty()) {
+    dump_contents(writer, path, image.data(), image.size(), (opts.rebase && !opts.loaded) ? image.copy_on_write() : nullptr, true, opts);
   }
   return 0;
 }
 
-int dump_elf64le(const char* buff) {
-  if (!std::memcmp(buff, ELFMAG, SELFMAG) && buff[EI_CLASS] == ELFCLASS64) {
-    auto& ehdr = reinterpret_cast<const Elf64_Ehdr&>(buff[0]);
-    auto shdr = reinterpret_cast<const Elf64_Shdr*>(&buff[ehdr.e_shoff]);
+// dump_image, served from and recorded into the result cache when one is configured; never when extracting or
+// writing a rebased image, as a cached record cannot replay the files written
+int dump_file(output_sink& out, const char* path, const options& opts, const result_cache& cache) {
+  result_cache::key key;
+  if (!cache.enabled() || !opts.extract.empty() || opts.output || result_cache::stat(path, key)) {
+    return dump_image(out, path, opts);
+  }
+
+  std::uint64_t content_hash = 0;
+  if (cache.verify()) {
+    mapped_image image;
+    if (image.open(path, mapped_image::access::sequential)) {
+      return -1;
+    }
+    content_hash = hash_bytes(image.data(), image.size());
+  }
 
-    auto shstr = &buff[shdr[ehdr.e_shstrndx].sh_offset];
-    for (auto iter = shdr; iter != shdr + ehdr.e_shnum; ++iter) {
-      std::printf("%s\n", &shstr[iter->sh_name]);
+  result_cache::entry entry;
+  if (cache.lookup(key, entry, content_hash)) {
+    dump_writer{out, opts.format}.file(path);
+    out.write(entry.payload());
+    if (opts.verbose) {
+      std::fprintf(stderr, "%s: cached\n", path);
+    }
+    return 0;
+  }
+
+  std::string payload;
+  auto previous = out.target();
+  out.attach(&payload);
+  auto result = dump_image(out, path, opts, false);
+  out.attach(previous);
+  if (!result) {
+    cache.store(key, payload, content_hash);
+    dump_writer{out, opts.format}.file(path);
+    out.write(payload);
+  }
+  return result;
+}
+
+int usage(const char* program) {
+  std::fprintf(stderr, "usage: %s [-r] [-H] [-s] [-q name|@file] [-x section] [-y section] [-b base [-o file]] [-B] [-L] [-X dir] [-E window] [-S sig|@file] [-T min] [-M section] [-R] [-D] [-v] [-j jobs] [-f text|ndjson|binary] [-C dir [--cache-verify]] file...\n", program);
+  std::fprintf(stderr, "  -r       descend into directories\n");
+  std::fprintf(stderr, "  -H       read only the headers and directories being dumped instead of the whole file\n");
+  std::fprintf(stderr, "  -s       dump ELF symbol tables (.symtab and .dynsym) and COFF object symbol tables\n");
+  std::fprintf(stderr, "  -q name  look name up in each PE image's exports (#123 for an ordinal), ELF image's symbol hash table or COFF object's symbols; @file reads one name per line\n");
+  std::fprintf(stderr, "  -x name  hex dump an ELF section, decompressing SHF_COMPRESSED ones; a trailing * matches a prefix\n");
+  std::fprintf(stderr, "  -y n     list the symbols of COFF section n (0 undefined, -1 absolute, -2 debug) in value order\n");
+  std::fprintf(stderr, "  -b base  apply each ELF image's dynamic relocations, or each PE image's base relocations, for load address base\n");
+  std::fprintf(stderr, "           and report the counts\n");
+  std::fprintf(stderr, "  -B       count each PE base relocation block's fixups by type, without applying them\n");
+  std::fprintf(stderr, "  -L       lay each image out the way the loader would and report the layout; -b then rebases that layout\n");
+  std::fprintf(stderr, "  -o file  with -b and a single input, write the rebased image to file: the file itself (with ImageBase updated\n");
+  std::fprintf(stderr, "           for PE), or with -L the loaded layout; the whole input is read even with -H\n");
+  std::fprintf(stderr, "  -X dir   write each PE resource to dir/<file>/<type>/<name>/<language>\n");
+  std::fprintf(stderr, "  -E n     byte histogram and entropy of each section; n > 0 adds the entropy of every n byte window\n");
+  std::fprintf(stderr, "  -S sig   report every match of a hex byte signature such as \"4d 5a ?? ?0 90\" (?? any byte, ? any nibble),\n");
+  std::fprintf(stderr, "           given as name=hex or hex; @file reads one per line, skipping # comments\n");
+  std::fprintf(stderr, "  -T min   list the ASCII and UTF-16LE strings of at least min printable characters\n");
+  std::fprintf(stderr, "  -M name  scan only this section for -S signatures and -T strings, +x for every executable one; a trailing *\n");
+  std::fprintf(stderr, "           matches a prefix\n");
+  std::fprintf(stderr, "  -R       resolve every import against the exports of the other files and report the missing or ambiguous ones,\n");
+  std::fprintf(stderr, "           and ELF symbols interposed by an earlier module; exits with 2 when any is missing or ambiguous\n");
+  std::fprintf(stderr, "  -D       compare the second file (or, with -r, directory) against the first by section and symbol and report\n");
+  std::fprintf(stderr, "           the changed ranges; exits with 2 when they differ\n");
+  std::fprintf(stderr, "  -v       report bytes read per file on stderr\n");
+  std::fprintf(stderr, "  -j jobs  number of worker threads when dumping several files\n");
+  std::fprintf(stderr, "  -f fmt   output format: text (default), ndjson, or length-prefixed binary records\n");
+  std::fprintf(stderr, "  -C dir   reuse results of unchanged files (same device, inode, mtime and size) cached in dir\n");
+  std::fprintf(stderr, "  --cache-verify\n");
+  std::fprintf(stderr, "           also require a matching content hash before using a cached result\n");
+  return 1;
+}
+
+int parse_options(int argc, char* argv[], options& opts) {
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg{argv[i]};
+    if (arg == "--") {
+      opts.paths.insert(opts.paths.end(), argv + i + 1, argv + argc);
+      break;
+    } else if (arg == "-r") {
+      opts.recursive = true;
+    } else if (arg == "-H") {
+      opts.headers_only = true;
+    } else if (arg == "-s") {
+      opts.symbols = true;
+    } else if (arg.starts_with("-q")) {
+      auto value = (arg.size() > 2) ? arg.substr(2) : (i + 1 < argc) ? std::string_view{argv[++i]} : std::string_view{};
+      if (value.empty()) {
+        return -1;
+      }
+      if (value[0] != '@') {
+        opts.lookups.emplace_back(value);
+        continue;
+      }
+      mapped_image names;
+      if (names.open(std::string{value.substr(1)}.c_str(), mapped_image::access::sequential)) {
+        return -1;
+      }
+      for (std::string_view rest{names.data(), names.size()}; !rest.empty();) {
+        auto line = rest.substr(0, rest.find('\n'));
+        rest.remove_prefix(std::min(rest.size(), line.size() + 1));
+        if (!line.empty() && line.back() == '\r') {
+          line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+          opts.lookups.emplace_back(line);
+        }
+      }
+    } else if (arg.starts_with("-x")) {
+      auto value = (arg.size() > 2) ? arg.substr(2) : (i + 1 < argc) ? std::string_view{argv[++i]} : std::string_view{};
+      if (value.empty()) {
+        return -1;
+      }
+      opts.contents.emplace_back(value);
+    } else if (arg.starts_with("-y")) {
+      auto value = (arg.size() > 2) ? arg.substr(2) : (i + 1 < argc) ? std::string_view{argv[++i]} : std::string_view{};
+      std::int16_t section = 0;
+      auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), section);
+      if (value.empty() || ec != std::errc{} || ptr != value.data() + value.size()) {
+        return -1;
+      }
+      opts.symbol_sections.push_back(section);
+    } else if (arg.starts_with("-b")) {
+      auto value = (arg.size() > 2) ? arg.substr(2) : (i + 1 < argc) ? std::string_view{argv[++i]} : std::string_view{};
+      int radix = 10;
+      if (value.starts_with("0x") || value.starts_with("0X")) {
+        value.remove_prefix(2);
+        radix = 16;
+      }
+      auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), opts.image_base, radix);
+      if (value.empty() || ec != std::errc{} || ptr != value.data() + value.size()) {
+        return -1;
+      }
+      opts.rebase = true;
+    } else if (arg == "-B") {
+      opts.relocation_pages = true;
+    } else if (arg == "-L") {
+      opts.loaded = true;
+    } else if (arg.starts_with("-o")) {
+      opts.output = (arg.size() > 2) ? argv[i] + 2 : (i + 1 < argc) ? argv[++i] : nullptr;
+      if (!opts.output) {
+        return -1;
+      }
+    } else if (arg.starts_with("-X")) {
+      auto value = (arg.size() > 2) ? arg.substr(2) : (i + 1 < argc) ? std::string_view{argv[++i]} : std::string_view{};
+      if (value.empty()) {
+        return -1;
+      }
+      opts.extract = value;
+    } else if (arg.starts_with("-E")) {
+      auto value = (arg.size() > 2) ? arg.substr(2) : (i + 1 < argc) ? std::string_view{argv[++i]} : std::string_view{};
+      auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), opts.entropy_window);
+      if (value.empty() || ec != std::errc{} || ptr != value.data() + value.size()) {
+        return -1;
+      }
+      opts.stats = true;
+    } else if (arg.starts_with("-S")) {
+      auto value = (arg.size() > 2) ? arg.substr(2) : (i + 1 < argc) ? std::string_view{argv[++i]} : std::string_view{};
+      if (value.empty()) {
+        return -1;
+      }
+      auto add = [&opts](std::string_view line) {
+        auto split = line.find('=');
+        return (split == std::string_view::npos) ? opts.signatures.add(line, line) : opts.signatures.add(line.substr(0, split), line.substr(split + 1));
+      };
+      if (value[0] != '@') {
+        if (add(value)) {
+          return -1;
+        }
+        continue;
+      }
+      mapped_image lines;
+      if (lines.open(std::string{value.substr(1)}.c_str(), mapped_image::access::sequential)) {
+        return -1;
+      }
+      for (std::string_view rest{lines.data(), lines.size()}; !rest.empty();) {
+        auto line = rest.substr(0, rest.find('\n'));
+        rest.remove_prefix(std::min(rest.size(), line.size() + 1));
+        if (!line.empty() && line.back() == '\r') {
+          line.remove_suffix(1);
+        }
+        if (!line.empty() && line[0] != '#' && add(line)) {
+          return -1;
+        }
+      }
+    } else if (arg.starts_with("-T")) {
+      auto value = (arg.size() > 2) ? arg.substr(2) : (i + 1 < argc) ? std::string_view{argv[++i]} : std::string_view{};
+      auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), opts.strings);
+      if (value.empty() || ec != std::errc{} || ptr != value.data() + value.size() || !opts.strings) {
+        return -1;
+      }
+    } else if (arg.starts_with("-M")) {
+      auto value = (arg.size() > 2) ? arg.substr(2) : (i + 1 < argc) ? std::string_view{argv[++i]} : std::string_view{};
+      if (value.empty()) {
+        return -1;
+      }
+      opts.scan_sections.emplace_back(value);
+    } else if (arg == "-R") {
+      opts.resolve = true;
+    } else if (arg == "-D") {
+      opts.diff = true;
+    } else if (arg == "-v") {
+      opts.verbose = true;
+    } else if (arg.starts_with("-C")) {
+      opts.cache = (arg.size() > 2) ? argv[i] + 2 : (i + 1 < argc) ? argv[++i] : nullptr;
+      if (!opts.cache) {
+        return -1;
+      }
+    } else if (arg.starts_with("-f")) {
+      auto value = (arg.size() > 2) ? arg.substr(2) : (i + 1 < argc) ? std::string_view{argv[++i]} : std::string_view{};
+      if (value == "text") {
+        opts.format = dump_format::text;
+      } else if (value == "ndjson") {
+        opts.format = dump_format::ndjson;
+      } else if (value == "binary") {
+        opts.format = dump_format::binary;
+      } else {
+        return -1;
+      }
+    } else if (arg == "--cache-verify") {
+      opts.cache_verify = true;
+    } else if (arg.starts_with("-j")) {
+      auto value = (arg.size() > 2) ? arg.substr(2) : (i + 1 < argc) ? std::string_view{argv[++i]} : std::string_view{};
+      auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), opts.jobs);
+      if (value.empty() || ec != std::errc{} || ptr != value.data() + value.size()) {
+        return -1;
+      }
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      return -1;
+    } else {
+      opts.paths.emplace_back(arg);
+    }
+  }
+  opts.signatures.build();
+  return opts.paths.empty() ? -1 : 0;
+}
+
+// expands directories (when recursive) into their regular files, in a stable sorted order
+std::vector<std::string> collect_files(const options& opts) {
+  std::vector<std::string> files;
+  for (const auto& path : opts.paths) {
+    std::error_code ec;
+    if (opts.recursive && std::filesystem::is_directory(path, ec)) {
+      std::vector<std::string> found;
+      for (auto iter = std::filesystem::recursive_directory_iterator{path, std::filesystem::directory_options::skip_permission_denied, ec}; !ec && iter != std::filesystem::recursive_directory_iterator{}; iter.increment(ec)) {
+        if (iter->is_regular_file(ec)) {
+          found.push_back(iter->path().string());
+        }
+      }
+      std::sort(found.begin(), found.end());
+      files.insert(files.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+    } else {
+      files.push_back(path);
+    }
+  }
+  return files;
+}
+
+// dumps files across the pool into per-file buffers and emits them in input order;
+// at most `window` files are in flight so memory stays bounded on large corpora. The pool already has a worker per
+// job, so each file is dumped with a single one rather than a pool of its own
+int dump_batch(output_sink& out, const std::vector<std::string>& files, const options& opts, const result_cache& cache) {
+  thread_pool pool{opts.jobs ? opts.jobs : std::thread::hardware_concurrency()};
+  auto file_opts = opts;
+  file_opts.jobs = 1;
+  std::vector<std::unique_ptr<output_sink>> sinks;
+  for (std::size_t i = 0; i <= pool.size(); ++i) {
+    sinks.push_back(std::make_unique<output_sink>(static_cast<std::string*>(nullptr)));
+  }
+
+  const std::size_t window = 4 * pool.size();
+  std::vector<std::string> results(files.size());
+  std::vector<char> ready(files.size());
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  auto submit = [&](std::size_t i) {
+    pool.submit([&, i] {
+      auto& sink = *sinks[pool.worker_index()];
+      sink.attach(&results[i]);
+      dump_file(sink, files[i].c_str(), file_opts, cache);
+      sink.attach(nullptr);
+      {
+        std::lock_guard lock{mutex};
+        ready[i] = 1;
+      }
+      cv.notify_one();
+    });
+  };
+
+  for (std::size_t i = 0; i < std::min(window, files.size()); ++i) {
+    submit(i);
+  }
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    {
+      std::unique_lock lock{mutex};
+      cv.wait(lock, [&] { return ready[i]; });
+    }
+    out.write(results[i]);
+    std::string{}.swap(results[i]);
+    if (i + window < files.size()) {
+      submit(i + window);
     }
   }
   return 0;
 }
 
+// the -q names, -x sections, -b base, -y sections, -E window, -S signatures and -T length with their -M sections, kept clear of the low bits cache_variant uses for flags
+std::uint64_t lookup_variant(const options& opts) {
+  std::uint64_t h = 0;
+  for (const auto& name : opts.lookups) {
+    h = hash_bytes(name.data(), name.size(), h + 1);
+  }
+  for (const auto& name : opts.contents) {
+    h = hash_bytes(name.data(), name.size(), h + 2);
+  }
+  if (opts.rebase) {
+    h = hash_bytes(&opts.image_base, sizeof(opts.image_base), h + 3);
+  }
+  for (auto section : opts.symbol_sections) {
+    h = hash_bytes(&section, sizeof(section), h + 4);
+  }
+  if (opts.stats) {
+    h = hash_bytes(&opts.entropy_window, sizeof(opts.entropy_window), h + 5);
+  }
+  for (const auto& sig : opts.signatures.patterns()) {
+    h = hash_bytes(sig.name.data(), sig.name.size(), h + 6);
+    h = hash_bytes(sig.value.data(), sig.value.size(), h);
+    h = hash_bytes(sig.mask.data(), sig.mask.size(), h);
+  }
+  if (opts.strings) {
+    h = hash_bytes(&opts.strings, sizeof(opts.strings), h + 8);
+  }
+  if (!opts.signatures.empty() || opts.strings) {
+    for (const auto& name : opts.scan_sections) {
+      h = hash_bytes(name.data(), name.size(), h + 7);
+    }
+  }
+  return h << 16;
+}
+
+// one export index over all files, then every import checked against it; 2 when any import is left unresolved,
+// while interposed ELF symbols are reported but do not count
+int resolve_batch(output_sink& out, const std::vector<std::string>& files, const options& opts) {
+  thread_pool pool{opts.jobs ? opts.jobs : std::thread::hardware_concurrency()};
+  import_resolver resolver;
+  resolver.build(pool, files);
+
+  dump_writer writer{out, opts.format};
+  std::size_t problems = 0, warnings = 0;
+  auto checked = resolver.resolve(pool, [&](const import_resolver::problem& p) {
+    writer.unresolved_import(resolver.modules()[p.importer].path, import_resolver::status_name(p.what), p.module, p.symbol, p.providers);
+    ++(import_resolver::is_warning(p.what) ? warnings : problems);
+  });
+  if (opts.verbose) {
+    std::fprintf(stderr, "%zu modules, %zu imports, %zu unresolved, %zu interposed\n", resolver.modules().size(), checked, problems, warnings);
+  }
+  return problems ? 2 : 0;
+}
+
+// compares two builds of a file region by region: regions are paired by name (the n-th of a name in one with the
+// n-th in the other) and compared across `jobs` workers, then the symbols of the regions that changed are paired
+// the same way and compared byte for byte. 0 when identical, 2 when they differ, -1 when either cannot be read
+int diff_images(dump_writer& out, const char* old_path, const char* new_path, std::size_t jobs) {
+  static constexpr auto none = static_cast<std::size_t>(-1);
+  mapped_image old_image, new_image;
+  if (old_image.open(old_path, mapped_image::access::sequential) || new_image.open(new_path, mapped_image::access::sequential)) {
+    return -1;
+  }
+  file_layout before, after;
+  diff_layout_of(old_image.data(), old_image.size(), before);
+  diff_layout_of(new_image.data(), new_image.size(), after);
+
+  // heads[name] is the next unpaired entry of that name, next[] the one after it
+  auto pair_by_name = [](auto&& names, std::size_t count, auto&& lookup) {
+    std::unordered_map<std::string_view, std::size_t> heads;
+    std::vector<std::size_t> next(count, none);
+    for (auto i = count; i--;) {
+      if (auto [iter, inserted] = heads.try_emplace(names(i), i); !inserted) {
+        next[i] = iter->second;
+        iter->second = i;
+      }
+    }
+    lookup([&heads, &next](std::string_view name) {
+      auto iter = heads.find(name);
+      if (iter == heads.end() || iter->second == none) {
+        return none;
+      }
+      auto i = iter->second;
+      iter->second = next[i];
+      return i;
+    });
+  };
+
+  struct region_pair {
+    std::size_t before;
+    std::size_t after;
+    std::vector<bindiff::range> ranges;
+    std::uint64_t bytes = 0;
+  };
+  std::vector<region_pair> pairs;
+  std::vector<std::size_t> pair_of_old(before.regions.size(), none), pair_of_new(after.regions.size(), none);
+  pair_by_name([&](std::size_t i) { return std::string_view{before.regions[i].name}; }, before.regions.size(), [&](auto take) {
+    for (std::size_t j = 0; j < after.regions.size(); ++j) {
+      auto i = take(after.regions[j].name);
+      pair_of_new[j] = pairs.size();
+      if (i != none) {
+        pair_of_old[i] = pairs.size();
+      }
+      pairs.push_back({i, j, {}});
+    }
+  });
+  for (std::size_t i = 0; i < before.regions.size(); ++i) {
+    if (pair_of_old[i] == none) {
+      pair_of_old[i] = pairs.size();
+      pairs.push_back({i, none, {}});
+    }
+  }
+
+  auto compare = [&](std::size_t k) {
+    auto& p = pairs[k];
+    if (p.before == none || p.after == none) {
+      p.bytes = (p.before == none) ? after.regions[p.after].size : before.regions[p.before].size;
+      return;
+    }
+    const auto& a = before.regions[p.before];
+    const auto& b = after.regions[p.after];
+    p.bytes = bindiff::diff(old_image.data() + a.offset, a.size, new_image.data() + b.offset, b.size, p.ranges);
+  };
+  parallel_for(pairs.size(), jobs, compare);
+  auto changed = [&pairs](std::size_t k) { return pairs[k].before == none || pairs[k].after == none || !pairs[k].ranges.empty(); };
+
+  // only the symbols of changed regions are looked at; the others cannot differ
+  struct symbol_change {
+    std::string_view status;
+    const file_symbol* before;
+    const file_symbol* after;
+  };
+  std::vector<std::vector<symbol_change>> symbols(pairs.size());
+  std::vector<const file_symbol*> old_symbols;
+  for (const auto& symbol : before.symbols) {
+    if (changed(pair_of_old[symbol.region])) {
+      old_symbols.push_back(&symbol);
+    }
+  }
+  std::vector<char> paired(old_symbols.size(), 0);
+  pair_by_name([&](std::size_t i) { return old_symbols[i]->name; }, old_symbols.size(), [&](auto take) {
+    for (const auto& symbol : after.symbols) {
+      const auto k = pair_of_new[symbol.region];
+      if (!changed(k)) {
+        continue;
+      }
+      auto i = take(symbol.name);
+      if (i == none) {
+        symbols[k].push_back({"added", nullptr, &symbol});
+        continue;
+      }
+      paired[i] = 1;
+      const auto& old_symbol = *old_symbols[i];
+      if (old_symbol.size != symbol.size || bindiff::mismatch(old_image.data() + before.regions[old_symbol.region].offset + old_symbol.offset,
+                                                              new_image.data() + after.regions[symbol.region].offset + symbol.offset, symbol.size) != symbol.size) {
+        symbols[k].push_back({"changed", &old_symbol, &symbol});
+      }
+    }
+  });
+  for (std::size_t i = 0; i < old_symbols.size(); ++i) {
+    if (!paired[i]) {
+      symbols[pair_of_old[old_symbols[i]->region]].push_back({"removed", old_symbols[i], nullptr});
+    }
+  }
+
+  std::size_t sections = 0;
+  std::uint64_t bytes = 0;
+  for (std::size_t k = 0; k < pairs.size(); ++k) {
+    if (changed(k)) {
+      ++sections;
+      bytes += pairs[k].bytes;
+    }
+  }
+  out.diff_file(old_path, new_path, sections ? "changed" : "identical", sections, bytes);
+  for (std::size_t k = 0; k < pairs.size(); ++k) {
+    if (!changed(k)) {
+      continue;
+    }
+    const auto& p = pairs[k];
+    const file_region empty{};
+    const auto& a = (p.before == none) ? empty : before.regions[p.before];
+    const auto& b = (p.after == none) ? empty : after.regions[p.after];
+    const std::string_view name = (p.after == none) ? a.name : b.name;
+    out.diff_section(name, (p.before == none) ? "added" : (p.after == none) ? "removed" : "changed", a.offset, a.size, b.offset, b.size, p.bytes);
+    for (const auto& r : p.ranges) {
+      out.diff_range(name, r.old_offset, r.old_size, r.new_offset, r.new_size);
+    }
+    for (const auto& s : symbols[k]) {
+      out.diff_symbol(name, s.after ? s.after->name : s.before->name, s.status, s.before ? s.before->value : 0, s.before ? s.before->size : 0,
+                      s.after ? s.after->value : 0, s.after ? s.after->size : 0);
+    }
+  }
+  return sections ? 2 : 0;
+}
+
+// the regular files under `root`, relative to it, in sorted order
+std::vector<std::string> relative_files(const std::string& root) {
+  std::vector<std::string> found;
+  std::error_code ec;
+  for (auto iter = std::filesystem::recursive_directory_iterator{root, std::filesystem::directory_options::skip_permission_denied, ec}; !ec && iter != std::filesystem::recursive_directory_iterator{}; iter.increment(ec)) {
+    if (iter->is_regular_file(ec)) {
+      found.push_back(iter->path().lexically_relative(root).string());
+    }
+  }
+  std::sort(found.begin(), found.end());
+  return found;
+}
+
+// -D: the second path against the first; with -r and two directories, every file under them paired by its path
+// relative to each, those that only one side has reported as added or removed. 2 when anything differs
+int diff_paths(output_sink& out, const options& opts) {
+  dump_writer writer{out, opts.format};
+  const auto& old_root = opts.paths[0];
+  const auto& new_root = opts.paths[1];
+  std::vector<std::pair<std::string, std::string>> files;
+  std::error_code ec;
+  if (opts.recursive && std::filesystem::is_directory(old_root, ec) && std::filesystem::is_directory(new_root, ec)) {
+    auto before = relative_files(old_root), after = relative_files(new_root);
+    for (std::size_t i = 0, j = 0; i < before.size() || j < after.size();) {
+      if (j == after.size() || (i < before.size() && before[i] < after[j])) {
+        files.emplace_back((std::filesystem::path{old_root} / before[i++]).string(), std::string{});
+      } else if (i == before.size() || after[j] < before[i]) {
+        files.emplace_back(std::string{}, (std::filesystem::path{new_root} / after[j++]).string());
+      } else {
+        files.emplace_back((std::filesystem::path{old_root} / before[i++]).string(), (std::filesystem::path{new_root} / after[j++]).string());
+      }
+    }
+  } else {
+    files.emplace_back(old_root, new_root);
+  }
+
+  int result = 0;
+  for (const auto& [old_path, new_path] : files) {
+    if (old_path.empty() || new_path.empty()) {
+      writer.diff_file(old_path, new_path, old_path.empty() ? "added" : "removed", 0, 0);
+      result = 2;
+    } else if (auto status = diff_images(writer, old_path.c_str(), new_path.c_str(), opts.jobs); status < 0) {
+      std::fprintf(stderr, "cannot compare %s with %s\n", old_path.c_str(), new_path.c_str());
+      result = std::max(result, 1);
+    } else {
+      result = std::max(result, status);
+    }
+  }
+  return result;
+}
+
+// everything that changes the rendered text of a file, so such runs never share cache records; -H only matters to
+// -L, whose mapped and copied byte counts depend on whether the whole file was mapped
+std::uint64_t cache_variant(const options& opts) {
+  auto variant = static_cast<std::uint64_t>(BINLAB_VERSION_MAJOR) << 48 | static_cast<std::uint64_t>(BINLAB_VERSION_MINOR) << 32 |
+                 static_cast<std::uint64_t>(opts.loaded && opts.headers_only) << 11 | static_cast<std::uint64_t>(opts.loaded) << 10 | static_cast<std::uint64_t>(opts.relocation_pages) << 9 |
+                 static_cast<std::uint64_t>(opts.symbols) << 8 | static_cast<std::uint64_t>(opts.format);
+  return variant ^ lookup_variant(opts);
+}
+
 int main(int argc, char* argv[]) {
+  output_sink out;
   if (argc < 2) {
-    std::printf("%s ver: %d.%d\n", argv[0], BINLAB_VERSION_MAJOR, BINLAB_VERSION_MINOR);
+    out.print("%s ver: %d.%d\n", argv[0], BINLAB_VERSION_MAJOR, BINLAB_VERSION_MINOR);
     return 0;
   }
 
-  std::ifstream is{argv[1], std::ios::binary | std::ios::ate};
-  if (is) {
-    std::printf("dump %s\n", argv[1]);
-    const auto& count = is.tellg();
-    if (count) {
-      std::vector<char> buff(count);
-      if (is.seekg(0, std::ios::beg).read(&buff[0], count)) {
-        dump_pe64(&buff[0]);
-        dump_pe32(&buff[0]);
-        dump_elf64le(&buff[0]);
-      }
-    }
+  options opts;
+  if (parse_options(argc, argv, opts) || (opts.diff && opts.paths.size() != 2) ||
+      (opts.output && (!opts.rebase || opts.recursive || opts.paths.size() != 1))) {
+    return usage(argv[0]);
+  }
+  if (opts.diff) {
+    dump_writer{out, opts.format}.begin_stream();
+    return diff_paths(out, opts);
+  }
+
+  result_cache cache;
+  if (opts.cache && cache.open(opts.cache, cache_variant(opts), opts.cache_verify)) {
+    std::fprintf(stderr, "%s: cannot use cache directory %s\n", argv[0], opts.cache);
+    return 1;
+  }
+
+  auto files = collect_files(opts);
+  dump_writer{out, opts.format}.begin_stream();
+  if (opts.resolve) {
+    return resolve_batch(out, files, opts);
+  }
+  if (files.size() == 1) {
+    dump_file(out, files[0].c_str(), opts, cache);
+  } else if (files.size() > 1) {
+    dump_batch(out, files, opts, cache);
   }
   return 0;
 }
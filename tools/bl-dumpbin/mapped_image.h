@@ -0,0 +1,167 @@
+// mapped_image.h
+
+#ifndef BINLAB_MAPPED_IMAGE_H_
+#define BINLAB_MAPPED_IMAGE_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#include "binlab/Config.h"
+
+#if defined(unix) || defined(__unix__) || defined(__unix)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // !unix
+
+// read-only view of a whole image; mmap'd when the file is mappable, otherwise read into a buffer (pipes, ttys, ...)
+class mapped_image {
+ public:
+  enum class access { normal, sequential, random };
+
+  mapped_image() = default;
+  mapped_image(const mapped_image&) = delete;
+  mapped_image& operator=(const mapped_image&) = delete;
+  mapped_image(mapped_image&& other) noexcept { swap(other); }
+  mapped_image& operator=(mapped_image&& other) noexcept {
+    mapped_image{std::move(other)}.swap(*this);
+    return *this;
+  }
+  ~mapped_image() { close(); }
+
+  int open(const char* path, access hint = access::random) {
+    close();
+#if defined(unix) || defined(__unix__) || defined(__unix)
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      return -1;
+    }
+
+    int result = 0;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+      if (st.st_size) {
+        auto addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+          data_ = static_cast<const char*>(addr);
+          size_ = st.st_size;
+          mapped_ = true;
+          advise(0, size_, hint);
+        } else {
+          result = read_all(fd);
+        }
+      }
+    } else {
+      result = read_all(fd);
+    }
+    ::close(fd);
+    return result;
+#else
+    std::ifstream is{path, std::ios::binary | std::ios::ate};
+    if (!is) {
+      return -1;
+    }
+    const auto& count = is.tellg();
+    if (count > 0) {
+      buffer_.resize(count);
+      if (!is.seekg(0, std::ios::beg).read(&buffer_[0], count)) {
+        buffer_.clear();
+        return -1;
+      }
+      data_ = buffer_.data();
+      size_ = buffer_.size();
+    }
+    return 0;
+#endif  // !unix
+  }
+
+  void close() {
+#if defined(unix) || defined(__unix__) || defined(__unix)
+    if (mapped_) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+#endif  // !unix
+    std::vector<char>{}.swap(buffer_);
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+  }
+
+  // page-cache hint for a range: sequential for full scans, random for header/directory chasing
+  void advise(std::size_t off, std::size_t len, access hint) const {
+#if defined(unix) || defined(__unix__) || defined(__unix)
+    if (!mapped_ || off >= size_) {
+      return;
+    }
+    auto advice = (hint == access::sequential) ? MADV_SEQUENTIAL : (hint == access::random) ? MADV_RANDOM : MADV_NORMAL;
+    const std::size_t page = ::sysconf(_SC_PAGESIZE);
+    const std::size_t first = off & ~(page - 1);
+    const std::size_t last = std::min(off + len, size_);
+    ::madvise(const_cast<char*>(data_ + first), last - first, advice);
+#endif  // !unix
+  }
+
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool mapped() const { return mapped_; }
+  bool empty() const { return !size_; }
+
+  // makes the view writable without touching the file: a mapping turns copy-on-write (only the pages written
+  // are copied), a read buffer already is private; nullptr if the protection cannot be changed
+  char* copy_on_write() {
+#if defined(unix) || defined(__unix__) || defined(__unix)
+    if (mapped_ && ::mprotect(const_cast<char*>(data_), size_, PROT_READ | PROT_WRITE)) {
+      return nullptr;
+    }
+#endif  // !unix
+    return const_cast<char*>(data_);
+  }
+
+  void swap(mapped_image& other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(mapped_, other.mapped_);
+    buffer_.swap(other.buffer_);
+  }
+
+ private:
+#if defined(unix) || defined(__unix__) || defined(__unix)
+  int read_all(int fd) {
+    constexpr std::size_t chunk = 1 << 20;
+    std::size_t count = 0;
+    for (;;) {
+      buffer_.resize(count + chunk);
+      auto n = ::read(fd, &buffer_[count], chunk);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n < 0) {
+        buffer_.clear();
+        return -1;
+      }
+      if (!n) {
+        break;
+      }
+      count += n;
+    }
+    buffer_.resize(count);
+    buffer_.shrink_to_fit();
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return 0;
+  }
+#endif  // !unix
+
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+  bool mapped_ = false;
+  std::vector<char> buffer_;
+};
+
+#endif  // BINLAB_MAPPED_IMAGE_H_
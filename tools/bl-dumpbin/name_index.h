@@ -0,0 +1,69 @@
+// name_index.h
+
+#ifndef BINLAB_NAME_INDEX_H_
+#define BINLAB_NAME_INDEX_H_
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "binlab/Config.h"
+
+// open-addressing hash table from names to positions in the caller's own table (FNV-1a, linear probing, at most
+// half full); only the positions and hashes are kept, so each candidate is confirmed against the caller's name
+class name_index {
+ public:
+  static constexpr std::size_t npos = ~std::size_t{0};
+
+  static std::uint32_t hash(std::string_view name) {
+    std::uint32_t h = 2166136261u;
+    for (auto c : name) {
+      h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return h;
+  }
+
+  // an empty table with room for `count` names
+  void reset(std::size_t count) {
+    slots_.assign(std::bit_ceil(2 * count + 2), 0);
+    hashes_.assign(slots_.size(), 0);
+  }
+
+  bool empty() const { return slots_.empty(); }
+
+  // at most the `count` names reset() made room for
+  void insert(std::string_view name, std::size_t position) {
+    const auto h = hash(name);
+    const auto mask = slots_.size() - 1;
+    auto s = h & mask;
+    while (slots_[s]) {
+      s = (s + 1) & mask;
+    }
+    slots_[s] = static_cast<std::uint32_t>(position + 1);
+    hashes_[s] = h;
+  }
+
+  // the first position inserted under `name` for which match(position) holds, or npos
+  template <typename Match>
+  std::size_t find(std::string_view name, Match match) const {
+    if (slots_.empty()) {
+      return npos;
+    }
+    const auto h = hash(name);
+    const auto mask = slots_.size() - 1;
+    for (auto s = h & mask; slots_[s]; s = (s + 1) & mask) {
+      if (hashes_[s] == h && match(std::size_t{slots_[s] - 1})) {
+        return slots_[s] - 1;
+      }
+    }
+    return npos;
+  }
+
+ private:
+  std::vector<std::uint32_t> slots_;  // position + 1, 0 when empty
+  std::vector<std::uint32_t> hashes_;
+};
+
+#endif  // BINLAB_NAME_INDEX_H_
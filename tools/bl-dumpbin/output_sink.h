@@ -0,0 +1,224 @@
+// output_sink.h
+
+#ifndef BINLAB_OUTPUT_SINK_H_
+#define BINLAB_OUTPUT_SINK_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "binlab/Config.h"
+
+#if defined(unix) || defined(__unix__) || defined(__unix)
+#include <sys/uio.h>
+#include <unistd.h>
+#endif  // !unix
+
+#if defined(__GNUC__)
+#define BINLAB_PRINTF_FORMAT(fmt, args) __attribute__((format(printf, fmt, args)))
+#else
+#define BINLAB_PRINTF_FORMAT(fmt, args)
+#endif  // !__GNUC__
+
+// large reusable output buffer; formats in place and hands whole buffers (plus big spans) to writev,
+// or appends them to an in-memory target when one is attached
+class output_sink {
+ public:
+  static constexpr std::size_t default_capacity = 1 << 18;
+
+  explicit output_sink(std::FILE* stream = stdout, std::size_t capacity = default_capacity)
+      : stream_{stream}, data_{new char[capacity]}, capacity_{capacity} {}
+  explicit output_sink(std::string* target, std::size_t capacity = default_capacity)
+      : stream_{nullptr}, target_{target}, data_{new char[capacity]}, capacity_{capacity} {}
+  output_sink(const output_sink&) = delete;
+  output_sink& operator=(const output_sink&) = delete;
+  ~output_sink() { flush(); }
+
+  // raw space for kernels that format straight into the buffer; at most capacity() bytes
+  char* reserve(std::size_t count) {
+    if (capacity_ - size_ < count) {
+      flush();
+    }
+    return &data_[size_];
+  }
+  void commit(std::size_t count) { size_ += count; }
+
+  void write(const char* data, std::size_t count) {
+    if (count <= capacity_ - size_) {
+      std::memcpy(&data_[size_], data, count);
+      size_ += count;
+    } else if (count < capacity_ / 2) {
+      flush();
+      std::memcpy(&data_[0], data, count);
+      size_ = count;
+    } else {
+      flush(data, count);
+    }
+  }
+  void write(std::string_view str) { write(str.data(), str.size()); }
+
+  void put(char c) {
+    if (size_ == capacity_) {
+      flush();
+    }
+    data_[size_++] = c;
+  }
+
+  void pad(std::size_t count, char c = ' ') {
+    while (count) {
+      auto n = std::min(count, capacity_);
+      std::memset(reserve(n), c, n);
+      commit(n);
+      count -= n;
+    }
+  }
+
+  // lower-case hex, zero-padded to at least `digits`; returns the number of characters written
+  template <typename T>
+  std::size_t hex(T value, std::size_t digits = 1) {
+    static constexpr char xdigits[] = "0123456789abcdef";
+    using U = std::make_unsigned_t<T>;
+    auto u = static_cast<U>(value);
+
+    char buff[2 * sizeof(U)];
+    auto last = buff + sizeof(buff), first = last;
+    do {
+      *--first = xdigits[u & 0xf];
+      u >>= 4;
+    } while (u);
+    while (static_cast<std::size_t>(last - first) < digits && first != buff) {
+      *--first = '0';
+    }
+    write(first, last - first);
+    return last - first;
+  }
+
+  template <typename T>
+  std::size_t dec(T value) {
+    char buff[24];
+    auto last = buff + sizeof(buff), first = last;
+    bool negative = value < 0;
+    auto u = negative ? 0 - static_cast<std::make_unsigned_t<T>>(value) : static_cast<std::make_unsigned_t<T>>(value);
+    do {
+      *--first = static_cast<char>('0' + u % 10);
+      u /= 10;
+    } while (u);
+    if (negative) {
+      *--first = '-';
+    }
+    write(first, last - first);
+    return last - first;
+  }
+
+  // printf-compatible slow path, formatted directly into the buffer
+  int print(const char* fmt, ...) BINLAB_PRINTF_FORMAT(2, 3) {
+    va_list args;
+    va_start(args, fmt);
+    auto count = vprint(fmt, args);
+    va_end(args);
+    return count;
+  }
+
+  int vprint(const char* fmt, va_list args) {
+    va_list again;
+    va_copy(again, args);
+    const auto room = capacity_ - size_;
+    auto count = std::vsnprintf(&data_[size_], room, fmt, args);
+    if (count >= 0 && static_cast<std::size_t>(count) >= room) {
+      flush();
+      if (static_cast<std::size_t>(count) < capacity_) {
+        std::vsnprintf(&data_[0], capacity_, fmt, again);
+      } else {
+        std::unique_ptr<char[]> large{new char[count + 1]};
+        std::vsnprintf(large.get(), count + 1, fmt, again);
+        flush(large.get(), count);
+        va_end(again);
+        return count;
+      }
+    }
+    va_end(again);
+    if (count > 0) {
+      size_ += count;
+    }
+    return count;
+  }
+
+  int flush() { return flush(nullptr, 0); }
+
+  std::size_t capacity() const { return capacity_; }
+  std::size_t size() const { return size_; }
+  std::FILE* stream() const { return stream_; }
+
+  std::string* target() const { return target_; }
+
+  // flushes into the current target, then redirects all further output to `target`
+  void attach(std::string* target) {
+    flush();
+    target_ = target;
+  }
+
+ private:
+  // buffered bytes followed by an optional caller span, in one gathered write
+  int flush(const char* extra, std::size_t count) {
+    if (!size_ && !count) {
+      return 0;
+    }
+    if (target_) {
+      target_->append(data_.get(), size_).append(extra, count);
+      size_ = 0;
+      return 0;
+    }
+    if (!stream_) {
+      // an in-memory sink with its target detached has nowhere to write
+      size_ = 0;
+      return -1;
+    }
+#if defined(unix) || defined(__unix__) || defined(__unix)
+    std::fflush(stream_);
+    const int fd = ::fileno(stream_);
+    iovec iov[2] = {{data_.get(), size_}, {const_cast<char*>(extra), count}};
+    iovec* first = iov;
+    int n = count ? 2 : 1;
+    while (n) {
+      auto written = ::writev(fd, first, n);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        size_ = 0;
+        return -1;
+      }
+      for (; n && static_cast<std::size_t>(written) >= first->iov_len; --n, ++first) {
+        written -= first->iov_len;
+      }
+      if (n) {
+        first->iov_base = static_cast<char*>(first->iov_base) + written;
+        first->iov_len -= written;
+      }
+    }
+#else
+    if (std::fwrite(data_.get(), 1, size_, stream_) != size_ || (count && std::fwrite(extra, 1, count, stream_) != count)) {
+      size_ = 0;
+      return -1;
+    }
+    std::fflush(stream_);
+#endif  // !unix
+    size_ = 0;
+    return 0;
+  }
+
+  std::FILE* stream_;
+  std::string* target_ = nullptr;
+  std::unique_ptr<char[]> data_;
+  std::size_t capacity_;
+  std::size_t size_ = 0;
+};
+
+#endif  // BINLAB_OUTPUT_SINK_H_
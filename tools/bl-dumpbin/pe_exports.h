@@ -0,0 +1,215 @@
+// pe_exports.h
+
+#ifndef BINLAB_PE_EXPORTS_H_
+#define BINLAB_PE_EXPORTS_H_
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/COFF.h"
+#include "address_mode_policy.h"
+#include "name_index.h"
+
+struct pe_export {
+  std::uint32_t ordinal = 0;    // biased by the directory's Base, as imports name it
+  std::uint32_t rva = 0;
+  std::string_view name;        // empty for exports only reachable by ordinal
+  std::string_view forwarder;   // "MODULE.Name" or "MODULE.#123" when the export is forwarded, else empty
+};
+
+// splits "MODULE.Name" or "MODULE.#123" at its first dot; false when there is none
+inline bool split_forwarder(std::string_view forwarder, std::string_view& module, std::string_view& symbol) {
+  auto dot = forwarder.find('.');
+  if (dot == std::string_view::npos) {
+    return false;
+  }
+  module = forwarder.substr(0, dot);
+  symbol = forwarder.substr(dot + 1);
+  return true;
+}
+
+// resolves a module's exports the way the loader does: names by binary search over the lexically sorted
+// AddressOfNames (or through the hint first), ordinals by direct index, forwarders by the RVA landing inside
+// the export directory; build_index() adds a hash index for modules queried over and over
+class pe_export_table {
+ public:
+  pe_export_table() = default;
+
+  // `size` is the file's; each table is cut to the entries that lie in it, and -1 unless the directory and at least
+  // one function slot do
+  int open(const char* base, std::size_t size, const rva_index& index, const binlab::COFF::IMAGE_DATA_DIRECTORY& directory) {
+    *this = {};
+    if (!directory.VirtualAddress) {
+      return -1;
+    }
+    auto exports = rva_cast<binlab::COFF::IMAGE_EXPORT_DIRECTORY>(base, index, directory.VirtualAddress);
+    if (!exports) {
+      return -1;
+    }
+    // how many entries of `width` bytes the array at `rva` has in the file, its offset in `offset`
+    auto fit = [&index, size](std::size_t rva, std::size_t width, std::size_t& offset) -> std::size_t {
+      const auto n = rva_mapped(index, rva, offset);
+      return (n && offset < size) ? std::min(n, size - offset) / width : 0;
+    };
+    std::size_t functions = 0, names = 0, ordinals = 0;
+    function_count_ = std::min<std::size_t>(exports->NumberOfFunctions, fit(exports->AddressOfFunctions, sizeof(std::uint32_t), functions));
+    if (!function_count_) {
+      return -1;
+    }
+    functions_ = reinterpret_cast<const std::uint32_t*>(base + functions);
+    name_count_ = std::min<std::size_t>({exports->NumberOfNames, fit(exports->AddressOfNames, sizeof(std::uint32_t), names),
+                                         fit(exports->AddressOfNameOrdinals, sizeof(std::uint16_t), ordinals)});
+    names_ = reinterpret_cast<const std::uint32_t*>(base + names);
+    ordinals_ = reinterpret_cast<const std::uint16_t*>(base + ordinals);
+    base_ = base;
+    index_ = &index;
+    module_ = rva_string(base, index, exports->Name);
+    ordinal_base_ = exports->Base;
+    first_ = directory.VirtualAddress;
+    last_ = directory.VirtualAddress + directory.Size;
+    return 0;
+  }
+
+  bool empty() const { return !functions_; }
+  std::string_view module() const { return module_; }
+  std::uint32_t ordinal_base() const { return ordinal_base_; }
+  std::size_t size() const { return function_count_; }
+  std::size_t name_count() const { return name_count_; }
+
+  // `ordinal` is biased by Base, as in an import by ordinal
+  bool by_ordinal(std::uint32_t ordinal, pe_export& result) const {
+    if (ordinal < ordinal_base_ || ordinal - ordinal_base_ >= function_count_) {
+      return false;
+    }
+    return slot(ordinal - ordinal_base_, {}, result);
+  }
+
+  bool by_name(std::string_view name, pe_export& result) const {
+    auto i = find_name(name);
+    return i < name_count_ && slot(ordinals_[i], name, result);
+  }
+
+  // the loader's fast path: try AddressOfNames[hint] before searching
+  bool by_hint(std::uint16_t hint, std::string_view name, pe_export& result) const {
+    if (hint < name_count_ && name_at(hint) == name) {
+      return slot(ordinals_[hint], name, result);
+    }
+    return by_name(name, result);
+  }
+
+  // "#123" by (biased) ordinal, anything else by name
+  bool find(std::string_view name, pe_export& result) const {
+    std::uint32_t ordinal = 0;
+    if (name.size() > 1 && name[0] == '#') {
+      auto [ptr, ec] = std::from_chars(name.data() + 1, name.data() + name.size(), ordinal);
+      if (ec == std::errc{} && ptr == name.data() + name.size()) {
+        return by_ordinal(ordinal, result);
+      }
+    }
+    return by_name(name, result);
+  }
+
+  // find() that follows forwarders back into this module, at most `max_forwards` of them; `result` is left at a
+  // forwarder into another module (or at the last hop), which the caller has to resolve elsewhere
+  bool find_forwarded(std::string_view name, pe_export& result, std::size_t max_forwards = 8) const {
+    if (!find(name, result)) {
+      return false;
+    }
+    std::string_view module, symbol;
+    for (std::size_t hop = 0; hop < max_forwards && split_forwarder(result.forwarder, module, symbol) && is_self(module); ++hop) {
+      pe_export next;
+      if (!find(symbol, next)) {
+        break;
+      }
+      result = next;
+    }
+    return true;
+  }
+
+  // hash index over the names so repeated by_name queries cost one probe
+  void build_index() {
+    name_index_.reset(name_count_);
+    for (std::size_t i = 0; i < name_count_; ++i) {
+      name_index_.insert(name_at(i), i);
+    }
+  }
+
+  // every non-empty function slot in ordinal order, with its name when it has one
+  template <typename Fn>
+  void for_each(Fn fn) const {
+    std::vector<std::uint32_t> named(function_count_, 0);
+    for (std::size_t i = 0; i < name_count_; ++i) {
+      if (ordinals_[i] < function_count_ && !named[ordinals_[i]]) {
+        named[ordinals_[i]] = static_cast<std::uint32_t>(i + 1);
+      }
+    }
+    pe_export entry;
+    for (std::size_t i = 0; i < function_count_; ++i) {
+      if (slot(i, named[i] ? name_at(named[i] - 1) : std::string_view{}, entry)) {
+        fn(entry);
+      }
+    }
+  }
+
+ private:
+  std::string_view name_at(std::size_t i) const { return rva_string(base_, *index_, names_[i]); }
+
+  // whether a forwarder's module (no extension, any case) names this one
+  bool is_self(std::string_view module) const {
+    auto own = module_.substr(0, module_.rfind('.'));
+    return own.size() == module.size() && std::equal(own.begin(), own.end(), module.begin(), [](char lhs, char rhs) {
+      return std::tolower(static_cast<unsigned char>(lhs)) == std::tolower(static_cast<unsigned char>(rhs));
+    });
+  }
+
+  // position in AddressOfNames, or name_count_ when absent
+  std::size_t find_name(std::string_view name) const {
+    if (!name_index_.empty()) {
+      auto i = name_index_.find(name, [this, name](std::size_t i) { return name_at(i) == name; });
+      return (i == name_index::npos) ? name_count_ : i;
+    }
+    std::size_t first = 0, count = name_count_;
+    while (count) {
+      auto half = count / 2;
+      if (name_at(first + half) < name) {
+        first += half + 1;
+        count -= half + 1;
+      } else {
+        count = half;
+      }
+    }
+    return (first < name_count_ && name_at(first) == name) ? first : name_count_;
+  }
+
+  bool slot(std::size_t i, std::string_view name, pe_export& result) const {
+    if (i >= function_count_ || !functions_[i]) {
+      return false;
+    }
+    result.ordinal = static_cast<std::uint32_t>(ordinal_base_ + i);
+    result.rva = functions_[i];
+    result.name = name;
+    result.forwarder = (first_ <= result.rva && result.rva < last_) ? rva_string(base_, *index_, result.rva) : std::string_view{};
+    return true;
+  }
+
+  const char* base_ = nullptr;
+  const rva_index* index_ = nullptr;
+  const std::uint32_t* functions_ = nullptr;
+  const std::uint32_t* names_ = nullptr;
+  const std::uint16_t* ordinals_ = nullptr;
+  std::string_view module_;
+  std::uint32_t ordinal_base_ = 0;
+  std::size_t function_count_ = 0;
+  std::size_t name_count_ = 0;
+  std::uint32_t first_ = 0;  // export directory range, for forwarder detection
+  std::uint32_t last_ = 0;
+  name_index name_index_;
+};
+
+#endif  // BINLAB_PE_EXPORTS_H_
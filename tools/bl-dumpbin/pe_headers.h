@@ -0,0 +1,67 @@
+// pe_headers.h
+
+#ifndef BINLAB_PE_HEADERS_H_
+#define BINLAB_PE_HEADERS_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/COFF.h"
+#include "address_mode_policy.h"
+
+// the headers of a PE32 or PE32+ file that the directory walkers need: the section index that maps RVAs to file
+// offsets, the preferred load address and the data directories, plus the sizes the loader lays the image out by
+struct pe_headers {
+  rva_index index;
+  std::span<const binlab::COFF::IMAGE_SECTION_HEADER> sections;  // in file order
+  bool pe64 = false;
+  std::uint64_t image_base = 0;
+  std::uint32_t image_size = 0;    // SizeOfImage
+  std::uint32_t headers_size = 0;  // SizeOfHeaders
+  binlab::COFF::IMAGE_DATA_DIRECTORY directories[binlab::COFF::IMAGE_NUMBEROF_DIRECTORY_ENTRIES];
+};
+
+// -1 unless the `size` bytes at `buff` start with a DOS header whose e_lfanew leads to NT headers and a section
+// table that all lie inside them; the index never casts an RVA to an offset at or past `size`
+inline int open_pe_headers(const char* buff, std::size_t size, pe_headers& result) {
+  using namespace binlab::COFF;
+  auto& Dos = reinterpret_cast<const IMAGE_DOS_HEADER&>(buff[0]);
+  if (size < sizeof(IMAGE_DOS_HEADER) || Dos.e_magic != IMAGE_DOS_SIGNATURE || Dos.e_lfanew < 0 ||
+      static_cast<std::size_t>(Dos.e_lfanew) > size - std::min(size, sizeof(IMAGE_NT_HEADERS64))) {
+    return -1;
+  }
+  auto& Nt = reinterpret_cast<const IMAGE_NT_HEADERS64&>(buff[Dos.e_lfanew]);
+  if (Nt.Signature != IMAGE_NT_SIGNATURE) {
+    return -1;
+  }
+  if (Nt.OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC) {
+    result.pe64 = true;
+    result.image_base = Nt.OptionalHeader.ImageBase;
+    result.image_size = Nt.OptionalHeader.SizeOfImage;
+    result.headers_size = Nt.OptionalHeader.SizeOfHeaders;
+    std::memcpy(result.directories, Nt.OptionalHeader.DataDirectory, sizeof(result.directories));
+  } else if (Nt.OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC) {
+    auto& Nt32 = reinterpret_cast<const IMAGE_NT_HEADERS32&>(Nt);
+    result.pe64 = false;
+    result.image_base = Nt32.OptionalHeader.ImageBase;
+    result.image_size = Nt32.OptionalHeader.SizeOfImage;
+    result.headers_size = Nt32.OptionalHeader.SizeOfHeaders;
+    std::memcpy(result.directories, Nt32.OptionalHeader.DataDirectory, sizeof(result.directories));
+  } else {
+    return -1;
+  }
+  auto first = IMAGE_FIRST_SECTION(&Nt);
+  auto last = first + Nt.FileHeader.NumberOfSections;
+  if (static_cast<std::size_t>(reinterpret_cast<const char*>(last) - buff) > size) {
+    return -1;
+  }
+  result.sections = {first, last};
+  result.index.assign(first, last, size);
+  return 0;
+}
+
+#endif  // BINLAB_PE_HEADERS_H_
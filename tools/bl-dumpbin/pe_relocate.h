@@ -0,0 +1,298 @@
+// pe_relocate.h
+
+#ifndef BINLAB_PE_RELOCATE_H_
+#define BINLAB_PE_RELOCATE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/COFF.h"
+#include "cpu_dispatch.h"
+
+struct pe_fixup_stats {
+  std::size_t pages = 0;        // relocation blocks
+  std::size_t highlow = 0;
+  std::size_t dir64 = 0;
+  std::size_t other = 0;        // HIGH, LOW and HIGHADJ
+  std::size_t padding = 0;      // IMAGE_REL_BASED_ABSOLUTE
+  std::size_t unsupported = 0;  // machine-specific type, or a target outside the image
+};
+
+namespace rebase {
+
+static constexpr std::size_t page_size = 0x1000;
+
+// the leading DIR64 (or HIGHLOW) entries of a block whose page lies wholly inside the image; returns how many
+// were applied, stopping at the first entry of another type
+inline std::size_t dir64_run_scalar(char* page, const std::uint16_t* entries, std::size_t count, std::uint64_t delta) {
+  for (std::size_t i = 0; i < count; ++i) {
+    if (entries[i] >> 12 != binlab::COFF::IMAGE_REL_BASED_DIR64) {
+      return i;
+    }
+    std::uint64_t value;
+    std::memcpy(&value, page + (entries[i] & 0xfff), 8);
+    value += delta;
+    std::memcpy(page + (entries[i] & 0xfff), &value, 8);
+  }
+  return count;
+}
+
+inline std::size_t highlow_run_scalar(char* page, const std::uint16_t* entries, std::size_t count, std::uint64_t delta) {
+  for (std::size_t i = 0; i < count; ++i) {
+    if (entries[i] >> 12 != binlab::COFF::IMAGE_REL_BASED_HIGHLOW) {
+      return i;
+    }
+    std::uint32_t value;
+    std::memcpy(&value, page + (entries[i] & 0xfff), 4);
+    value += static_cast<std::uint32_t>(delta);
+    std::memcpy(page + (entries[i] & 0xfff), &value, 4);
+  }
+  return count;
+}
+
+#if defined(BINLAB_HAVE_AVX512)
+// dense pages: 8 (DIR64) or 16 (HIGHLOW) fixups per gather/add/scatter. Targets are only batched while each one
+// starts at least a full word past the previous, so no two lanes touch the same bytes and the result matches the
+// sequential loop; anything else (unsorted entries, overlaps, another type) is left to the scalar loop. A vector of
+// back-to-back slots (a pointer table) is a plain load/add/store instead
+BINLAB_TARGET_AVX512 inline std::size_t dir64_run_avx512(char* page, const std::uint16_t* entries, std::size_t count, std::uint64_t delta) {
+  const auto deltas = _mm512_set1_epi64(static_cast<long long>(delta));
+  const auto type = _mm512_set1_epi64(binlab::COFF::IMAGE_REL_BASED_DIR64);
+  auto previous = _mm512_set1_epi64(-8);
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    auto e = _mm512_cvtepu16_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(entries + i)));
+    auto offsets = _mm512_and_si512(e, _mm512_set1_epi64(0xfff));
+    auto gaps = _mm512_sub_epi64(offsets, _mm512_alignr_epi64(offsets, previous, 7));
+    if ((_mm512_cmpeq_epi64_mask(_mm512_srli_epi64(e, 12), type) & _mm512_cmpgt_epi64_mask(gaps, _mm512_set1_epi64(7))) != 0xff) {
+      break;
+    }
+    const auto first = entries[i] & 0xfff;
+    if (_mm512_cmpeq_epi64_mask(offsets, _mm512_add_epi64(_mm512_set1_epi64(first), _mm512_setr_epi64(0, 8, 16, 24, 32, 40, 48, 56))) == 0xff) {
+      auto p = page + first;
+      _mm512_storeu_si512(p, _mm512_add_epi64(_mm512_loadu_si512(p), deltas));
+    } else {
+      auto values = _mm512_i64gather_epi64(offsets, page, 1);
+      _mm512_i64scatter_epi64(page, offsets, _mm512_add_epi64(values, deltas), 1);
+    }
+    previous = offsets;
+  }
+  return i + dir64_run_scalar(page, entries + i, count - i, delta);
+}
+
+BINLAB_TARGET_AVX512 inline std::size_t highlow_run_avx512(char* page, const std::uint16_t* entries, std::size_t count, std::uint64_t delta) {
+  const auto deltas = _mm512_set1_epi32(static_cast<int>(delta));
+  const auto type = _mm512_set1_epi32(binlab::COFF::IMAGE_REL_BASED_HIGHLOW);
+  auto previous = _mm512_set1_epi32(-4);
+  std::size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    auto e = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(entries + i)));
+    auto offsets = _mm512_and_si512(e, _mm512_set1_epi32(0xfff));
+    auto gaps = _mm512_sub_epi32(offsets, _mm512_alignr_epi32(offsets, previous, 15));
+    if ((_mm512_cmpeq_epi32_mask(_mm512_srli_epi32(e, 12), type) & _mm512_cmpgt_epi32_mask(gaps, _mm512_set1_epi32(3))) != 0xffff) {
+      break;
+    }
+    const int first = entries[i] & 0xfff;
+    if (_mm512_cmpeq_epi32_mask(offsets, _mm512_add_epi32(_mm512_set1_epi32(first), _mm512_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40, 44, 48, 52, 56, 60))) == 0xffff) {
+      auto p = page + first;
+      _mm512_storeu_si512(p, _mm512_add_epi32(_mm512_loadu_si512(p), deltas));
+    } else {
+      auto values = _mm512_i32gather_epi32(offsets, page, 1);
+      _mm512_i32scatter_epi32(page, offsets, _mm512_add_epi32(values, deltas), 1);
+    }
+    previous = offsets;
+  }
+  return i + highlow_run_scalar(page, entries + i, count - i, delta);
+}
+#endif  // !BINLAB_HAVE_AVX512
+
+using run_type = std::size_t (*)(char*, const std::uint16_t*, std::size_t, std::uint64_t);
+
+inline run_type select_dir64_run() {
+#if defined(BINLAB_HAVE_AVX512)
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return dir64_run_avx512;
+  }
+#endif  // !BINLAB_HAVE_AVX512
+  return dir64_run_scalar;
+}
+
+inline run_type select_highlow_run() {
+#if defined(BINLAB_HAVE_AVX512)
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return highlow_run_avx512;
+  }
+#endif  // !BINLAB_HAVE_AVX512
+  return highlow_run_scalar;
+}
+
+inline std::size_t dir64_run(char* page, const std::uint16_t* entries, std::size_t count, std::uint64_t delta) {
+  static const auto kernel = select_dir64_run();
+  return kernel(page, entries, count, delta);
+}
+
+inline std::size_t highlow_run(char* page, const std::uint16_t* entries, std::size_t count, std::uint64_t delta) {
+  static const auto kernel = select_highlow_run();
+  return kernel(page, entries, count, delta);
+}
+
+}  // namespace rebase
+
+// the IMAGE_BASE_RELOCATION blocks of a base relocation directory, each a page RVA and its TypeOffset entries;
+// apply() rebases an image the way the loader does, count() is the report-only pass over the same blocks
+class pe_base_relocations {
+ public:
+  pe_base_relocations() = default;
+
+  // `data` is the directory's bytes: rva_cast'ed in a file, or image + VirtualAddress in a loaded image
+  int open(const char* data, std::size_t size) {
+    data_ = data;
+    size_ = data ? size : 0;
+    return data ? 0 : -1;
+  }
+
+  // fn(page RVA, entries, count) per block, in directory order; stops at the first malformed block
+  template <typename Fn>
+  void for_each_block(Fn fn) const {
+    for (std::size_t off = 0; size_ - off >= sizeof(binlab::COFF::IMAGE_BASE_RELOCATION);) {
+      binlab::COFF::IMAGE_BASE_RELOCATION block;
+      std::memcpy(&block, data_ + off, sizeof(block));
+      if (block.SizeOfBlock < sizeof(block) || block.SizeOfBlock > size_ - off) {
+        break;
+      }
+      fn(block.VirtualAddress, reinterpret_cast<const std::uint16_t*>(data_ + off + sizeof(block)), (block.SizeOfBlock - sizeof(block)) / 2);
+      off += block.SizeOfBlock;
+    }
+  }
+
+  // tallies one block's entries by type
+  static void tally(const std::uint16_t* entries, std::size_t count, pe_fixup_stats& stats) {
+    using namespace binlab::COFF;
+    ++stats.pages;
+    for (std::size_t i = 0; i < count; ++i) {
+      switch (entries[i] >> 12) {
+        case IMAGE_REL_BASED_ABSOLUTE: ++stats.padding; break;
+        case IMAGE_REL_BASED_HIGHLOW: ++stats.highlow; break;
+        case IMAGE_REL_BASED_DIR64: ++stats.dir64; break;
+        case IMAGE_REL_BASED_HIGHADJ: ++i; [[fallthrough]];
+        case IMAGE_REL_BASED_HIGH:
+        case IMAGE_REL_BASED_LOW: ++stats.other; break;
+        default: ++stats.unsupported; break;
+      }
+    }
+  }
+
+  pe_fixup_stats count() const {
+    pe_fixup_stats stats;
+    for_each_block([&stats](std::uint32_t, const std::uint16_t* entries, std::size_t count) { tally(entries, count, stats); });
+    return stats;
+  }
+
+  // adds `delta` (new base - ImageBase, modulo 2^64) to every fixup target. locate(rva, available) returns the
+  // bytes behind `rva` and how many follow contiguously, or nullptr, so the same pass serves a loaded image and a
+  // file layout (in place, e.g. in a copy-on-write mapping); pages that are wholly available take the batched path
+  template <typename Locate>
+  pe_fixup_stats apply(Locate locate, std::uint64_t delta) const {
+    pe_fixup_stats stats;
+    for_each_block([&](std::uint32_t page, const std::uint16_t* entries, std::size_t count) {
+      ++stats.pages;
+      std::size_t available = 0;
+      auto base = locate(page, available);
+      const bool whole = base && available >= rebase::page_size + 8;
+      for (std::size_t i = 0; i < count;) {
+        std::size_t n = 0;
+        if (whole && (n = rebase::dir64_run(base, entries + i, count - i, delta))) {
+          stats.dir64 += n;
+        } else if (whole && (n = rebase::highlow_run(base, entries + i, count - i, delta))) {
+          stats.highlow += n;
+        } else {
+          n = apply_entry(locate, page, entries + i, count - i, delta, stats);
+        }
+        i += n;
+      }
+    });
+    return stats;
+  }
+
+  // the loaded layout: RVAs index `image` directly
+  pe_fixup_stats apply(char* image, std::size_t size, std::uint64_t delta) const {
+    return apply([image, size](std::uint64_t rva, std::size_t& available) -> char* {
+      if (rva >= size) {
+        return nullptr;
+      }
+      available = size - rva;
+      return image + rva;
+    }, delta);
+  }
+
+ private:
+  // applies entries[0] and returns how many entries it used (HIGHADJ takes two)
+  template <typename Locate>
+  static std::size_t apply_entry(Locate& locate, std::uint32_t page, const std::uint16_t* entries, std::size_t count, std::uint64_t delta,
+                                 pe_fixup_stats& stats) {
+    using namespace binlab::COFF;
+    const auto type = entries[0] >> 12;
+    const std::size_t used = (type == IMAGE_REL_BASED_HIGHADJ) ? 2 : 1;
+    if (type == IMAGE_REL_BASED_ABSOLUTE) {
+      ++stats.padding;
+      return 1;
+    }
+    const std::size_t width = (type == IMAGE_REL_BASED_DIR64) ? 8 : (type == IMAGE_REL_BASED_HIGHLOW) ? 4 : 2;
+    std::size_t available = 0;
+    auto p = locate(std::uint64_t{page} + (entries[0] & 0xfff), available);
+    if (!p || available < width || used > count) {
+      ++stats.unsupported;
+      return std::min(used, count);
+    }
+    switch (type) {
+      case IMAGE_REL_BASED_DIR64: {
+        std::uint64_t value;
+        std::memcpy(&value, p, 8);
+        value += delta;
+        std::memcpy(p, &value, 8);
+        ++stats.dir64;
+        break;
+      }
+      case IMAGE_REL_BASED_HIGHLOW: {
+        std::uint32_t value;
+        std::memcpy(&value, p, 4);
+        value += static_cast<std::uint32_t>(delta);
+        std::memcpy(p, &value, 4);
+        ++stats.highlow;
+        break;
+      }
+      case IMAGE_REL_BASED_HIGH:
+      case IMAGE_REL_BASED_LOW: {
+        std::uint16_t value;
+        std::memcpy(&value, p, 2);
+        value += static_cast<std::uint16_t>(type == IMAGE_REL_BASED_HIGH ? delta >> 16 : delta);
+        std::memcpy(p, &value, 2);
+        ++stats.other;
+        break;
+      }
+      case IMAGE_REL_BASED_HIGHADJ: {
+        // the second entry is the low half of the 32-bit value, not a fixup
+        std::uint16_t high;
+        std::memcpy(&high, p, 2);
+        auto value = (std::uint32_t{high} << 16) + static_cast<std::int16_t>(entries[1]);
+        value += static_cast<std::uint32_t>(delta) + 0x8000;
+        high = static_cast<std::uint16_t>(value >> 16);
+        std::memcpy(p, &high, 2);
+        ++stats.other;
+        break;
+      }
+      default:
+        ++stats.unsupported;
+        break;
+    }
+    return used;
+  }
+
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+#endif  // BINLAB_PE_RELOCATE_H_
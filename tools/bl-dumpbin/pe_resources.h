@@ -0,0 +1,151 @@
+// pe_resources.h
+
+#ifndef BINLAB_PE_RESOURCES_H_
+#define BINLAB_PE_RESOURCES_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/COFF.h"
+#include "address_mode_policy.h"
+#include "utf16_transcode.h"
+
+// one level of a resource path: an id, or a name of `length` UTF-16LE units
+struct pe_resource_key {
+  std::uint32_t id = 0;
+  const char* name = nullptr;
+  std::size_t length = 0;
+
+  // the id in decimal, or the name as UTF-8
+  std::string str() const {
+    if (!name) {
+      return std::to_string(id);
+    }
+    std::string result(utf16::max_utf8_size(length), '\0');
+    result.resize(utf16::to_utf8(name, length, result.data()));
+    return result;
+  }
+};
+
+// a leaf of the tree: where its bytes are (an RVA) and the path that leads to it, type / name / language
+struct pe_resource {
+  pe_resource_key type, name, language;
+  std::uint32_t rva = 0;
+  std::uint32_t size = 0;
+  std::uint32_t code_page = 0;
+};
+
+// the resource directory of a PE32 or PE32+ file. Offsets in the tree are relative to the directory itself; every
+// directory, entry array, name and data entry is bounds-checked against the file, and each subdirectory is expanded
+// at most once, so a cycle (or a directory shared to fan the tree out) cannot make the walk run away
+class pe_resource_tree {
+ public:
+  static constexpr std::size_t max_depth = 32;
+
+  pe_resource_tree() = default;
+
+  // `directory` is the resource data directory of the optional header; -1 when it is empty or not in the file
+  int open(const char* base, std::size_t size, const rva_index& index, const binlab::COFF::IMAGE_DATA_DIRECTORY& directory) {
+    std::size_t off = 0;
+    if (!directory.VirtualAddress || !index.cast(directory.VirtualAddress, off) || off >= size) {
+      return -1;
+    }
+    root_ = base + off;
+    size_ = size - off;
+    return 0;
+  }
+
+  // fn(path, depth, data) for every entry in preorder, path[0, depth] being the keys from the root down to it and
+  // `data` its IMAGE_RESOURCE_DATA_ENTRY, or nullptr for a subdirectory. -1 when some part of the tree was skipped
+  // as malformed (out of bounds, cyclic or too deep); the rest is still walked
+  template <typename Fn>
+  int walk(Fn fn) const {
+    using namespace binlab::COFF;
+    struct frame {
+      std::size_t entries;  // offset of the entry array
+      std::size_t count;
+      std::size_t next;
+    };
+    int result = 0;
+    std::vector<frame> stack;
+    std::unordered_set<std::size_t> expanded;
+    pe_resource_key path[max_depth];
+
+    auto push = [&](std::size_t off) {
+      if (stack.size() == max_depth || off > size_ || size_ - off < sizeof(IMAGE_RESOURCE_DIRECTORY) ||
+          !expanded.insert(off).second) {
+        result = -1;
+        return;
+      }
+      IMAGE_RESOURCE_DIRECTORY directory;
+      std::memcpy(&directory, root_ + off, sizeof(directory));
+      const std::size_t entries = off + sizeof(directory);
+      std::size_t count = directory.NumberOfNamedEntries + directory.NumberOfIdEntries;
+      if (count > (size_ - entries) / sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY)) {
+        count = (size_ - entries) / sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY);
+        result = -1;
+      }
+      stack.push_back({entries, count, 0});
+    };
+
+    push(0);
+    while (!stack.empty()) {
+      auto& top = stack.back();
+      if (top.next == top.count) {
+        stack.pop_back();
+        continue;
+      }
+      const auto depth = stack.size() - 1;
+      IMAGE_RESOURCE_DIRECTORY_ENTRY entry;
+      std::memcpy(&entry, root_ + top.entries + top.next++ * sizeof(entry), sizeof(entry));
+
+      auto& key = path[depth];
+      key = {};
+      if (entry.NameIsString) {
+        if (entry.NameOffset > size_ - std::min<std::size_t>(size_, sizeof(WORD))) {
+          result = -1;
+          continue;
+        }
+        WORD length;
+        std::memcpy(&length, root_ + entry.NameOffset, sizeof(length));
+        key.name = root_ + entry.NameOffset + sizeof(length);
+        key.length = std::min<std::size_t>(length, (size_ - entry.NameOffset - sizeof(length)) / 2);
+      } else {
+        key.id = entry.Id;
+      }
+
+      if (entry.DataIsDirectory) {
+        fn(static_cast<const pe_resource_key*>(path), depth, static_cast<const IMAGE_RESOURCE_DATA_ENTRY*>(nullptr));
+        push(entry.OffsetToDirectory);
+      } else if (entry.OffsetToData <= size_ && size_ - entry.OffsetToData >= sizeof(IMAGE_RESOURCE_DATA_ENTRY)) {
+        fn(static_cast<const pe_resource_key*>(path), depth, reinterpret_cast<const IMAGE_RESOURCE_DATA_ENTRY*>(root_ + entry.OffsetToData));
+      } else {
+        result = -1;
+      }
+    }
+    return result;
+  }
+
+  // the leaves three levels down (type / name / language), the layout every resource compiler emits
+  int resources(std::vector<pe_resource>& result) const {
+    return walk([&result](const pe_resource_key* path, std::size_t depth, const binlab::COFF::IMAGE_RESOURCE_DATA_ENTRY* data) {
+      if (data && depth == 2) {
+        binlab::COFF::IMAGE_RESOURCE_DATA_ENTRY entry;
+        std::memcpy(&entry, data, sizeof(entry));
+        result.push_back({path[0], path[1], path[2], entry.OffsetToData, entry.Size, entry.CodePage});
+      }
+    });
+  }
+
+ private:
+  const char* root_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+#endif  // BINLAB_PE_RESOURCES_H_
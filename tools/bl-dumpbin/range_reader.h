@@ -0,0 +1,206 @@
+// range_reader.h
+
+#ifndef BINLAB_RANGE_READER_H_
+#define BINLAB_RANGE_READER_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "binlab/Config.h"
+
+#if defined(unix) || defined(__unix__) || defined(__unix)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif  // !unix
+
+// sparse view of a file: the whole size is reserved up front (unbacked, reads as zeros) and only the
+// requested byte ranges are pread in; queued requests are merged into as few reads as possible
+class range_reader {
+ public:
+  static constexpr std::size_t page = 4096;
+  static constexpr std::size_t max_gap = 4 * page;  // re-reading a small gap beats another round trip
+
+  range_reader() = default;
+  range_reader(const range_reader&) = delete;
+  range_reader& operator=(const range_reader&) = delete;
+  ~range_reader() { close(); }
+
+  int open(const char* path) {
+    close();
+#if defined(unix) || defined(__unix__) || defined(__unix)
+    fd_ = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd_ == -1) {
+      return -1;
+    }
+    struct stat st;
+    if (::fstat(fd_, &st) || !S_ISREG(st.st_mode)) {
+      close();
+      return -1;
+    }
+    size_ = st.st_size;
+    if (size_) {
+      auto addr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (addr == MAP_FAILED) {
+        close();
+        return -1;
+      }
+      data_ = static_cast<char*>(addr);
+    }
+    present_.assign((size_ + page - 1) / page, false);
+#else
+    std::ifstream is{path, std::ios::binary | std::ios::ate};
+    if (!is) {
+      return -1;
+    }
+    size_ = is.tellg();
+    buffer_.resize(size_);
+    if (size_ && !is.seekg(0, std::ios::beg).read(&buffer_[0], size_)) {
+      close();
+      return -1;
+    }
+    data_ = buffer_.data();
+    bytes_read_ = size_;
+    reads_ = 1;
+    present_.assign((size_ + page - 1) / page, true);
+#endif  // !unix
+    return 0;
+  }
+
+  void close() {
+#if defined(unix) || defined(__unix__) || defined(__unix)
+    if (data_) {
+      ::munmap(data_, size_);
+    }
+    if (fd_ != -1) {
+      ::close(fd_);
+    }
+    fd_ = -1;
+#else
+    std::vector<char>{}.swap(buffer_);
+#endif  // !unix
+    data_ = nullptr;
+    size_ = 0;
+    present_.clear();
+    queued_.clear();
+    bytes_read_ = reads_ = 0;
+  }
+
+  // queues [off, off + len) for the next fetch(); ranges past the end are clamped
+  void request(std::size_t off, std::size_t len) {
+    if (off >= size_ || !len) {
+      return;
+    }
+    len = std::min(len, size_ - off);
+    queued_.emplace_back(off / page, (off + len + page - 1) / page);
+  }
+
+  // reads every queued page that is not present yet, one pread per merged run
+  int fetch() {
+    std::sort(queued_.begin(), queued_.end());
+    int result = 0;
+    for (std::size_t i = 0; i < queued_.size();) {
+      auto [first, last] = queued_[i];
+      for (++i; i < queued_.size() && queued_[i].first <= last + max_gap / page; ++i) {
+        last = std::max(last, queued_[i].second);
+      }
+      while (first < last && present_[first]) {
+        ++first;
+      }
+      while (first < last && present_[last - 1]) {
+        --last;
+      }
+      if (first < last && read_pages(first, last)) {
+        result = -1;
+      }
+    }
+    queued_.clear();
+    return result;
+  }
+
+  // the range is present on return; nullptr if it lies outside the file or the read failed
+  const char* ensure(std::size_t off, std::size_t len) {
+    if (off > size_ || len > size_ - off) {
+      return nullptr;
+    }
+    request(off, len);
+    return fetch() ? nullptr : data_ + off;
+  }
+
+  // NUL-terminated strings at each offset, fetched together and grown until terminated (or EOF)
+  void ensure_strings(std::vector<std::size_t> offsets, std::size_t guess = 64) {
+    while (!offsets.empty()) {
+      for (auto off : offsets) {
+        request(off, guess);
+      }
+      fetch();
+      std::erase_if(offsets, [this, guess](std::size_t off) {
+        auto len = std::min(guess, (off < size_) ? size_ - off : 0);
+        return !len || std::memchr(data_ + off, 0, len) || len < guess;
+      });
+      guess *= 4;
+    }
+  }
+
+  bool present(std::size_t off, std::size_t len) const {
+    if (off > size_ || len > size_ - off) {
+      return false;
+    }
+    for (auto i = off / page; i < (off + len + page - 1) / page; ++i) {
+      if (!present_[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const char* data() const { return data_; }
+  // the view is a private anonymous mapping, so fetched pages may be patched in place
+  char* data() { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return !size_; }
+
+  std::size_t bytes_read() const { return bytes_read_; }
+  std::size_t reads() const { return reads_; }
+
+ private:
+  int read_pages(std::size_t first, std::size_t last) {
+#if defined(unix) || defined(__unix__) || defined(__unix)
+    const std::size_t begin = first * page, end = std::min(last * page, size_);
+    for (std::size_t off = begin; off < end;) {
+      auto n = ::pread(fd_, data_ + off, end - off, off);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return -1;
+      }
+      off += n;
+      bytes_read_ += n;
+      ++reads_;
+    }
+#endif  // !unix
+    std::fill(present_.begin() + first, present_.begin() + last, true);
+    return 0;
+  }
+
+  char* data_ = nullptr;
+  std::size_t size_ = 0;
+  int fd_ = -1;
+#if !(defined(unix) || defined(__unix__) || defined(__unix))
+  std::vector<char> buffer_;
+#endif  // !unix
+  std::vector<bool> present_;
+  std::vector<std::pair<std::size_t, std::size_t>> queued_;
+  std::size_t bytes_read_ = 0;
+  std::size_t reads_ = 0;
+};
+
+#endif  // BINLAB_RANGE_READER_H_
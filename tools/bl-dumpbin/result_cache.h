@@ -0,0 +1,190 @@
+// result_cache.h
+
+#ifndef BINLAB_RESULT_CACHE_H_
+#define BINLAB_RESULT_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+#include <sys/stat.h>
+
+#include "binlab/Config.h"
+#include "mapped_image.h"
+
+// 64-bit non-cryptographic content hash, four independent lanes so it runs at memory speed
+inline std::uint64_t hash_bytes(const void* data, std::size_t size, std::uint64_t seed = 0) {
+  constexpr std::uint64_t k0 = 0x9e3779b97f4a7c15, k1 = 0xbf58476d1ce4e5b9, k2 = 0x94d049bb133111eb;
+  auto rotl = [](std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+  auto mix = [](std::uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+  };
+
+  auto p = static_cast<const unsigned char*>(data);
+  std::uint64_t lane[4] = {seed ^ k0, seed + k1, seed ^ k2, seed - k0};
+  std::size_t n = size;
+  for (; n >= 32; n -= 32, p += 32) {
+    for (int i = 0; i < 4; ++i) {
+      std::uint64_t w;
+      std::memcpy(&w, p + 8 * i, sizeof(w));
+      lane[i] = rotl(lane[i] + w * k1, 31) * k0;
+    }
+  }
+  std::uint64_t h = rotl(lane[0], 1) + rotl(lane[1], 7) + rotl(lane[2], 12) + rotl(lane[3], 18);
+  for (; n >= 8; n -= 8, p += 8) {
+    std::uint64_t w;
+    std::memcpy(&w, p, sizeof(w));
+    h = rotl(h ^ (w * k1), 27) * k0 + k2;
+  }
+  for (; n; --n, ++p) {
+    h = rotl(h ^ (*p * k0), 11) * k1;
+  }
+  return mix(h ^ size);
+}
+
+// on-disk cache of rendered dump results, one small mmap-able record per (dev, inode, variant);
+// a record is valid while the file's mtime and size still match, and optionally its content hash
+class result_cache {
+ public:
+  struct key {
+    std::uint64_t dev = 0;
+    std::uint64_t ino = 0;
+    std::uint64_t mtime = 0;  // ns
+    std::uint64_t size = 0;
+  };
+
+  class entry {
+   public:
+    std::string_view payload() const {
+      auto& header = reinterpret_cast<const record&>(*view_.data());
+      return {view_.data() + sizeof(record), static_cast<std::size_t>(header.payload_size)};
+    }
+
+   private:
+    friend class result_cache;
+    mapped_image view_;
+  };
+
+  result_cache() = default;
+
+  // `variant` separates results rendered with different tool versions or output modes
+  int open(const char* dir, std::uint64_t variant, bool verify = false) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+      return -1;
+    }
+    dir_ = dir;
+    variant_ = variant;
+    verify_ = verify;
+    return 0;
+  }
+
+  bool enabled() const { return !dir_.empty(); }
+  bool verify() const { return verify_; }
+
+  static int stat(const char* path, key& k) {
+    struct stat st;
+    if (::stat(path, &st) || !S_ISREG(st.st_mode)) {
+      return -1;
+    }
+    k.dev = st.st_dev;
+    k.ino = st.st_ino;
+#if defined(unix) || defined(__unix__) || defined(__unix)
+    k.mtime = static_cast<std::uint64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+    k.mtime = static_cast<std::uint64_t>(st.st_mtime) * 1000000000;
+#endif  // !unix
+    k.size = st.st_size;
+    return 0;
+  }
+
+  // true when a record for `k` exists and is still valid; `content_hash` is only consulted in verify mode
+  bool lookup(const key& k, entry& e, std::uint64_t content_hash = 0) const {
+    if (!enabled() || e.view_.open(path_of(k).c_str(), mapped_image::access::sequential) || e.view_.size() < sizeof(record)) {
+      return false;
+    }
+    auto& header = reinterpret_cast<const record&>(*e.view_.data());
+    return !std::memcmp(header.magic, magic, sizeof(magic)) && header.variant == variant_ &&
+           header.dev == k.dev && header.ino == k.ino && header.mtime == k.mtime && header.size == k.size &&
+           header.payload_size == e.view_.size() - sizeof(record) &&
+           (!verify_ || (header.content_hash && header.content_hash == content_hash));
+  }
+
+  // writes the record to a private temporary and renames it into place, so readers never see a partial one
+  int store(const key& k, std::string_view payload, std::uint64_t content_hash = 0) const {
+    if (!enabled()) {
+      return -1;
+    }
+    auto path = path_of(k);
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    record header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.variant = variant_;
+    header.dev = k.dev;
+    header.ino = k.ino;
+    header.mtime = k.mtime;
+    header.size = k.size;
+    header.content_hash = content_hash;
+    header.payload_size = payload.size();
+
+    auto temp = path;
+    temp += ".tmp." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+#if defined(unix) || defined(__unix__) || defined(__unix)
+    temp += "." + std::to_string(::getpid());
+#endif  // !unix
+    {
+      std::ofstream os{temp, std::ios::binary | std::ios::trunc};
+      if (!os.write(reinterpret_cast<const char*>(&header), sizeof(header)).write(payload.data(), payload.size())) {
+        std::filesystem::remove(temp, ec);
+        return -1;
+      }
+    }
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+      std::filesystem::remove(temp, ec);
+      return -1;
+    }
+    return 0;
+  }
+
+ private:
+  static constexpr char magic[8] = {'B', 'L', 'C', 'A', 'C', 'H', 'E', '1'};
+
+  struct record {
+    char magic[8];
+    std::uint64_t variant;
+    std::uint64_t dev;
+    std::uint64_t ino;
+    std::uint64_t mtime;
+    std::uint64_t size;
+    std::uint64_t content_hash;  // 0 when the record was stored without verification
+    std::uint64_t payload_size;
+  };
+
+  // <dir>/<2 hex digits>/<14 hex digits>, so no directory grows past a few thousand records
+  std::filesystem::path path_of(const key& k) const {
+    std::uint64_t id[3] = {k.dev, k.ino, variant_};
+    auto h = hash_bytes(id, sizeof(id));
+    char name[24];
+    std::snprintf(name, sizeof(name), "%02x/%014llx", static_cast<unsigned>(h >> 56), static_cast<unsigned long long>(h & 0x00ffffffffffffff));
+    return std::filesystem::path{dir_} / name;
+  }
+
+  std::string dir_;
+  std::uint64_t variant_ = 0;
+  bool verify_ = false;
+};
+
+#endif  // BINLAB_RESULT_CACHE_H_
@@ -0,0 +1,685 @@
+//
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "binlab/BinaryFormat/COFF.h"
+#include "binlab/BinaryFormat/ELF.h"
+#include "byte_stats.h"
+#include "cpu_dispatch.h"
+#include "elf_relocate.h"
+#include "hexdump_kernel.h"
+#include "pe_relocate.h"
+#include "signature_scan.h"
+#include "string_scan.h"
+#include "utf16_transcode.h"
+
+using namespace binlab::COFF;
+
+// checks every vector kernel the cpu can run against its scalar version on generated inputs (-w and -c write and
+// check the PE fixture the CTest cases rebase, or with a defect named a damaged copy of it, and -e damages a copy of
+// an ELF file), and carries a section for the ELF cases to dump, scan and measure
+
+#if defined(__ELF__)
+struct elf_fixture {
+  char ascii[32];
+  char16_t wide[32];
+  unsigned char signature[8];
+};
+
+// 104 bytes: six full hex dump rows and a partial one
+[[gnu::used, gnu::section(".binlab_fixture")]] const elf_fixture fixture_section = {
+    "binlab fixture ascii run", u"binlab fixture wide run", {0xde, 0xad, 0xbe, 0xef, 0x90, 0x90, 0xc3, 0x00}};
+#endif  // !__ELF__
+
+namespace {
+
+std::mt19937_64 random_engine{0x62696e6c6162};
+std::size_t failures = 0;
+std::size_t checks = 0;
+
+std::size_t random_below(std::size_t n) {
+  return n ? static_cast<std::size_t>(random_engine() % n) : 0;
+}
+
+// random bytes, with runs of one value mixed in so the kernels' run and early-out paths are taken too
+std::vector<std::uint8_t> random_bytes(std::size_t size) {
+  std::vector<std::uint8_t> result(size);
+  for (std::size_t i = 0; i < size;) {
+    const auto n = std::min(size - i, 1 + random_below(150));
+    if (random_below(4)) {
+      for (std::size_t j = 0; j < n; ++j) {
+        result[i + j] = static_cast<std::uint8_t>(random_engine());
+      }
+    } else {
+      std::memset(&result[i], static_cast<int>(random_below(2) ? 0 : random_engine() & 0xff), n);
+    }
+    i += n;
+  }
+  return result;
+}
+
+void report(bool same, const char* kernel, const char* variant, std::size_t size) {
+  ++checks;
+  if (!same) {
+    std::fprintf(stderr, "%s_%s differs from %s_scalar for %zu bytes\n", kernel, variant, kernel, size);
+    ++failures;
+  }
+}
+
+[[maybe_unused]] bool have_avx2() {
+  return __builtin_cpu_supports("avx2");
+}
+
+[[maybe_unused]] bool have_avx512() {
+  return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+}
+
+[[maybe_unused]] bool have_avx512vbmi2() {
+  return have_avx512() && __builtin_cpu_supports("avx512vbmi2");
+}
+
+template <typename Kernel>
+struct variant {
+  const char* name;
+  Kernel kernel;
+};
+
+template <typename Kernel>
+void print_variants(const char* kernel, const std::vector<variant<Kernel>>& variants) {
+  std::printf("%s:", kernel);
+  for (const auto& v : variants) {
+    std::printf(" %s", v.name);
+  }
+  std::printf("%s\n", variants.empty() ? " (scalar only)" : "");
+}
+
+// hexdump::format_rows_* against format_row_scalar one row at a time
+void check_hexdump() {
+  std::vector<variant<hexdump::format_rows_type>> variants = {{"scalar", hexdump::format_rows_scalar}};
+#if defined(BINLAB_HAVE_SSE2)
+  variants.push_back({"sse2", hexdump::format_rows_sse2});
+#endif  // !BINLAB_HAVE_SSE2
+#if defined(BINLAB_HAVE_AVX2)
+  if (have_avx2()) {
+    variants.push_back({"avx2", hexdump::format_rows_avx2});
+  }
+#endif  // !BINLAB_HAVE_AVX2
+#if defined(BINLAB_HAVE_AVX512)
+  if (have_avx512()) {
+    variants.push_back({"avx512", hexdump::format_rows_avx512});
+  }
+#endif  // !BINLAB_HAVE_AVX512
+  print_variants("format_rows", variants);
+
+  for (std::size_t rows = 0; rows < 80; rows += 1 + rows / 8) {
+    auto data = random_bytes(rows * hexdump::block);
+    if (rows == 16) {
+      for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<std::uint8_t>(i);
+      }
+    }
+    std::vector<char> expected(rows * hexdump::row_width), actual(rows * hexdump::row_width);
+    for (std::size_t r = 0; r < rows; ++r) {
+      hexdump::format_row_scalar(&data[r * hexdump::block], hexdump::block, &expected[r * hexdump::row_width]);
+    }
+    for (const auto& v : variants) {
+      std::fill(actual.begin(), actual.end(), 0);
+      v.kernel(data.data(), rows, actual.data());
+      report(actual == expected, "format_rows", v.name, data.size());
+    }
+  }
+}
+
+// utf16::to_utf8_* against to_utf8_scalar, with every kind of unit and lone surrogates, from an odd address
+void check_utf16() {
+  std::vector<variant<utf16::to_utf8_type>> variants;
+#if defined(BINLAB_HAVE_SSE2)
+  variants.push_back({"sse2", utf16::to_utf8_sse2});
+#endif  // !BINLAB_HAVE_SSE2
+#if defined(BINLAB_HAVE_AVX512VBMI2)
+  if (have_avx512vbmi2()) {
+    variants.push_back({"avx512", utf16::to_utf8_avx512});
+  }
+#endif  // !BINLAB_HAVE_AVX512VBMI2
+  print_variants("to_utf8", variants);
+
+  for (std::size_t units = 0; units < 300; units += 1 + units / 16) {
+    for (std::size_t mix = 0; mix < 4; ++mix) {
+      std::vector<std::uint16_t> text;
+      while (text.size() < units) {
+        const auto kind = random_below(mix == 0 ? 1 : 20);
+        if (kind < 10 || mix == 1) {
+          text.push_back(static_cast<std::uint16_t>(random_below(0x80)));
+        } else if (kind < 13) {
+          text.push_back(static_cast<std::uint16_t>(0x80 + random_below(0x800 - 0x80)));
+        } else if (kind < 16) {
+          auto c = static_cast<std::uint16_t>(0x800 + random_below(0x10000 - 0x800));
+          text.push_back((c >= 0xd800 && c < 0xe000) ? 0xfffd : c);
+        } else if (kind < 18 && mix != 2) {
+          text.push_back(static_cast<std::uint16_t>(0xd800 + random_below(0x400)));
+          text.push_back(static_cast<std::uint16_t>(0xdc00 + random_below(0x400)));
+        } else if (mix != 2) {
+          text.push_back(static_cast<std::uint16_t>(0xd800 + random_below(0x800)));
+        }
+      }
+      text.resize(units);
+      std::vector<char> in(2 * units + 1);
+      for (std::size_t i = 0; i < units; ++i) {
+        in[1 + 2 * i] = static_cast<char>(text[i]);
+        in[2 + 2 * i] = static_cast<char>(text[i] >> 8);
+      }
+      std::vector<char> expected(utf16::max_utf8_size(units)), actual(utf16::max_utf8_size(units));
+      expected.resize(utf16::to_utf8_scalar(in.data() + 1, units, expected.data()));
+      for (const auto& v : variants) {
+        actual.assign(utf16::max_utf8_size(units), 0);
+        actual.resize(v.kernel(in.data() + 1, units, actual.data()));
+        report(actual == expected, "to_utf8", v.name, 2 * units);
+      }
+    }
+  }
+}
+
+// bytestats::count_* against count_scalar; the kernels spread the counts over different tables, so the sums are
+// compared
+void check_byte_stats() {
+  std::vector<variant<bytestats::count_type>> variants;
+#if defined(BINLAB_HAVE_AVX2)
+  if (have_avx2()) {
+    variants.push_back({"avx2", bytestats::count_avx2});
+  }
+#endif  // !BINLAB_HAVE_AVX2
+#if defined(BINLAB_HAVE_AVX512)
+  if (have_avx512()) {
+    variants.push_back({"avx512", bytestats::count_avx512});
+  }
+#endif  // !BINLAB_HAVE_AVX512
+  print_variants("count", variants);
+
+  auto sums = [](bytestats::count_type kernel, const std::uint8_t* p, std::size_t n) {
+    auto t = std::make_unique<bytestats::tables>();
+    std::memset(t.get(), 0, sizeof(*t));
+    kernel(p, n, *t);
+    bytestats::histogram result{};
+    for (std::size_t v = 0; v < 256; ++v) {
+      result[v] = t->runs[v];
+      for (std::size_t k = 0; k < bytestats::ways; ++k) {
+        result[v] += t->counts[v * bytestats::ways + k];
+      }
+    }
+    return result;
+  };
+  for (std::size_t size = 0; size < 5000; size += 1 + size / 4) {
+    const auto data = random_bytes(size + 7);
+    const auto skew = random_below(8);
+    const auto expected = sums(bytestats::count_scalar, data.data() + skew, size);
+    for (const auto& v : variants) {
+      report(sums(v.kernel, data.data() + skew, size) == expected, "count", v.name, size);
+    }
+  }
+}
+
+// sigscan::find_* against find_scalar. Past eight distinct high nibbles the nibble lookup may stop early at a
+// false candidate, which the scanner then rejects, so only a set with fewer must match exactly
+void check_signature_find() {
+  std::vector<variant<sigscan::find_type>> variants;
+#if defined(BINLAB_HAVE_AVX2)
+  if (have_avx2()) {
+    variants.push_back({"avx2", sigscan::find_avx2});
+  }
+#endif  // !BINLAB_HAVE_AVX2
+#if defined(BINLAB_HAVE_AVX512)
+  if (have_avx512()) {
+    variants.push_back({"avx512", sigscan::find_avx512});
+  }
+#endif  // !BINLAB_HAVE_AVX512
+  print_variants("find", variants);
+
+  for (std::size_t round = 0; round < 400; ++round) {
+    sigscan::byte_set set;
+    const auto members = 1 + random_below(round % 2 ? 6 : 40);
+    for (std::size_t i = 0; i < members; ++i) {
+      set.exact[random_engine() & 0xff] = true;
+    }
+    set.build();
+    std::size_t high_nibbles = 0;
+    for (std::size_t h = 0; h < 16; ++h) {
+      high_nibbles += set.high[h] != 0;
+    }
+
+    const auto size = random_below(600);
+    std::vector<std::uint8_t> data(size);
+    for (auto& c : data) {
+      do {
+        c = static_cast<std::uint8_t>(random_engine());
+      } while (set.exact[c]);
+    }
+    for (std::size_t hits = random_below(3); hits && size; --hits) {
+      std::uint8_t c;
+      do {
+        c = static_cast<std::uint8_t>(random_engine());
+      } while (!set.exact[c]);
+      data[random_below(size)] = c;
+    }
+    const auto first = random_below(std::min<std::size_t>(size, 70) + 1);
+    const auto last = first + random_below(size - first + 1);
+    const auto expected = sigscan::find_scalar(data.data(), first, last, set);
+    for (const auto& v : variants) {
+      const auto found = v.kernel(data.data(), first, last, set);
+      const bool candidate = found == expected || (high_nibbles > 8 && first <= found && found < expected &&
+                                                   (set.low[data[found] & 0xf] & set.high[data[found] >> 4]));
+      report(candidate, "find", v.name, last - first);
+    }
+  }
+}
+
+// strscan::classify_* against classify_scalar
+void check_classify() {
+  std::vector<variant<strscan::classify_type>> variants;
+#if defined(BINLAB_HAVE_SSE2)
+  variants.push_back({"sse2", strscan::classify_sse2});
+#endif  // !BINLAB_HAVE_SSE2
+#if defined(BINLAB_HAVE_AVX2)
+  if (have_avx2()) {
+    variants.push_back({"avx2", strscan::classify_avx2});
+  }
+#endif  // !BINLAB_HAVE_AVX2
+#if defined(BINLAB_HAVE_AVX512)
+  if (have_avx512()) {
+    variants.push_back({"avx512", strscan::classify_avx512});
+  }
+#endif  // !BINLAB_HAVE_AVX512
+  print_variants("classify", variants);
+
+  for (std::size_t size = 0; size <= strscan::batch; size += 1 + size / 3) {
+    const auto data = random_bytes(size);
+    std::vector<std::uint64_t> printable(strscan::words, ~std::uint64_t{0}), zero(strscan::words, ~std::uint64_t{0});
+    strscan::classify_scalar(data.data(), size, printable.data(), zero.data());
+    for (const auto& v : variants) {
+      std::vector<std::uint64_t> p(strscan::words, ~std::uint64_t{0}), z(strscan::words, ~std::uint64_t{0});
+      v.kernel(data.data(), size, p.data(), z.data());
+      report(p == printable && z == zero, "classify", v.name, size);
+    }
+  }
+}
+
+// relocate::relative_run_* against relative_run_scalar: targets in order and scattered (overlapping ones
+// included), and an entry of another type or outside the image part way through
+void check_relative_run() {
+  using binlab::ELF::Elf64_Rela;
+  std::vector<variant<relocate::relative_run_type>> variants;
+#if defined(BINLAB_HAVE_AVX512)
+  if (__builtin_cpu_supports("avx512f")) {
+    variants.push_back({"avx512", relocate::relative_run_avx512});
+  }
+#endif  // !BINLAB_HAVE_AVX512
+  print_variants("relative_run", variants);
+
+  constexpr std::uint64_t type = binlab::ELF::R_X86_64_RELATIVE, first = 0x400000;
+  for (std::size_t round = 0; round < 400; ++round) {
+    const auto size = (round % 50 == 0) ? random_below(8) : 8 + random_below(4096);
+    const auto count = random_below(100);
+    std::vector<Elf64_Rela> rela(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      const auto slot = (round % 2) ? 8 * i : random_engine();
+      rela[i].r_offset = first + (size >= 8 ? slot % (size - 7) : 0);
+      rela[i].r_info = type;
+      rela[i].r_addend = static_cast<std::int64_t>(random_engine());
+    }
+    if (count && round % 3 == 2) {
+      auto& bad = rela[random_below(count)];
+      switch (random_below(3)) {
+        case 0: bad.r_info = binlab::ELF::R_X86_64_64; break;
+        case 1: bad.r_offset = first + size; break;
+        default: bad.r_offset = first - 8; break;
+      }
+    }
+    const auto image = random_bytes(size);
+    const std::uint64_t base = random_engine() & ~std::uint64_t{0xfff};
+    auto expected = image;
+    const auto done = relocate::relative_run_scalar(rela.data(), count, type, reinterpret_cast<char*>(expected.data()), first, size, base);
+    for (const auto& v : variants) {
+      auto actual = image;
+      report(v.kernel(rela.data(), count, type, reinterpret_cast<char*>(actual.data()), first, size, base) == done && actual == expected,
+             "relative_run", v.name, size);
+    }
+  }
+}
+
+// rebase::dir64_run_* and highlow_run_* against their scalar loops: back-to-back slots, sorted slots with gaps,
+// unsorted and overlapping ones, and another entry type part way through
+void check_rebase() {
+  std::vector<variant<rebase::run_type>> dir64, highlow;
+#if defined(BINLAB_HAVE_AVX512)
+  if (have_avx512()) {
+    dir64.push_back({"avx512", rebase::dir64_run_avx512});
+    highlow.push_back({"avx512", rebase::highlow_run_avx512});
+  }
+#endif  // !BINLAB_HAVE_AVX512
+  print_variants("dir64_run", dir64);
+  print_variants("highlow_run", highlow);
+
+  auto check = [](const char* kernel, rebase::run_type scalar, const std::vector<variant<rebase::run_type>>& variants, std::uint16_t type, std::size_t width) {
+    for (std::size_t round = 0; round < 400; ++round) {
+      const auto count = random_below(120);
+      std::vector<std::uint16_t> entries(count);
+      std::size_t offset = random_below(rebase::page_size / 2) & ~(width - 1);
+      for (auto& e : entries) {
+        switch (round % 3) {
+          case 0: offset += width; break;
+          case 1: offset += width + random_below(4 * width); break;
+          default: offset = random_below(rebase::page_size); break;
+        }
+        e = static_cast<std::uint16_t>(type << 12 | (offset & 0xfff));
+      }
+      if (count && round % 4 == 3) {
+        entries[random_below(count)] = static_cast<std::uint16_t>((round % 8 == 3 ? IMAGE_REL_BASED_ABSOLUTE : IMAGE_REL_BASED_HIGHADJ) << 12);
+      }
+      const auto page = random_bytes(rebase::page_size + 8);
+      const std::uint64_t delta = random_engine();
+      auto expected = page;
+      const auto done = scalar(reinterpret_cast<char*>(expected.data()), entries.data(), count, delta);
+      for (const auto& v : variants) {
+        auto actual = page;
+        report(v.kernel(reinterpret_cast<char*>(actual.data()), entries.data(), count, delta) == done && actual == expected, kernel, v.name,
+               2 * count);
+      }
+    }
+  };
+  check("dir64_run", rebase::dir64_run_scalar, dir64, IMAGE_REL_BASED_DIR64, 8);
+  check("highlow_run", rebase::highlow_run_scalar, highlow, IMAGE_REL_BASED_HIGHLOW, 4);
+}
+
+// the PE fixture: a PE32+ DLL with one export, an ASCII and a UTF-16LE string and a signature to find, one named resource, and a page of DIR64 fixups: 32 back-to-back pointer slots,
+// 8 spread ones and two padding entries
+constexpr std::uint64_t fixture_base = 0x180000000;
+constexpr std::size_t fixture_size = 0xc00;
+constexpr std::size_t fixture_slots = 0x800;    // file offset of the slots at RVA 0x2200
+constexpr std::size_t fixture_spread = 0x900;   // and of the spread ones at RVA 0x2300
+constexpr std::size_t fixture_base_field = 0x40 + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER) + offsetof(IMAGE_OPTIONAL_HEADER64, ImageBase);
+constexpr std::size_t fixture_directories = 0x40 + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER) + offsetof(IMAGE_OPTIONAL_HEADER64, DataDirectory);
+
+template <typename T>
+void put(std::vector<char>& file, std::size_t offset, const T& value) {
+  std::memcpy(&file[offset], &value, sizeof(value));
+}
+
+void put_section(std::vector<char>& file, std::size_t index, const char* name, DWORD rva, DWORD size, DWORD offset, DWORD raw_size, DWORD characteristics) {
+  IMAGE_SECTION_HEADER section{};
+  std::memcpy(section.Name, name, std::strlen(name));
+  section.Misc.VirtualSize = size;
+  section.VirtualAddress = rva;
+  section.SizeOfRawData = raw_size;
+  section.PointerToRawData = offset;
+  section.Characteristics = characteristics;
+  put(file, 0x40 + sizeof(IMAGE_NT_HEADERS64) + index * sizeof(section), section);
+}
+
+// a resource directory entry from its raw Name and OffsetToData words
+void put_entry(std::vector<char>& file, std::size_t offset, DWORD name, DWORD data) {
+  put(file, offset, name);
+  put(file, offset + sizeof(name), data);
+}
+
+std::vector<char> build_fixture() {
+  std::vector<char> file(fixture_size, 0);
+  IMAGE_DOS_HEADER dos{};
+  dos.e_magic = IMAGE_DOS_SIGNATURE;
+  dos.e_lfanew = 0x40;
+  put(file, 0, dos);
+
+  IMAGE_NT_HEADERS64 nt{};
+  nt.Signature = IMAGE_NT_SIGNATURE;
+  nt.FileHeader.Machine = IMAGE_FILE_MACHINE_AMD64;
+  nt.FileHeader.NumberOfSections = 3;
+  nt.FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER64);
+  nt.FileHeader.Characteristics = IMAGE_FILE_EXECUTABLE_IMAGE | IMAGE_FILE_LARGE_ADDRESS_AWARE | IMAGE_FILE_DLL;
+  auto& optional = nt.OptionalHeader;
+  optional.Magic = IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+  optional.ImageBase = fixture_base;
+  optional.SectionAlignment = 0x1000;
+  optional.FileAlignment = 0x200;
+  optional.MajorSubsystemVersion = 6;
+  optional.SizeOfImage = 0x4000;
+  optional.SizeOfHeaders = 0x400;
+  optional.Subsystem = IMAGE_SUBSYSTEM_WINDOWS_GUI;
+  optional.DllCharacteristics = IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE;
+  optional.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+  optional.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT] = {0x2000, 0x80};
+  optional.DataDirectory[IMAGE_DIRECTORY_ENTRY_RESOURCE] = {0x2380, 0x70};
+  optional.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC] = {0x3000, 8 + 42 * 2};
+  put(file, 0x40, nt);
+  put_section(file, 0, ".text", 0x1000, 0x20, 0x400, 0x200, IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ);
+  put_section(file, 1, ".rdata", 0x2000, 0x400, 0x600, 0x400, IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ);
+  put_section(file, 2, ".reloc", 0x3000, 8 + 42 * 2, 0xa00, 0x200, IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_DISCARDABLE | IMAGE_SCN_MEM_READ);
+
+  // .text: xor eax, eax; ret, then the signature
+  const unsigned char code[] = {0x31, 0xc0, 0xc3};
+  const unsigned char signature[] = {0xde, 0xad, 0xbe, 0xef, 0x90, 0x90, 0xc3};
+  std::memcpy(&file[0x400], code, sizeof(code));
+  std::memcpy(&file[0x410], signature, sizeof(signature));
+
+  // .rdata: the export directory, its tables and names, the strings, the pointer slots, then the resource tree FIXTURE/1/1033 with its name and eight bytes of data
+  IMAGE_EXPORT_DIRECTORY exports{};
+  exports.Name = 0x2040;
+  exports.Base = 1;
+  exports.NumberOfFunctions = 1;
+  exports.NumberOfNames = 1;
+  exports.AddressOfFunctions = 0x2050;
+  exports.AddressOfNames = 0x2054;
+  exports.AddressOfNameOrdinals = 0x2058;
+  put(file, 0x600, exports);
+  std::strcpy(&file[0x640], "fixture.dll");
+  put(file, 0x650, DWORD{0x1000});
+  put(file, 0x654, DWORD{0x2060});
+  put(file, 0x658, WORD{0});
+  std::strcpy(&file[0x660], "fixture_export");
+  std::strcpy(&file[0x700], "binlab fixture ascii run");
+  const char wide[] = "binlab fixture wide run";
+  for (std::size_t i = 0; i < sizeof(wide); ++i) {
+    file[0x740 + 2 * i] = wide[i];
+  }
+  for (std::size_t i = 0; i < 32; ++i) {
+    put(file, fixture_slots + 8 * i, std::uint64_t{fixture_base + 0x1000 + 8 * i});
+  }
+  for (std::size_t i = 0; i < 8; ++i) {
+    put(file, fixture_spread + 16 * i, std::uint64_t{fixture_base + 0x2000 + i});
+  }
+  IMAGE_RESOURCE_DIRECTORY named{}, single{};
+  named.NumberOfNamedEntries = 1;
+  single.NumberOfIdEntries = 1;
+  put(file, 0x980, named);
+  put_entry(file, 0x990, 0x80000000 | 0x58, 0x80000000 | 0x18);
+  put(file, 0x998, single);
+  put_entry(file, 0x9a8, 1, 0x80000000 | 0x30);
+  put(file, 0x9b0, single);
+  put_entry(file, 0x9c0, 0x409, 0x48);
+  put(file, 0x9c8, IMAGE_RESOURCE_DATA_ENTRY{0x23e8, 8, 0, 0});
+  put(file, 0x9d8, WORD{7});
+  for (std::size_t i = 0; i < 7; ++i) {
+    file[0x9da + 2 * i] = "FIXTURE"[i];
+  }
+  std::memcpy(&file[0x9e8], "resource", 8);
+
+  // .reloc: one block for the .rdata page
+  put(file, 0xa00, IMAGE_BASE_RELOCATION{0x2000, 8 + 42 * 2});
+  for (std::size_t i = 0; i < 32; ++i) {
+    put(file, 0xa08 + 2 * i, static_cast<WORD>(IMAGE_REL_BASED_DIR64 << 12 | (0x200 + 8 * i)));
+  }
+  for (std::size_t i = 0; i < 8; ++i) {
+    put(file, 0xa48 + 2 * i, static_cast<WORD>(IMAGE_REL_BASED_DIR64 << 12 | (0x300 + 16 * i)));
+  }
+
+  return file;
+}
+
+// damages the fixture the way a malformed or cut-off file would; -1 for an unknown defect
+int damage_fixture(std::vector<char>& file, const char* defect) {
+  if (!std::strcmp(defect, "lfanew")) {
+    put(file, offsetof(IMAGE_DOS_HEADER, e_lfanew), LONG{0x7ffffff0});
+  } else if (!std::strcmp(defect, "sections")) {
+    put(file, 0x40 + sizeof(DWORD) + offsetof(IMAGE_FILE_HEADER, NumberOfSections), WORD{0xffff});
+  } else if (!std::strcmp(defect, "exports")) {
+    // a million functions and names, whose tables then run on to the end of .rdata
+    put(file, 0x600 + offsetof(IMAGE_EXPORT_DIRECTORY, NumberOfFunctions), DWORD{0x100000});
+    put(file, 0x600 + offsetof(IMAGE_EXPORT_DIRECTORY, NumberOfNames), DWORD{0x100000});
+  } else if (!std::strcmp(defect, "imports")) {
+    // three descriptors at RVA 0x2080: a module and an import name that run from the end of .text's VirtualSize
+    // into its uninitialized tail, a thunk past 4GB, then nothing but unmapped RVAs
+    put(file, fixture_directories + IMAGE_DIRECTORY_ENTRY_IMPORT * sizeof(IMAGE_DATA_DIRECTORY),
+        IMAGE_DATA_DIRECTORY{0x2080, 4 * sizeof(IMAGE_IMPORT_DESCRIPTOR)});
+    IMAGE_IMPORT_DESCRIPTOR descriptor{};
+    descriptor.OriginalFirstThunk = 0x23f0;
+    descriptor.Name = 0x1018;
+    put(file, 0x680, descriptor);
+    descriptor.OriginalFirstThunk = 0x1020;
+    descriptor.Name = 0xfffffff0;
+    put(file, 0x680 + sizeof(descriptor), descriptor);
+    descriptor.OriginalFirstThunk = 0x2f00;
+    descriptor.Name = 0x23fc;
+    put(file, 0x680 + 2 * sizeof(descriptor), descriptor);
+    std::memcpy(&file[0x418], "ABCDEFGHIJ", 10);
+    put(file, 0x9f0, std::uint64_t{0x1016});
+    put(file, 0x9f8, std::uint64_t{0x4141414100001018});
+  } else if (!std::strcmp(defect, "truncated")) {
+    // cut inside the resource data, before .reloc
+    file.resize(0x9ec);
+  } else {
+    std::fprintf(stderr, "unknown defect %s\n", defect);
+    return -1;
+  }
+  return 0;
+}
+
+int write_file(const char* path, const std::vector<char>& file) {
+  auto stream = std::fopen(path, "wb");
+  if (!stream) {
+    std::fprintf(stderr, "cannot create %s\n", path);
+    return -1;
+  }
+  const bool written = std::fwrite(file.data(), 1, file.size(), stream) == file.size();
+  return (std::fclose(stream) == 0 && written) ? 0 : -1;
+}
+
+#if defined(__ELF__)
+// copies the 64-bit little-endian ELF file at `path` to `copy` with its last PT_LOAD segment moved 0x7f0000000000
+// up ("span") or to the top of the address space so that it wraps ("wrap")
+int damage_elf(const char* path, const char* copy, const char* defect) {
+  using namespace binlab::ELF;
+  std::vector<char> file;
+  auto stream = std::fopen(path, "rb");
+  if (!stream) {
+    std::fprintf(stderr, "cannot open %s\n", path);
+    return -1;
+  }
+  char chunk[0x10000];
+  for (std::size_t n; (n = std::fread(chunk, 1, sizeof(chunk), stream));) {
+    file.insert(file.end(), chunk, chunk + n);
+  }
+  std::fclose(stream);
+
+  Elf64_Ehdr header;
+  if (file.size() < sizeof(header) || std::memcmp(file.data(), ELFMAG, SELFMAG) || file[EI_CLASS] != ELFCLASS64 || file[EI_DATA] != ELFDATA2LSB) {
+    std::fprintf(stderr, "%s: not a 64-bit little-endian ELF file\n", path);
+    return -1;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  std::size_t load = 0;
+  for (std::size_t i = 0, off = header.e_phoff; i < header.e_phnum && off + sizeof(Elf64_Phdr) <= file.size(); ++i, off += sizeof(Elf64_Phdr)) {
+    Elf64_Phdr segment;
+    std::memcpy(&segment, &file[off], sizeof(segment));
+    load = segment.p_type == PT_LOAD ? off : load;
+  }
+  if (!load) {
+    std::fprintf(stderr, "%s: no PT_LOAD segment\n", path);
+    return -1;
+  }
+  Elf64_Phdr segment;
+  std::memcpy(&segment, &file[load], sizeof(segment));
+  if (!std::strcmp(defect, "span")) {
+    segment.p_vaddr += 0x7f0000000000;
+  } else if (!std::strcmp(defect, "wrap")) {
+    segment.p_vaddr = ~std::uint64_t{0} - 0xfff;
+    segment.p_memsz = std::max<std::uint64_t>(segment.p_memsz, 0x2000);
+  } else {
+    std::fprintf(stderr, "unknown defect %s\n", defect);
+    return -1;
+  }
+  std::memcpy(&file[load], &segment, sizeof(segment));
+  return write_file(copy, file);
+}
+#endif  // !__ELF__
+
+// a fixture rebased to `base`: ImageBase and every slot moved by the same delta
+int check_fixture(const char* path, std::uint64_t base) {
+  std::vector<char> file(fixture_size + 1);
+  auto stream = std::fopen(path, "rb");
+  if (!stream) {
+    std::fprintf(stderr, "cannot open %s\n", path);
+    return -1;
+  }
+  file.resize(std::fread(file.data(), 1, file.size(), stream));
+  std::fclose(stream);
+  if (file.size() != fixture_size) {
+    std::fprintf(stderr, "%s: %zu bytes, not %zu\n", path, file.size(), fixture_size);
+    return -1;
+  }
+
+  int result = 0;
+  auto expect = [&file, &result, path](std::size_t offset, std::uint64_t value) {
+    std::uint64_t actual;
+    std::memcpy(&actual, &file[offset], sizeof(actual));
+    if (actual != value) {
+      std::fprintf(stderr, "%s: 0x%llx at offset 0x%zx, not 0x%llx\n", path, static_cast<unsigned long long>(actual), offset,
+                   static_cast<unsigned long long>(value));
+      result = -1;
+    }
+  };
+  expect(fixture_base_field, base);
+  for (std::size_t i = 0; i < 32; ++i) {
+    expect(fixture_slots + 8 * i, base + 0x1000 + 8 * i);
+  }
+  for (std::size_t i = 0; i < 8; ++i) {
+    expect(fixture_spread + 16 * i, base + 0x2000 + i);
+  }
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if ((argc == 3 || argc == 4) && !std::strcmp(argv[1], "-w")) {
+    auto file = build_fixture();
+    return (argc == 4 && damage_fixture(file, argv[3])) || write_file(argv[2], file) ? 1 : 0;
+  }
+#if defined(__ELF__)
+  if (argc == 5 && !std::strcmp(argv[1], "-e")) {
+    return damage_elf(argv[2], argv[3], argv[4]) ? 1 : 0;
+  }
+#endif  // !__ELF__
+  if (argc == 4 && !std::strcmp(argv[1], "-c")) {
+    return check_fixture(argv[2], std::strtoull(argv[3], nullptr, 0)) ? 1 : 0;
+  }
+  if (argc != 1) {
+    std::fprintf(stderr, "usage: %s [-w fixture [defect] | -c fixture base | -e elf copy defect]\n", argv[0]);
+    return 1;
+  }
+
+  check_hexdump();
+  check_utf16();
+  check_byte_stats();
+  check_signature_find();
+  check_classify();
+  check_rebase();
+  check_relative_run();
+  std::printf("%zu checks, %zu failed\n", checks, failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,341 @@
+// signature_scan.h
+
+#ifndef BINLAB_SIGNATURE_SCAN_H_
+#define BINLAB_SIGNATURE_SCAN_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "cpu_dispatch.h"
+
+namespace sigscan {
+
+// longest literal run the automaton looks for; the rest of a signature is checked byte by byte after a hit
+static constexpr std::size_t max_anchor = 8;
+
+// a hex byte signature such as "4d 5a ?? ?0 90": `mask` is 0xff for a literal byte, 0xf0 or 0x0f for a nibble
+// wildcard and 0 for ??, and `value` is already masked; [anchor, anchor + anchor_size) is the literal run searched for
+struct pattern {
+  std::string name;
+  std::vector<std::uint8_t> value;
+  std::vector<std::uint8_t> mask;
+  std::size_t anchor = 0;
+  std::size_t anchor_size = 0;
+};
+
+// `offset` is where the signature starts in the scanned data
+struct match {
+  std::size_t offset;
+  std::size_t pattern;
+
+  friend bool operator<(const match& a, const match& b) { return (a.offset != b.offset) ? a.offset < b.offset : a.pattern < b.pattern; }
+};
+
+// how often a byte turns up in code and data, 0 (zero fill, 0xff) to 2 (rare); anchors prefer a rare first byte so
+// the prefilter skips most of the input
+inline constexpr int rarity(std::uint8_t c) {
+  if (c == 0x00 || c == 0xff) {
+    return 0;
+  }
+  constexpr std::uint8_t common[] = {0x01, 0x02, 0x03, 0x04, 0x08, 0x0f, 0x10, 0x20, 0x24, 0x40, 0x41, 0x44, 0x45, 0x48, 0x49,
+                                     0x4c, 0x74, 0x75, 0x83, 0x85, 0x89, 0x8b, 0x8d, 0x90, 0xc0, 0xc3, 0xcc, 0xe8, 0xeb};
+  for (auto x : common) {
+    if (c == x) {
+      return 1;
+    }
+  }
+  return ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')) ? 1 : 2;
+}
+
+// byte-set membership by nibble lookup ("shufti"): c is a candidate when low[c & 15] & high[c >> 4] is not 0. Each
+// high nibble of the set gets its own bit while there are at most eight; beyond that they share bits, which only
+// lets through false candidates
+struct byte_set {
+  alignas(16) std::uint8_t low[16] = {};
+  alignas(16) std::uint8_t high[16] = {};
+  std::array<bool, 256> exact = {};
+
+  void build() {
+    std::size_t groups = 0;
+    for (std::size_t h = 0; h < 16; ++h) {
+      std::uint8_t bit = 0;
+      for (std::size_t l = 0; l < 16; ++l) {
+        if (exact[h << 4 | l]) {
+          bit = static_cast<std::uint8_t>(1u << (groups % 8));
+          low[l] |= bit;
+        }
+      }
+      if (bit) {
+        high[h] = bit;
+        ++groups;
+      }
+    }
+  }
+};
+
+// position of the first byte of [p + first, p + last) that may be in `set`, or `last`
+inline std::size_t find_scalar(const std::uint8_t* p, std::size_t first, std::size_t last, const byte_set& set) {
+  for (; first < last && !set.exact[p[first]]; ++first) {
+  }
+  return first;
+}
+
+#if defined(BINLAB_HAVE_AVX2)
+BINLAB_TARGET_AVX2 inline std::size_t find_avx2(const std::uint8_t* p, std::size_t first, std::size_t last, const byte_set& set) {
+  const auto low = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(set.low)));
+  const auto high = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(set.high)));
+  const auto nibble = _mm256_set1_epi8(0x0f);
+  for (; first + 32 <= last; first += 32) {
+    const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + first));
+    const auto hit = _mm256_and_si256(_mm256_shuffle_epi8(low, _mm256_and_si256(v, nibble)),
+                                      _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble)));
+    if (auto bits = ~static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hit, _mm256_setzero_si256())))) {
+      return first + static_cast<std::size_t>(__builtin_ctz(bits));
+    }
+  }
+  return find_scalar(p, first, last, set);
+}
+#endif  // !BINLAB_HAVE_AVX2
+
+#if defined(BINLAB_HAVE_AVX512)
+BINLAB_TARGET_AVX512 inline std::size_t find_avx512(const std::uint8_t* p, std::size_t first, std::size_t last, const byte_set& set) {
+  const auto low = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(set.low)));
+  const auto high = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(set.high)));
+  const auto nibble = _mm512_set1_epi8(0x0f);
+  for (; first + 64 <= last; first += 64) {
+    const auto v = _mm512_loadu_si512(p + first);
+    const auto hit = _mm512_and_si512(_mm512_shuffle_epi8(low, _mm512_and_si512(v, nibble)),
+                                      _mm512_shuffle_epi8(high, _mm512_and_si512(_mm512_srli_epi16(v, 4), nibble)));
+    if (auto bits = _mm512_test_epi8_mask(hit, hit)) {
+      return first + static_cast<std::size_t>(__builtin_ctzll(bits));
+    }
+  }
+  return find_scalar(p, first, last, set);
+}
+#endif  // !BINLAB_HAVE_AVX512
+
+using find_type = std::size_t (*)(const std::uint8_t*, std::size_t, std::size_t, const byte_set&);
+
+// the nibble lookup needs pshufb, so there is no sse2 kernel
+inline find_type select_find() {
+#if defined(BINLAB_HAVE_AVX512)
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return find_avx512;
+  }
+#endif  // !BINLAB_HAVE_AVX512
+#if defined(BINLAB_HAVE_AVX2)
+  if (__builtin_cpu_supports("avx2")) {
+    return find_avx2;
+  }
+#endif  // !BINLAB_HAVE_AVX2
+  return find_scalar;
+}
+
+inline std::size_t find(const std::uint8_t* p, std::size_t first, std::size_t last, const byte_set& set) {
+  static const auto kernel = select_find();
+  return kernel(p, first, last, set);
+}
+
+// parses hex bytes with optional whitespace between them; either digit of a byte may be ?, and at least one byte
+// must be literal. The anchor is the literal run (up to max_anchor bytes) with the rarest first byte, preferring
+// runs of four bytes or more. -1 on anything else
+inline int parse(std::string_view name, std::string_view hex, pattern& result) {
+  auto digit = [](char c, std::uint8_t& value, std::uint8_t& mask) {
+    if (c == '?') {
+      value = mask = 0;
+    } else if (c >= '0' && c <= '9') {
+      value = static_cast<std::uint8_t>(c - '0'), mask = 0xf;
+    } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+      value = static_cast<std::uint8_t>((c | 0x20) - 'a' + 10), mask = 0xf;
+    } else {
+      return false;
+    }
+    return true;
+  };
+
+  result = pattern{std::string{name}, {}, {}, 0, 0};
+  for (std::size_t i = 0; i < hex.size();) {
+    if (hex[i] == ' ' || hex[i] == '\t') {
+      ++i;
+      continue;
+    }
+    std::uint8_t hi, hi_mask, lo, lo_mask;
+    if (i + 1 >= hex.size() || !digit(hex[i], hi, hi_mask) || !digit(hex[i + 1], lo, lo_mask)) {
+      return -1;
+    }
+    result.value.push_back(static_cast<std::uint8_t>(hi << 4 | lo));
+    result.mask.push_back(static_cast<std::uint8_t>(hi_mask << 4 | lo_mask));
+    i += 2;
+  }
+
+  std::tuple<std::size_t, int, std::size_t> best{};
+  for (std::size_t i = 0; i < result.mask.size(); ++i) {
+    std::size_t run = 0;
+    while (run < max_anchor && i + run < result.mask.size() && result.mask[i + run] == 0xff) {
+      ++run;
+    }
+    std::tuple<std::size_t, int, std::size_t> score{std::min<std::size_t>(run, 4), rarity(result.value[i]), run};
+    if (run && score > best) {
+      best = score;
+      result.anchor = i;
+      result.anchor_size = run;
+    }
+  }
+  return result.anchor_size ? 0 : -1;
+}
+
+// Aho-Corasick automaton over the anchors of many signatures, as a dense transition table over byte classes (the
+// bytes no anchor uses share one class). Scanning skips ahead with a vector prefilter while the automaton is at the
+// root, i.e. to the next byte that can start an anchor, and checks the whole signature of every anchor it finds
+class scanner {
+ public:
+  // -1 when `hex` is not a signature
+  int add(std::string_view name, std::string_view hex) {
+    pattern p;
+    if (parse(name, hex, p)) {
+      return -1;
+    }
+    patterns_.push_back(std::move(p));
+    return 0;
+  }
+
+  bool empty() const { return patterns_.empty(); }
+  const std::vector<pattern>& patterns() const { return patterns_; }
+
+  // builds the automaton once every signature has been added
+  void build() {
+    std::array<bool, 256> used{};
+    for (const auto& p : patterns_) {
+      for (std::size_t k = 0; k < p.anchor_size; ++k) {
+        used[p.value[p.anchor + k]] = true;
+      }
+    }
+    classes_ = 1;
+    for (std::size_t c = 0; c < 256; ++c) {
+      class_of_[c] = used[c] ? static_cast<std::uint8_t>(classes_++) : 0;
+    }
+
+    // the trie, with children kept sparse until the table is filled in breadth-first order
+    std::vector<std::vector<std::pair<std::uint8_t, std::uint32_t>>> children(1);
+    std::vector<std::vector<std::uint32_t>> outputs(1);
+    for (std::size_t i = 0; i < patterns_.size(); ++i) {
+      std::uint32_t state = 0;
+      const auto& p = patterns_[i];
+      for (std::size_t k = 0; k < p.anchor_size; ++k) {
+        const auto c = class_of_[p.value[p.anchor + k]];
+        auto& edges = children[state];
+        auto edge = std::find_if(edges.begin(), edges.end(), [c](const auto& e) { return e.first == c; });
+        if (edge == edges.end()) {
+          edges.emplace_back(c, static_cast<std::uint32_t>(children.size()));
+          state = static_cast<std::uint32_t>(children.size());
+          children.emplace_back();
+          outputs.emplace_back();
+        } else {
+          state = edge->second;
+        }
+      }
+      outputs[state].push_back(static_cast<std::uint32_t>(i));
+    }
+
+    next_.assign(children.size() * classes_, 0);
+    std::vector<std::uint32_t> fail(children.size()), order{0};
+    for (std::size_t head = 0; head < order.size(); ++head) {
+      const auto s = order[head];
+      for (const auto& [c, t] : children[s]) {
+        fail[t] = s ? next_[fail[s] * classes_ + c] : 0;
+        outputs[t].insert(outputs[t].end(), outputs[fail[t]].begin(), outputs[fail[t]].end());
+        order.push_back(t);
+      }
+      for (std::size_t c = 0; c < classes_; ++c) {
+        next_[s * classes_ + c] = s ? next_[fail[s] * classes_ + c] : 0;
+      }
+      for (const auto& [c, t] : children[s]) {
+        next_[s * classes_ + c] = t;
+      }
+    }
+
+    first_output_.assign(1, 0);
+    outputs_.clear();
+    for (const auto& list : outputs) {
+      outputs_.insert(outputs_.end(), list.begin(), list.end());
+      first_output_.push_back(static_cast<std::uint32_t>(outputs_.size()));
+    }
+    // the scan loop follows rows, not states, and only looks up outputs where an anchor ends
+    for (auto& t : next_) {
+      t = static_cast<std::uint32_t>(t * classes_) | (outputs[t].empty() ? 0 : reported);
+    }
+
+    // skipping only pays when anchors start with bytes that are rare in the input
+    starts_ = byte_set{};
+    std::size_t count = 0;
+    for (const auto& [c, t] : children[0]) {
+      for (std::size_t b = 0; b < 256; ++b) {
+        if (class_of_[b] == c) {
+          starts_.exact[b] = true;
+          ++count;
+        }
+      }
+    }
+    starts_.build();
+    prefilter_ = count <= 64 && !starts_.exact[0x00] && !starts_.exact[0xff];
+  }
+
+  // appends the signatures found in data[0, size) whose anchor starts in [first, last), so that adjacent pieces of
+  // one buffer can be scanned apart without losing or repeating a match
+  void scan(const char* data, std::size_t size, std::size_t first, std::size_t last, std::vector<match>& result) const {
+    const auto p = reinterpret_cast<const std::uint8_t*>(data);
+    const auto stop = std::min(size, last + max_anchor - 1);
+    std::uint32_t row = 0;
+    for (auto i = first; i < stop; ++i) {
+      if (!row && prefilter_ && (i = find(p, i, stop, starts_)) == stop) {
+        break;
+      }
+      const auto t = next_[row + class_of_[p[i]]];
+      row = t & ~reported;
+      if (!(t & reported)) {
+        continue;
+      }
+      const auto state = row / classes_;
+      for (auto k = first_output_[state]; k < first_output_[state + 1]; ++k) {
+        const auto& sig = patterns_[outputs_[k]];
+        const auto anchor = i + 1 - sig.anchor_size;
+        if (anchor < last && anchor >= sig.anchor && size - (anchor - sig.anchor) >= sig.value.size() && matches(sig, p + anchor - sig.anchor)) {
+          result.push_back({anchor - sig.anchor, outputs_[k]});
+        }
+      }
+    }
+  }
+
+ private:
+  static bool matches(const pattern& sig, const std::uint8_t* p) {
+    for (std::size_t k = 0; k < sig.value.size(); ++k) {
+      if ((p[k] & sig.mask[k]) != sig.value[k]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::vector<pattern> patterns_;
+  std::array<std::uint8_t, 256> class_of_{};
+  std::size_t classes_ = 1;
+  static constexpr std::uint32_t reported = std::uint32_t{1} << 31;
+
+  std::vector<std::uint32_t> next_;  // next_[state * classes_ + class] is the next state times classes_, | reported when anchors end there
+  std::vector<std::uint32_t> first_output_;  // the signatures whose anchors end at a state are outputs_[first_output_[state], first_output_[state + 1])
+  std::vector<std::uint32_t> outputs_;
+  byte_set starts_;
+  bool prefilter_ = false;
+};
+
+}  // namespace sigscan
+
+#endif  // BINLAB_SIGNATURE_SCAN_H_
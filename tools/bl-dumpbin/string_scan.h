@@ -0,0 +1,178 @@
+// string_scan.h
+
+#ifndef BINLAB_STRING_SCAN_H_
+#define BINLAB_STRING_SCAN_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "binlab/Config.h"
+#include "cpu_dispatch.h"
+#include "hexdump_kernel.h"
+
+namespace strscan {
+
+// bytes classified per kernel call, a whole number of 64 byte words
+static constexpr std::size_t batch = 4096;
+static constexpr std::size_t words = batch / 64;
+
+// a run of printable characters at `offset` spanning `size` bytes; a UTF-16LE run is printable ASCII units, each
+// followed by a NUL, so it spans twice as many bytes as it has characters
+struct run {
+  std::size_t offset;
+  std::size_t size;
+  bool utf16;
+
+  friend bool operator<(const run& a, const run& b) { return (a.offset != b.offset) ? a.offset < b.offset : a.utf16 < b.utf16; }
+};
+
+// bit i of printable[w] (zero[w]) is set when byte 64 * w + i of [p, p + n) is_printable() (is NUL); n is at most
+// batch and the bits past it are clear
+inline void classify_scalar(const std::uint8_t* p, std::size_t n, std::uint64_t* printable, std::uint64_t* zero) {
+  for (std::size_t w = 0; w < (n + 63) / 64; ++w) {
+    printable[w] = zero[w] = 0;
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    printable[i / 64] |= std::uint64_t{hexdump::is_printable(p[i])} << (i % 64);
+    zero[i / 64] |= std::uint64_t{p[i] == 0} << (i % 64);
+  }
+}
+
+#if defined(BINLAB_HAVE_SSE2)
+inline void classify_sse2(const std::uint8_t* p, std::size_t n, std::uint64_t* printable, std::uint64_t* zero) {
+  std::size_t w = 0;
+  for (; 64 * w + 64 <= n; ++w) {
+    std::uint64_t pw = 0, zw = 0;
+    for (std::size_t k = 0; k < 4; ++k) {
+      const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 64 * w + 16 * k));
+      pw |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(hexdump::printable_mask(v)))) << (16 * k);
+      zw |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())))) << (16 * k);
+    }
+    printable[w] = pw;
+    zero[w] = zw;
+  }
+  classify_scalar(p + 64 * w, n - 64 * w, printable + w, zero + w);
+}
+#endif  // !BINLAB_HAVE_SSE2
+
+#if defined(BINLAB_HAVE_AVX2)
+BINLAB_TARGET_AVX2 inline void classify_avx2(const std::uint8_t* p, std::size_t n, std::uint64_t* printable, std::uint64_t* zero) {
+  std::size_t w = 0;
+  for (; 64 * w + 64 <= n; ++w) {
+    const auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 64 * w));
+    const auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 64 * w + 32));
+    printable[w] = static_cast<std::uint32_t>(_mm256_movemask_epi8(hexdump::printable_mask(lo))) |
+                   static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(hexdump::printable_mask(hi)))) << 32;
+    zero[w] = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, _mm256_setzero_si256()))) |
+              static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, _mm256_setzero_si256())))) << 32;
+  }
+  classify_scalar(p + 64 * w, n - 64 * w, printable + w, zero + w);
+}
+#endif  // !BINLAB_HAVE_AVX2
+
+#if defined(BINLAB_HAVE_AVX512)
+BINLAB_TARGET_AVX512 inline void classify_avx512(const std::uint8_t* p, std::size_t n, std::uint64_t* printable, std::uint64_t* zero) {
+  std::size_t w = 0;
+  for (; 64 * w + 64 <= n; ++w) {
+    const auto v = _mm512_loadu_si512(p + 64 * w);
+    printable[w] = hexdump::printable_mask(v);
+    zero[w] = _mm512_testn_epi8_mask(v, v);
+  }
+  classify_scalar(p + 64 * w, n - 64 * w, printable + w, zero + w);
+}
+#endif  // !BINLAB_HAVE_AVX512
+
+using classify_type = void (*)(const std::uint8_t*, std::size_t, std::uint64_t*, std::uint64_t*);
+
+inline classify_type select_classify() {
+#if defined(BINLAB_HAVE_AVX512)
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return classify_avx512;
+  }
+#endif  // !BINLAB_HAVE_AVX512
+#if defined(BINLAB_HAVE_AVX2)
+  if (__builtin_cpu_supports("avx2")) {
+    return classify_avx2;
+  }
+#endif  // !BINLAB_HAVE_AVX2
+#if defined(BINLAB_HAVE_SSE2)
+  return classify_sse2;
+#else
+  return classify_scalar;
+#endif  // !BINLAB_HAVE_SSE2
+}
+
+inline void classify(const std::uint8_t* p, std::size_t n, std::uint64_t* printable, std::uint64_t* zero) {
+  static const auto kernel = select_classify();
+  kernel(p, n, printable, zero);
+}
+
+// appends the runs of at least `min` characters in data[0, size) that start in [first, last), ASCII and UTF-16LE
+// alike; a run already under way at `first` belongs to the piece before, so adjacent pieces can be scanned apart.
+// Both kinds are found as runs of set bits: the printable bytes for ASCII, and for UTF-16LE every unit's two bytes,
+// which chain up exactly when units follow each other
+inline void scan(const char* data, std::size_t size, std::size_t first, std::size_t last, std::size_t min, std::vector<run>& result) {
+  static constexpr auto none = static_cast<std::size_t>(-1);
+  const auto p = reinterpret_cast<const std::uint8_t*>(data);
+  auto unit = [p, size](std::size_t i) { return i + 1 < size && hexdump::is_printable(p[i]) && !p[i + 1]; };
+
+  struct stream {
+    std::size_t start;
+    std::size_t continued;  // a run starting here began before `first`
+    std::size_t min;  // in bytes
+    bool utf16;
+  };
+  stream ascii{none, (first && hexdump::is_printable(p[first - 1])) ? first : none, min, false};
+  stream utf16{none, ((first && unit(first - 1)) || (first > 1 && unit(first - 2))) ? first : none, 2 * min, true};
+  std::uint64_t carry = (first && unit(first - 1)) ? 1 : 0;
+
+  auto close = [&](stream& s, std::size_t end) {
+    if (s.start != s.continued && s.start < last && end - s.start >= s.min) {
+      result.push_back({s.start, end - s.start, s.utf16});
+    }
+    s.start = none;
+  };
+  auto feed = [&](stream& s, std::uint64_t bits, std::size_t pos) {
+    for (std::size_t i = 0; i < 64;) {
+      const auto rest = ((s.start == none) ? bits : ~bits) >> i;
+      if (!rest) {
+        return;
+      }
+      i += static_cast<std::size_t>(__builtin_ctzll(rest));
+      if (s.start == none) {
+        s.start = pos + i;
+      } else {
+        close(s, pos + i);
+      }
+    }
+  };
+
+  std::uint64_t printable[words + 1], zero[words + 1];
+  for (auto base = first; base < size; base += batch) {
+    const auto n = std::min(batch, size - base);
+    classify(p + base, n, printable, zero);
+    zero[(n + 63) / 64] = (base + n < size && !p[base + n]) ? 1 : 0;
+    for (std::size_t w = 0; w < (n + 63) / 64; ++w) {
+      const auto pos = base + 64 * w;
+      const auto units = printable[w] & (zero[w] >> 1 | zero[w + 1] << 63);
+      feed(ascii, printable[w], pos);
+      feed(utf16, units | units << 1 | carry, pos);
+      carry = units >> 63;
+      if (pos + 64 >= last && (ascii.start == none || ascii.start >= last) && (utf16.start == none || utf16.start >= last)) {
+        return;
+      }
+    }
+  }
+  if (ascii.start != none) {
+    close(ascii, size);
+  }
+  if (utf16.start != none) {
+    close(utf16, size);
+  }
+}
+
+}  // namespace strscan
+
+#endif  // BINLAB_STRING_SCAN_H_
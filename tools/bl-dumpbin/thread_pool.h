@@ -0,0 +1,181 @@
+// thread_pool.h
+
+#ifndef BINLAB_THREAD_POOL_H_
+#define BINLAB_THREAD_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "binlab/Config.h"
+
+// work-stealing pool: every worker owns a deque, pops its own tail and steals the heads of the others;
+// tasks submitted from a worker land in that worker's deque, so nested fan-out stays local
+class thread_pool {
+ public:
+  using task = std::function<void()>;
+
+  explicit thread_pool(std::size_t count = std::thread::hardware_concurrency()) : count_{std::max<std::size_t>(count, 1)} {
+    for (std::size_t i = 0; i < count_; ++i) {
+      queues_.push_back(std::make_unique<queue>());
+    }
+    workers_.reserve(count_);
+    for (std::size_t i = 0; i < count_; ++i) {
+      workers_.emplace_back([this, i](std::stop_token token) { run(i, token); });
+    }
+  }
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+  ~thread_pool() {
+    wait();
+    workers_.clear();  // request_stop wakes the workers out of cv_
+  }
+
+  std::size_t size() const { return count_; }
+
+  // index of the calling worker in [0, size()), or size() on any thread outside the pool
+  std::size_t worker_index() const { return (current_ == this) ? index_ : size(); }
+
+  void submit(task t) {
+    auto self = worker_index();
+    auto& q = *queues_[(self < size()) ? self : next_.fetch_add(1, std::memory_order_relaxed) % size()];
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    {
+      std::lock_guard lock{q.mutex};
+      q.tasks.push_back(std::move(t));
+    }
+    {
+      std::lock_guard lock{mutex_};
+      ++queued_;
+    }
+    cv_.notify_one();
+  }
+
+  // blocks until every submitted task has finished, running queued tasks on the calling thread meanwhile
+  void wait() {
+    help_until([this] { return !pending_.load(std::memory_order_acquire); });
+  }
+
+  // runs fn(i) for i in [0, count) across the pool and returns once all calls are done; safe to nest
+  template <typename Fn>
+  void parallel_for(std::size_t count, Fn fn) {
+    if (count == 1 || size() == 1) {
+      for (std::size_t i = 0; i < count; ++i) {
+        fn(i);
+      }
+      return;
+    }
+    std::atomic<std::size_t> remaining{count};
+    for (std::size_t i = 0; i < count; ++i) {
+      submit([this, &fn, &remaining, i] {
+        fn(i);
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          std::lock_guard lock{mutex_};
+          cv_.notify_all();
+        }
+      });
+    }
+    help_until([&remaining] { return !remaining.load(std::memory_order_acquire); });
+  }
+
+ private:
+  struct queue {
+    std::mutex mutex;
+    std::deque<task> tasks;
+  };
+
+  bool pop(std::size_t self, task& t) {
+    const auto count = size();
+    for (std::size_t k = 0; k < count; ++k) {
+      auto victim = (self + k) % count;
+      auto& q = *queues_[victim];
+      std::lock_guard lock{q.mutex};
+      if (!q.tasks.empty()) {
+        if (victim == self) {
+          t = std::move(q.tasks.back());
+          q.tasks.pop_back();
+        } else {
+          t = std::move(q.tasks.front());
+          q.tasks.pop_front();
+        }
+        std::lock_guard guard{mutex_};
+        --queued_;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void execute(task& t) {
+    t();
+    t = nullptr;
+    if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard lock{mutex_};
+      cv_.notify_all();
+    }
+  }
+
+  template <typename Pred>
+  void help_until(Pred done) {
+    auto self = worker_index();
+    task t;
+    while (!done()) {
+      if (pop((self < size()) ? self : 0, t)) {
+        execute(t);
+        continue;
+      }
+      std::unique_lock lock{mutex_};
+      cv_.wait(lock, [&] { return done() || queued_; });
+    }
+  }
+
+  void run(std::size_t self, std::stop_token token) {
+    current_ = this;
+    index_ = self;
+    task t;
+    while (!token.stop_requested()) {
+      if (pop(self, t)) {
+        execute(t);
+        continue;
+      }
+      std::unique_lock lock{mutex_};
+      cv_.wait(lock, token, [this] { return queued_ > 0; });
+    }
+  }
+
+  const std::size_t count_;
+  std::vector<std::unique_ptr<queue>> queues_;
+  std::vector<std::jthread> workers_;
+  std::mutex mutex_;
+  std::condition_variable_any cv_;
+  std::size_t queued_ = 0;
+  std::atomic<std::size_t> pending_{0};
+  std::atomic<std::size_t> next_{0};
+
+  static inline thread_local const thread_pool* current_ = nullptr;
+  static inline thread_local std::size_t index_ = 0;
+};
+
+// fn(0) .. fn(count - 1) across a pool of its own with up to `jobs` workers (0: one per hardware thread), or
+// on the calling thread when either is 1
+template <typename Fn>
+void parallel_for(std::size_t count, std::size_t jobs, Fn fn) {
+  if (count > 1 && jobs != 1) {
+    thread_pool pool{std::min<std::size_t>(count, jobs ? jobs : std::thread::hardware_concurrency())};
+    pool.parallel_for(count, fn);
+    return;
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    fn(i);
+  }
+}
+
+#endif  // BINLAB_THREAD_POOL_H_
@@ -0,0 +1,163 @@
+// utf16_transcode.h
+
+#ifndef BINLAB_UTF16_TRANSCODE_H_
+#define BINLAB_UTF16_TRANSCODE_H_
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "binlab/Config.h"
+#include "cpu_dispatch.h"
+
+// UTF-16LE (as stored in PE resources and version info, possibly unaligned) to UTF-8. A surrogate without its
+// partner becomes U+FFFD, so any input converts and the output is always valid UTF-8.
+namespace utf16 {
+
+// every unit a three-byte sequence; a surrogate pair is two units for four bytes
+inline constexpr std::size_t max_utf8_size(std::size_t units) { return 3 * units; }
+
+inline std::uint16_t load_unit(const char* in) {
+  std::uint16_t unit;
+  std::memcpy(&unit, in, sizeof(unit));
+  if constexpr (std::endian::native == std::endian::big) {
+    unit = std::byteswap(unit);
+  }
+  return unit;
+}
+
+// one code point from in[0, 2 * remaining); returns the units consumed (2 for a surrogate pair)
+inline std::size_t encode_one(const char* in, std::size_t remaining, char*& out) {
+  std::uint32_t c = load_unit(in);
+  if (c < 0x80) {
+    *out++ = static_cast<char>(c);
+    return 1;
+  }
+  if (c < 0x800) {
+    *out++ = static_cast<char>(0xc0 | c >> 6);
+    *out++ = static_cast<char>(0x80 | (c & 0x3f));
+    return 1;
+  }
+  if (c - 0xd800 < 0x800) {
+    std::uint32_t low = 0;
+    if (c < 0xdc00 && remaining > 1 && (low = load_unit(in + 2)) - 0xdc00 < 0x400) {
+      c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+      *out++ = static_cast<char>(0xf0 | c >> 18);
+      *out++ = static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+      *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+      *out++ = static_cast<char>(0x80 | (c & 0x3f));
+      return 2;
+    }
+    c = 0xfffd;
+  }
+  *out++ = static_cast<char>(0xe0 | c >> 12);
+  *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+  *out++ = static_cast<char>(0x80 | (c & 0x3f));
+  return 1;
+}
+
+// `units` code units from `in` into `out`, which has room for max_utf8_size(units); returns the bytes written
+inline std::size_t to_utf8_scalar(const char* in, std::size_t units, char* out) {
+  auto first = out;
+  for (std::size_t i = 0; i < units;) {
+    i += encode_one(in + 2 * i, units - i, out);
+  }
+  return out - first;
+}
+
+#if defined(BINLAB_HAVE_SSE2)
+// runs of ASCII, 8 units per step; anything else one code point at a time
+inline std::size_t to_utf8_sse2(const char* in, std::size_t units, char* out) {
+  auto first = out;
+  std::size_t i = 0;
+  while (i + 8 <= units) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16(static_cast<short>(0xff80))), _mm_setzero_si128())) == 0xffff) {
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(v, v));
+      out += 8;
+      i += 8;
+      continue;
+    }
+    for (const auto end = i + 8; i < end;) {
+      i += encode_one(in + 2 * i, units - i, out);
+    }
+  }
+  return (out - first) + to_utf8_scalar(in + 2 * i, units - i, out);
+}
+#endif  // !BINLAB_HAVE_SSE2
+
+#if defined(BINLAB_HAVE_AVX512VBMI2)
+// 32 units per step, the last step a masked load. All ASCII narrows in one instruction; otherwise (no surrogates)
+// each half widens to one 32-bit lane per unit holding its 1-3 byte sequence, and vpcompressb squeezes out the
+// unused bytes. Blocks with surrogates go one code point at a time, so pairs that straddle a block are still joined.
+BINLAB_TARGET_AVX512VBMI2 inline std::size_t to_utf8_avx512(const char* in, std::size_t units, char* out) {
+  auto first = out;
+  const auto one = _mm512_set1_epi32(1);
+  const auto cont = _mm512_set1_epi32(0x80);
+  const auto low6 = _mm512_set1_epi32(0x3f);
+  // the length byte of each lane copied to all four of its bytes, and each byte's position in its lane
+  const auto spread = _mm512_set4_epi32(0x0c0c0c0c, 0x08080808, 0x04040404, 0x00000000);
+  const auto position = _mm512_set1_epi32(0x03020100);
+  for (std::size_t i = 0; i < units;) {
+    const auto count = std::min<std::size_t>(units - i, 32);
+    const auto valid = static_cast<__mmask32>((std::uint64_t{1} << count) - 1);
+    auto v = _mm512_maskz_loadu_epi16(valid, in + 2 * i);
+    if (_mm512_cmpeq_epi16_mask(_mm512_and_si512(v, _mm512_set1_epi16(static_cast<short>(0xf800))), _mm512_set1_epi16(static_cast<short>(0xd800)))) {
+      for (const auto end = i + count; i < end;) {
+        i += encode_one(in + 2 * i, units - i, out);
+      }
+      continue;
+    }
+    if (!_mm512_test_epi16_mask(v, _mm512_set1_epi16(static_cast<short>(0xff80)))) {
+      _mm512_mask_storeu_epi8(out, valid, _mm512_castsi256_si512(_mm512_cvtepi16_epi8(v)));
+      out += count;
+      i += count;
+      continue;
+    }
+    for (int half = 0; half < 2; ++half) {
+      auto c = _mm512_cvtepu16_epi32(half ? _mm512_extracti64x4_epi64(v, 1) : _mm512_castsi512_si256(v));
+      auto ge80 = _mm512_cmpge_epu32_mask(c, _mm512_set1_epi32(0x80));
+      auto ge800 = _mm512_cmpge_epu32_mask(c, _mm512_set1_epi32(0x800));
+      auto tail = _mm512_slli_epi32(_mm512_or_si512(_mm512_and_si512(c, low6), cont), 8);
+      auto two = _mm512_or_si512(_mm512_or_si512(_mm512_srli_epi32(c, 6), _mm512_set1_epi32(0xc0)), tail);
+      auto middle = _mm512_slli_epi32(_mm512_or_si512(_mm512_and_si512(_mm512_srli_epi32(c, 6), low6), cont), 8);
+      auto three = _mm512_or_si512(_mm512_or_si512(_mm512_srli_epi32(c, 12), _mm512_set1_epi32(0xe0)), _mm512_or_si512(middle, _mm512_slli_epi32(tail, 8)));
+      auto bytes = _mm512_mask_mov_epi32(_mm512_mask_mov_epi32(c, ge80, two), ge800, three);
+      auto lengths = _mm512_mask_add_epi32(one, ge80, one, one);
+      lengths = _mm512_maskz_mov_epi32(static_cast<__mmask16>(valid >> (16 * half)), _mm512_mask_add_epi32(lengths, ge800, lengths, one));
+      auto keep = _mm512_cmplt_epu8_mask(position, _mm512_shuffle_epi8(lengths, spread));
+      auto n = std::popcount(keep);
+      _mm512_mask_storeu_epi8(out, (std::uint64_t{1} << n) - 1, _mm512_maskz_compress_epi8(keep, bytes));
+      out += n;
+    }
+    i += count;
+  }
+  return out - first;
+}
+#endif  // !BINLAB_HAVE_AVX512VBMI2
+
+using to_utf8_type = std::size_t (*)(const char*, std::size_t, char*);
+
+inline to_utf8_type select_to_utf8() {
+#if defined(BINLAB_HAVE_AVX512VBMI2)
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vbmi2")) {
+    return to_utf8_avx512;
+  }
+#endif  // !BINLAB_HAVE_AVX512VBMI2
+#if defined(BINLAB_HAVE_SSE2)
+  return to_utf8_sse2;
+#else
+  return to_utf8_scalar;
+#endif  // !BINLAB_HAVE_SSE2
+}
+
+inline std::size_t to_utf8(const char* in, std::size_t units, char* out) {
+  static const auto kernel = select_to_utf8();
+  return kernel(in, units, out);
+}
+
+}  // namespace utf16
+
+#endif  // BINLAB_UTF16_TRANSCODE_H_